@@ -2,9 +2,20 @@
 
 #include "act-iter.h"
 
+#include <algorithm>
+
 #include "env.h"
 #include "losglobal.h"
 
+// The next slot after i that might hold a monster, or max + 1 if there is
+// none up to max. Monsters can come and go while an iterator is in use, so
+// this looks i up afresh rather than keeping a place in env.mon_slots.
+static int _next_monster_slot(int i, int max)
+{
+    auto next = upper_bound(env.mon_slots.begin(), env.mon_slots.end(), i);
+    return next == env.mon_slots.end() || *next > max ? max + 1 : *next;
+}
+
 actor_near_iterator::actor_near_iterator(coord_def c, los_type los)
     : center(c), _los(los), viewer(nullptr), i(-1), max(env.max_mon_index)
 {
@@ -64,7 +75,7 @@ bool actor_near_iterator::valid(const actor* a) const
 void actor_near_iterator::advance()
 {
     do
-         if (++i > max)
+         if ((i = _next_monster_slot(i, max)) > max)
              return;
     while (!valid(**this));
 }
@@ -72,18 +83,16 @@ void actor_near_iterator::advance()
 //////////////////////////////////////////////////////////////////////////
 
 monster_near_iterator::monster_near_iterator(coord_def c, los_type los)
-    : center(c), _los(los), viewer(nullptr), i(0), max(env.max_mon_index)
+    : center(c), _los(los), viewer(nullptr), i(-1), max(env.max_mon_index)
 {
-    if (!valid(&env.mons[0]))
-        advance();
+    advance();
     begin_point = i;
 }
 
 monster_near_iterator::monster_near_iterator(const actor *a, los_type los)
-    : center(a->pos()), _los(los), viewer(a), i(0), max(env.max_mon_index)
+    : center(a->pos()), _los(los), viewer(a), i(-1), max(env.max_mon_index)
 {
-    if (!valid(&env.mons[0]))
-        advance();
+    advance();
     begin_point = i;
 }
 
@@ -154,7 +163,7 @@ bool monster_near_iterator::valid(const monster* a) const
 void monster_near_iterator::advance()
 {
     do
-         if (++i > max)
+         if ((i = _next_monster_slot(i, max)) > max)
              return;
     while (!valid(**this));
 }
@@ -162,10 +171,9 @@ void monster_near_iterator::advance()
 //////////////////////////////////////////////////////////////////////////
 
 monster_iterator::monster_iterator()
-    : i(0), max(env.max_mon_index)
+    : i(-1), max(env.max_mon_index)
 {
-    while (i <= max && !env.mons[i].alive())
-        i++;
+    advance();
 }
 
 monster_iterator::operator bool() const
@@ -202,7 +210,7 @@ monster_iterator monster_iterator::operator++(int)
 void monster_iterator::advance()
 {
     do
-         if (++i > max)
+         if ((i = _next_monster_slot(i, max)) > max)
              return;
     while (!(*this)->alive());
 }
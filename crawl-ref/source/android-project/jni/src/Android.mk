@@ -54,6 +54,7 @@ LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c \
     $(CRAWL_PATH)/dbg-asrt.cc \
     $(CRAWL_PATH)/dbg-maps.cc \
     $(CRAWL_PATH)/dbg-objstat.cc \
+    $(CRAWL_PATH)/dbg-prof.cc \
     $(CRAWL_PATH)/dbg-scan.cc \
     $(CRAWL_PATH)/dbg-util.cc \
     $(CRAWL_PATH)/death-curse.cc \
@@ -262,6 +263,7 @@ LOCAL_SRC_FILES := $(SDL_PATH)/src/main/android/SDL_android_main.c \
     $(CRAWL_PATH)/target-compass.cc \
     $(CRAWL_PATH)/teleport.cc \
     $(CRAWL_PATH)/terrain.cc \
+    $(CRAWL_PATH)/text-table.cc \
     $(CRAWL_PATH)/throw.cc \
     $(CRAWL_PATH)/timed-effects.cc \
     $(CRAWL_PATH)/transform.cc \
@@ -7,6 +7,7 @@
 
 #include "arena.h"
 
+#include <chrono>
 #include <stdexcept>
 
 #include "act-iter.h"
@@ -18,6 +19,8 @@
 #include "item-name.h"
 #include "item-status-flag-type.h"
 #include "items.h"
+#include "json.h"
+#include "json-wrapper.h"
 #include "libutil.h"
 #include "los.h"
 #include "macro.h"
@@ -31,6 +34,7 @@
 #include "newgame-def.h"
 #include "ng-init.h"
 #include "prompt.h"
+#include "random.h"
 #include "spl-miscast.h"
 #include "state.h"
 #include "stringutil.h"
@@ -123,6 +127,7 @@ extern void world_reacts();
 namespace arena
 {
     static bool skipped_arena_ui = true; // whether this is an interactive session
+    static bool batch = false; // fighting a matchup file, with no display
     static void write_error(const string &error);
 
     struct arena_error : public runtime_error
@@ -145,12 +150,15 @@ namespace arena
         bool        friendly;
         int         active_members;
         bool        won;
+        // Damage done by and to the faction's monsters this round.
+        int         damage_dealt;
+        int         damage_taken;
 
         vector<int>       respawn_list;
         vector<coord_def> respawn_pos;
 
         faction(bool fr) : members(), friendly(fr), active_members(0),
-                           won(false) { }
+                           won(false), damage_dealt(0), damage_taken(0) { }
 
         void place_at(const coord_def &pos);
 
@@ -158,6 +166,8 @@ namespace arena
         {
             active_members = 0;
             won            = false;
+            damage_dealt   = 0;
+            damage_taken   = 0;
 
             respawn_list.clear();
             respawn_pos.clear();
@@ -199,6 +209,11 @@ namespace arena
 
     static bool miscasts            = false;
 
+    // Total turns fought and the real time spent fighting them, for "timing".
+    static bool timing              = false;
+    static int timed_turns          = 0;
+    static chrono::steady_clock::duration fight_time;
+
     static int  summon_throttle     = INT_MAX;
 
     static vector<monster_type> uniques_list;
@@ -408,6 +423,7 @@ namespace arena
         miscasts        =  strip_tag(spec, "miscasts");
         respawn         =  strip_tag(spec, "respawn");
         move_respawns   =  strip_tag(spec, "move_respawns");
+        timing          =  strip_tag(spec, "timing");
         summon_throttle = strip_number_tag(spec, "summon_throttle:");
 
         if (real_summons && respawn)
@@ -521,6 +537,9 @@ namespace arena
 
     static void show_fight_banner(bool after_fight = false)
     {
+        if (batch)
+            return;
+
         int line = 1;
 
         cgotoxy(1, line++, GOTO_STAT);
@@ -825,12 +844,17 @@ namespace arena
 
     static void do_fight()
     {
-        viewwindow();
-        update_screen();
+        if (!batch)
+        {
+            viewwindow();
+            update_screen();
+        }
         clear_messages(true);
 
         {
             cursor_control coff(false);
+            const auto fight_start = chrono::steady_clock::now();
+            const int start_turns = turns;
             while (fight_is_on() && !contest_cancelled)
             {
 #ifdef ARENA_VERBOSE
@@ -851,12 +875,14 @@ namespace arena
                 do_respawn(faction_a);
                 do_respawn(faction_b);
                 balance_spawners();
-                if (!contest_cancelled)
+                if (!contest_cancelled && !batch)
                     ui::delay(Options.view_delay);
                 clear_messages();
                 ASSERT(you.pet_target == MHITNOT);
             }
-            if (!contest_cancelled)
+            fight_time += chrono::steady_clock::now() - fight_start;
+            timed_turns += turns - start_turns;
+            if (!contest_cancelled && !batch)
             {
                 viewwindow();
                 update_screen();
@@ -996,6 +1022,14 @@ namespace arena
             if (ties > 0)
                 fprintf(file, "-%d", ties);
             fprintf(file, "\n");
+            if (timing)
+            {
+                const double secs = chrono::duration<double>(fight_time)
+                                        .count();
+                fprintf(file, "turns: %d in %.2fs (%.1f turns/sec)\n",
+                        timed_turns, secs,
+                        secs > 0 ? timed_turns / secs : 0.0);
+            }
         }
     }
 
@@ -1086,6 +1120,373 @@ namespace arena
 
         write_results();
     }
+
+    // Totals over the rounds of a batch matchup, or of one shard of it.
+    struct batch_totals
+    {
+        batch_totals() : rounds(0), a_wins(0), b_wins(0), ties(0), turns(0),
+                         min_turns(INT_MAX), max_turns(0), a_dealt(0),
+                         a_taken(0), b_dealt(0), b_taken(0), seconds(0.0)
+        { }
+
+        int rounds;
+        int a_wins;
+        int b_wins;
+        int ties;
+        long long turns;
+        int min_turns;
+        int max_turns;
+        long long a_dealt;
+        long long a_taken;
+        long long b_dealt;
+        long long b_taken;
+        double seconds; // fighting, summed over workers
+
+        void add(const batch_totals &other)
+        {
+            rounds    += other.rounds;
+            a_wins    += other.a_wins;
+            b_wins    += other.b_wins;
+            ties      += other.ties;
+            turns     += other.turns;
+            min_turns  = min(min_turns, other.min_turns);
+            max_turns  = max(max_turns, other.max_turns);
+            a_dealt   += other.a_dealt;
+            a_taken   += other.a_taken;
+            b_dealt   += other.b_dealt;
+            b_taken   += other.b_taken;
+            seconds   += other.seconds;
+        }
+
+        string to_line() const
+        {
+            return make_stringf("%d %d %d %d %lld %d %d %lld %lld %lld %lld "
+                                "%.6f\n",
+                                rounds, a_wins, b_wins, ties, turns,
+                                min_turns, max_turns, a_dealt, a_taken,
+                                b_dealt, b_taken, seconds);
+        }
+
+        bool from_line(const string &line)
+        {
+            return sscanf(line.c_str(),
+                          "%d %d %d %d %lld %d %d %lld %lld %lld %lld %lf",
+                          &rounds, &a_wins, &b_wins, &ties, &turns,
+                          &min_turns, &max_turns, &a_dealt, &a_taken,
+                          &b_dealt, &b_taken, &seconds) == 12;
+        }
+    };
+
+    struct batch_matchup
+    {
+        string spec;
+        int rounds;
+        batch_totals totals;
+        string error;
+    };
+
+    struct batch_shard
+    {
+        size_t matchup;
+        int first_round;
+        int rounds;
+    };
+
+    // Shards are at most this many rounds whatever the number of workers, so
+    // that a batch's results depend only on its seed. It's even so that the
+    // side placed first still alternates across the rounds of a matchup.
+    static const int BATCH_SHARD_ROUNDS = 10;
+
+    /// @throws arena_error if the matchup is invalid.
+    static batch_totals fight_batch_shard(const string &spec, int rounds,
+                                          uint64_t seed)
+    {
+        rng::seed(seed);
+        global_setup(spec);
+        total_trials = rounds;
+
+        batch_totals totals;
+        const auto start = chrono::steady_clock::now();
+        while (trials_done < total_trials)
+        {
+            setup_fight();
+            do_fight();
+
+            totals.rounds++;
+            if (faction_a.won)
+                totals.a_wins++;
+            else if (faction_b.won)
+                totals.b_wins++;
+            else
+                totals.ties++;
+            totals.turns += turns;
+            totals.min_turns = min(totals.min_turns, turns);
+            totals.max_turns = max(totals.max_turns, turns);
+            totals.a_dealt += faction_a.damage_dealt;
+            totals.a_taken += faction_a.damage_taken;
+            totals.b_dealt += faction_b.damage_dealt;
+            totals.b_taken += faction_b.damage_taken;
+        }
+        totals.seconds = chrono::duration<double>(
+                             chrono::steady_clock::now() - start).count();
+        return totals;
+    }
+
+    static uint64_t shard_seed(uint64_t seed, const batch_shard &shard)
+    {
+        return seed + (uint64_t(shard.matchup) << 32) + shard.first_round;
+    }
+
+    static void add_shard_result(batch_matchup &matchup, const string &line)
+    {
+        if (starts_with(line, "err: "))
+        {
+            if (matchup.error.empty())
+                matchup.error = trimmed_string(line.substr(5));
+            return;
+        }
+
+        batch_totals totals;
+        if (totals.from_line(line))
+            matchup.totals.add(totals);
+        else if (matchup.error.empty())
+            matchup.error = "a worker failed";
+    }
+
+    static string fight_batch_shard_line(const batch_matchup &matchup,
+                                         const batch_shard &shard,
+                                         uint64_t seed)
+    {
+        try
+        {
+            return fight_batch_shard(matchup.spec, shard.rounds,
+                                     shard_seed(seed, shard)).to_line();
+        }
+        catch (const arena_error &error)
+        {
+            return make_stringf("err: %s\n", error.what());
+        }
+    }
+
+#ifdef UNIX
+    // Fights each shard in a worker, at most jobs at a time. Each worker
+    // starts from the arena as it is set up now, and passes its totals back
+    // over a pipe.
+    static void fight_batch_shards(vector<batch_matchup> &matchups,
+                                   const vector<batch_shard> &shards,
+                                   uint64_t seed, int jobs)
+    {
+        string error;
+        const vector<string> lines = run_in_workers(jobs, shards.size(),
+            [&](size_t i)
+            {
+                const batch_shard &shard = shards[i];
+                return fight_batch_shard_line(matchups[shard.matchup], shard,
+                                              seed);
+            }, error);
+        if (!error.empty())
+            end(1, false, "Arena workers failed: %s", error.c_str());
+
+        for (size_t i = 0; i < shards.size(); ++i)
+        {
+            batch_matchup &matchup = matchups[shards[i].matchup];
+            if (!lines[i].empty())
+                add_shard_result(matchup, lines[i]);
+            else if (matchup.error.empty())
+                matchup.error = "a worker failed";
+        }
+    }
+#else
+    // Without fork(), the shards are fought here one after another.
+    static void fight_batch_shards(vector<batch_matchup> &matchups,
+                                   const vector<batch_shard> &shards,
+                                   uint64_t seed, int /*jobs*/)
+    {
+        for (const batch_shard &shard : shards)
+        {
+            batch_matchup &matchup = matchups[shard.matchup];
+            add_shard_result(matchup,
+                             fight_batch_shard_line(matchup, shard, seed));
+        }
+    }
+#endif
+
+    static double per_round(long long total, int rounds)
+    {
+        return rounds ? double(total) / rounds : 0.0;
+    }
+
+    static void write_batch_tsv(const vector<batch_matchup> &matchups)
+    {
+        FILE *f = fopen_u("arena-batch.tsv", "w");
+        if (!f)
+            end(1, true, "Can't write arena-batch.tsv");
+
+        fprintf(f, "matchup\trounds\ta_wins\tb_wins\tties\ta_win_rate"
+                   "\tb_win_rate\ttie_rate\tmean_turns\tmin_turns"
+                   "\tmax_turns\ta_damage_dealt\ta_damage_taken"
+                   "\tb_damage_dealt\tb_damage_taken\tseconds\terror\n");
+        for (const batch_matchup &m : matchups)
+        {
+            const batch_totals &t = m.totals;
+            fprintf(f, "%s\t%d\t%d\t%d\t%d\t%.4f\t%.4f\t%.4f\t%.1f\t%d"
+                       "\t%d\t%.1f\t%.1f\t%.1f\t%.1f\t%.3f\t%s\n",
+                    m.spec.c_str(), t.rounds, t.a_wins, t.b_wins, t.ties,
+                    per_round(t.a_wins, t.rounds),
+                    per_round(t.b_wins, t.rounds),
+                    per_round(t.ties, t.rounds),
+                    per_round(t.turns, t.rounds),
+                    t.rounds ? t.min_turns : 0, t.max_turns,
+                    per_round(t.a_dealt, t.rounds),
+                    per_round(t.a_taken, t.rounds),
+                    per_round(t.b_dealt, t.rounds),
+                    per_round(t.b_taken, t.rounds),
+                    t.seconds, m.error.c_str());
+        }
+        fclose(f);
+    }
+
+    static JsonNode *faction_json(int wins, long long dealt, long long taken,
+                                  int rounds)
+    {
+        JsonNode *fac(json_mkobject());
+        json_append_member(fac, "wins", json_mknumber(wins));
+        json_append_member(fac, "win_rate",
+                           json_mknumber(per_round(wins, rounds)));
+        json_append_member(fac, "damage_dealt",
+                           json_mknumber(per_round(dealt, rounds)));
+        json_append_member(fac, "damage_taken",
+                           json_mknumber(per_round(taken, rounds)));
+        return fac;
+    }
+
+    static void write_batch_json(const vector<batch_matchup> &matchups,
+                                 uint64_t seed)
+    {
+        JsonWrapper json(json_mkobject());
+        json_append_member(json.node, "seed",
+                           json_mkstring(to_string(seed).c_str()));
+        JsonNode *list(json_mkarray());
+        for (const batch_matchup &m : matchups)
+        {
+            const batch_totals &t = m.totals;
+            JsonNode *obj(json_mkobject());
+            json_append_member(obj, "matchup", json_mkstring(m.spec.c_str()));
+            json_append_member(obj, "rounds", json_mknumber(t.rounds));
+            json_append_member(obj, "a", faction_json(t.a_wins, t.a_dealt,
+                                                      t.a_taken, t.rounds));
+            json_append_member(obj, "b", faction_json(t.b_wins, t.b_dealt,
+                                                      t.b_taken, t.rounds));
+            json_append_member(obj, "ties", json_mknumber(t.ties));
+            JsonNode *turn_stats(json_mkobject());
+            json_append_member(turn_stats, "mean",
+                               json_mknumber(per_round(t.turns, t.rounds)));
+            json_append_member(turn_stats, "min",
+                               json_mknumber(t.rounds ? t.min_turns : 0));
+            json_append_member(turn_stats, "max", json_mknumber(t.max_turns));
+            json_append_member(obj, "turns", turn_stats);
+            json_append_member(obj, "seconds", json_mknumber(t.seconds));
+            if (!m.error.empty())
+                json_append_member(obj, "error",
+                                   json_mkstring(m.error.c_str()));
+            json_append_element(list, obj);
+        }
+        json_append_member(json.node, "matchups", list);
+
+        FILE *f = fopen_u("arena-batch.json", "w");
+        if (!f)
+            end(1, true, "Can't write arena-batch.json");
+        fprintf(f, "%s\n", json.to_string().c_str());
+        fclose(f);
+    }
+
+    // Reads a matchup file: one matchup per line, as given to -arena, with
+    // its t:N tag (if any) giving the number of rounds. Blank lines and
+    // lines starting with # are skipped.
+    static vector<batch_matchup> read_batch_file(const string &filename)
+    {
+        FILE *f = fopen_u(filename.c_str(), "r");
+        if (!f)
+            end(1, true, "Can't read matchup file %s", filename.c_str());
+
+        vector<batch_matchup> matchups;
+        char buf[4096];
+        int line_num = 0;
+        while (fgets(buf, sizeof(buf), f))
+        {
+            line_num++;
+            string spec = trimmed_string(buf);
+            if (spec.empty() || spec[0] == '#')
+                continue;
+
+            batch_matchup matchup;
+            matchup.rounds = strip_number_tag(spec, "t:");
+            if (matchup.rounds == TAG_UNFOUND)
+                matchup.rounds = 1;
+            else if (matchup.rounds < 1)
+            {
+                fclose(f);
+                end(1, false, "%s:%d: bad round count", filename.c_str(),
+                    line_num);
+            }
+            matchup.spec = trimmed_string(spec);
+
+            // Check the spec here, rather than in every worker.
+            try
+            {
+                teams = matchup.spec;
+                parse_monster_spec();
+            }
+            catch (const arena_error &error)
+            {
+                matchup.error = error.what();
+            }
+            matchups.push_back(matchup);
+        }
+        fclose(f);
+        return matchups;
+    }
+
+    NORETURN static void run_batch(const string &filename)
+    {
+        batch = true;
+
+        vector<batch_matchup> matchups = read_batch_file(filename);
+
+        vector<batch_shard> shards;
+        for (size_t i = 0; i < matchups.size(); ++i)
+        {
+            if (!matchups[i].error.empty())
+                continue;
+            for (int first = 0; first < matchups[i].rounds;
+                 first += BATCH_SHARD_ROUNDS)
+            {
+                batch_shard shard;
+                shard.matchup = i;
+                shard.first_round = first;
+                shard.rounds = min(BATCH_SHARD_ROUNDS,
+                                   matchups[i].rounds - first);
+                shards.push_back(shard);
+            }
+        }
+
+        const uint64_t seed = Options.seed ? Options.seed : rng::get_uint64();
+        const auto start = chrono::steady_clock::now();
+        fight_batch_shards(matchups, shards, seed, crawl_state.arena_jobs);
+        const double secs = chrono::duration<double>(
+                                chrono::steady_clock::now() - start).count();
+
+        write_batch_tsv(matchups);
+        write_batch_json(matchups, seed);
+
+        int errors = 0;
+        for (const batch_matchup &m : matchups)
+            if (!m.error.empty())
+                errors++;
+        end(errors ? 1 : 0, false,
+            "Fought %u matchups in %.1fs; %d had errors.\n",
+            (unsigned int)matchups.size(), secs, errors);
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -1250,6 +1651,22 @@ void arena_split_monster(monster* split_from, monster* split_to)
     arena::to_respawn[split_to->mindex()] = member_idx;
 }
 
+void arena_monster_hurt(const monster* mons, const actor* agent, int amount)
+{
+    if (mons->attitude == ATT_FRIENDLY)
+        arena::faction_a.damage_taken += amount;
+    else if (mons->attitude == ATT_HOSTILE)
+        arena::faction_b.damage_taken += amount;
+
+    if (!agent || !agent->is_monster())
+        return;
+
+    if (agent->as_monster()->attitude == ATT_FRIENDLY)
+        arena::faction_a.damage_dealt += amount;
+    else if (agent->as_monster()->attitude == ATT_HOSTILE)
+        arena::faction_b.damage_dealt += amount;
+}
+
 void arena_monster_died(monster* mons, killer_type killer,
                         int killer_index, bool silent, const item_def* corpse)
 {
@@ -1511,6 +1928,15 @@ NORETURN void run_arena(const newgame_def& choice, const string &default_arena_t
 {
     ASSERT(crawl_state.game_is_arena());
 
+    if (!crawl_state.arena_batch.empty())
+    {
+        _init_arena();
+#ifdef WIZARD
+        you.wizard = true;
+#endif
+        arena::run_batch(crawl_state.arena_batch);
+    }
+
     newgame_def arena_choice = choice;
     string last_teams = default_arena_teams;
     if (arena::file != nullptr)
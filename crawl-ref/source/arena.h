@@ -7,6 +7,7 @@
 
 #include "enum.h"
 
+class actor;
 class level_id;
 class monster;
 struct mgen_data;
@@ -28,6 +29,8 @@ void arena_placed_monster(monster* mons);
 
 void arena_split_monster(monster* split_from, monster* split_to);
 
+void arena_monster_hurt(const monster* mons, const actor* agent, int amount);
+
 void arena_monster_died(monster* mons, killer_type killer,
                         int killer_index, bool silent, const item_def* corpse);
 
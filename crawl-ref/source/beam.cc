@@ -25,6 +25,7 @@
 #include "cloud.h"
 #include "colour.h"
 #include "coordit.h"
+#include "dbg-prof.h"
 #include "delay.h"
 #include "directn.h"
 #include "dungeon.h"
@@ -2182,6 +2183,8 @@ void fire_tracer(const monster* mons, targeting_tracer& tracer,
         || crawl_state.game_is_arena(),
         "invalid game state for tracer '%s'!", pbolt.name.c_str());
 
+    prof_count_tracer_fired();
+
     // Don't fiddle with any input parameters other than tracer stuff!
     pbolt.source        = mons->pos();
     pbolt.source_id     = mons->mid;
@@ -0,0 +1,110 @@
+#include <random>
+
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include "format.h"
+#include "stringutil.h"
+
+// The characters of the lines, each with its foreground and background.
+static vector<string> _render(const vector<formatted_string> &lines)
+{
+    vector<string> rendered;
+    for (const formatted_string &line : lines)
+    {
+        string r;
+        int fg = -1, bg = -1;
+        for (const auto &op : line.ops)
+        {
+            if (op.type == FSOP_COLOUR)
+                fg = op.colour;
+            else if (op.type == FSOP_BG)
+                bg = op.colour;
+            else
+            {
+                for (char c : op.text)
+                    r += make_stringf("%c%d/%d ", c, fg, bg);
+            }
+        }
+        rendered.push_back(r);
+    }
+    return rendered;
+}
+
+static void _check_wrap(const formatted_string &fs, int width)
+{
+    vector<formatted_string> parsed, wrapped;
+    formatted_string::parse_string_to_multiple(fs.to_colour_string(), parsed,
+                                               width);
+    fs.wrap_to_multiple(wrapped, width);
+    INFO( "width " << width << ": " << fs.to_colour_string() );
+    REQUIRE( _render(wrapped) == _render(parsed) );
+}
+
+TEST_CASE( "Wrapping formatted strings directly matches the colour string "
+           "round trip", "[single-file]" ) {
+
+    SECTION ("Simple cases") {
+        formatted_string fs;
+        _check_wrap(fs, 0);
+        _check_wrap(fs, 10);
+
+        fs.cprintf("plain text that will need a wrap or two");
+        _check_wrap(fs, 0);
+        _check_wrap(fs, 12);
+    }
+
+    SECTION ("Colours are carried across wraps and lines") {
+        formatted_string fs;
+        fs.textcolour(RED);
+        fs.cprintf("red text ");
+        fs.textbackground(BLUE);
+        fs.cprintf("on blue\nsecond line");
+        fs.textcolour(LIGHTGREY);
+        fs.cprintf(" back to grey");
+        fs.textbackground(BLACK);
+        _check_wrap(fs, 0);
+        _check_wrap(fs, 8);
+    }
+
+    SECTION ("Quotes and indentation before and after colour changes") {
+        formatted_string fs;
+        fs.cprintf("\"  an indented quote that is fairly long\n");
+        fs.textcolour(YELLOW);
+        fs.cprintf("  indented, but after a colour change\n");
+        fs.cprintf("• a bullet point, ");
+        fs.textcolour(GREEN);
+        fs.cprintf("in two colours");
+        _check_wrap(fs, 15);
+    }
+
+    SECTION ("Angle brackets in long words") {
+        formatted_string fs;
+        fs.cprintf("a<<<<<<<<<<<<<<<<<<<<<<b <tag> c");
+        _check_wrap(fs, 5);
+        _check_wrap(fs, 6);
+    }
+
+    SECTION ("Random strings") {
+        const char *words[] = { "a", "word", "longerword", " ", "  ", "\n",
+                                "<", "<<b>", "•", "é", "." };
+        std::mt19937 rng(1);
+        for (int i = 0; i < 2000; ++i)
+        {
+            formatted_string fs;
+            const int n = rng() % 30;
+            for (int j = 0; j < n; ++j)
+            {
+                const int r = rng() % 10;
+                if (r == 0)
+                    fs.textcolour(1 + rng() % 15);
+                else if (r == 1)
+                    fs.textbackground(rng() % 8);
+                else
+                    fs.cprintf(string(words[rng() % ARRAYSZ(words)]));
+            }
+            _check_wrap(fs, rng() % 4 ? 8 + rng() % 30 : 0);
+        }
+    }
+}
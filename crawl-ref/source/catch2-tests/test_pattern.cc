@@ -0,0 +1,96 @@
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+#include "pattern.h"
+
+// The index of the first pattern that matches, one pattern at a time.
+static int _first_match_slowly(const vector<string> &pats, const string &s)
+{
+    for (size_t i = 0; i < pats.size(); ++i)
+        if (text_pattern(pats[i]).matches(s))
+            return i;
+    return -1;
+}
+
+TEST_CASE( "pattern_list matches like a loop over its patterns",
+           "[single-file]" ) {
+    const vector<string> pats = {
+        "<rune of Zot", "useless_item", "scroll of noise", "potion",
+        "^unidentified.*ring", "ring of", "ion of", "of", "scroll of n",
+        "p[ao]tion of heal", "of heal", "carrion",
+    };
+
+    pattern_list list;
+    for (const string &p : pats)
+        list.add(text_pattern(p));
+    REQUIRE( list.size() == pats.size() );
+
+    const vector<string> names = {
+        "",
+        "identified potion of heal wounds",
+        "unidentified jewellery ring of protection from fire",
+        "identified useless_item scroll scroll of noise",
+        "identified scroll of nothing",
+        "identified weapon carrion",
+        "identified weapon dagger",
+        "identified potion  potion of ambrosia",
+        "identified rune <rune of Zot",
+        "iion oof",
+    };
+
+    for (const string &name : names)
+    {
+        INFO( name );
+        CHECK( list.first_match(name) == _first_match_slowly(pats, name) );
+    }
+
+    list.clear();
+    CHECK( list.empty() );
+    CHECK( list.first_match("potion") == -1 );
+    list.add(text_pattern("tion"));
+    CHECK( list.first_match("potion") == 0 );
+}
+
+static vector<string> _required(const string &pat)
+{
+    vector<string> subs;
+    if (!text_pattern(pat).required_substrings(subs))
+        return { "<none>" };
+    return subs;
+}
+
+TEST_CASE( "text_pattern finds the literals every match contains",
+           "[single-file]" ) {
+    CHECK( _required("orc priest") == vector<string>{ "orc priest" } );
+    CHECK( _required("^orc.*priest$") == vector<string>{ "orc", "priest" } );
+    CHECK( _required("colou?r") == vector<string>{ "colo", "r" } );
+    CHECK( _required("fire+ball") == vector<string>{ "fire", "ball" } );
+    CHECK( _required("colour+?ful") == vector<string>{ "colou", "ful" } );
+    CHECK( _required("a{2,3}bcd") == vector<string>{ "bcd" } );
+    CHECK( _required("ring (of )?fire") == vector<string>{ "ring ", "fire" } );
+    CHECK( _required("[]a]bc\\.d\\w") == vector<string>{ "bc.d" } );
+    CHECK( _required("") == vector<string>{} );
+    CHECK( _required("\\bword\\b") == vector<string>{ "word" } );
+
+    // Bracket expressions can hold character classes that contain a ].
+    CHECK( _required("[[:digit:]]abc") == vector<string>{ "abc" } );
+    CHECK( _required("[^[:alpha:][=e=]]xyz") == vector<string>{ "xyz" } );
+    CHECK( _required("[[.].]a]bcd") == vector<string>{ "bcd" } );
+    CHECK( _required("(a[)]b)?cde") == vector<string>{ "cde" } );
+    CHECK( _required("(a[[:alpha:])]b)?cde") == vector<string>{ "cde" } );
+
+    // Escapes with arguments aren't literals either.
+    CHECK( _required("\\x41bc") == vector<string>{ "bc" } );
+    CHECK( _required("\\x{41}bcd") == vector<string>{ "bcd" } );
+    CHECK( _required("\\101bcd") == vector<string>{ "bcd" } );
+    CHECK( _required("\\cAbcd") == vector<string>{ "bcd" } );
+    CHECK( _required("\\p{Lu}abc") == vector<string>{ "abc" } );
+    CHECK( _required("\\pLabc") == vector<string>{ "abc" } );
+    CHECK( _required("\\Qa.b\\Ecde") == vector<string>{ "cde" } );
+    CHECK( _required("(\\Q)\\E)?cde") == vector<string>{ "cde" } );
+
+    CHECK( _required("orc|elf") == vector<string>{ "<none>" } );
+    CHECK( _required("(?x)o r c") == vector<string>{ "<none>" } );
+    CHECK( _required("(unbalanced") == vector<string>{ "<none>" } );
+    CHECK( _required("[unbalanced") == vector<string>{ "<none>" } );
+}
@@ -0,0 +1,82 @@
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include "los.h"
+#include "losparam.h"
+#include "ray.h"
+
+class opacity_nothing : public opacity_func
+{
+public:
+    CLONE(opacity_nothing)
+
+    opacity_type operator()(const coord_def&) const override
+    {
+        return OPC_CLEAR;
+    }
+};
+
+// Check that a ray walking its precomputed footprint goes through the same
+// cells as one stepping geometrically, both while the footprint lasts and
+// once it has to fall back to geometry past the end of it.
+static void _check_footprint(const ray_def &ray)
+{
+    REQUIRE(ray.fp_cells);
+
+    ray_def walked = ray;
+    ray_def stepped(ray.r);
+    for (int i = 0; i < LOS_RADIUS + 4; ++i)
+    {
+        CAPTURE(i);
+        const bool walked_ok = walked.advance();
+        REQUIRE(walked_ok == stepped.advance());
+        REQUIRE(walked.pos() == stepped.pos());
+        if (!walked_ok)
+            break;
+    }
+
+    // Regressing part way along has to pick up the geometry where the
+    // footprint left off.
+    walked = ray;
+    stepped = ray_def(ray.r);
+    for (int i = 0; i < ray.fp_length / 2; ++i)
+    {
+        walked.advance();
+        stepped.advance();
+    }
+    walked.regress();
+    stepped.regress();
+    REQUIRE(walked.pos() == stepped.pos());
+    REQUIRE(walked.fp_cells == nullptr);
+}
+
+TEST_CASE("Ray footprints match advance() for all rays", "[single-file]")
+{
+    const opacity_nothing opc;
+    const coord_def source(40, 35);
+
+    int rays = 0;
+    for (int dx = -LOS_RADIUS; dx <= LOS_RADIUS; ++dx)
+        for (int dy = -LOS_RADIUS; dy <= LOS_RADIUS; ++dy)
+        {
+            const coord_def target = source + coord_def(dx, dy);
+            if (target == source)
+                continue;
+            CAPTURE(target);
+
+            // Cycle through every candidate ray to the target.
+            ray_def ray;
+            REQUIRE(find_ray(source, target, ray, opc));
+            do
+            {
+                CAPTURE(ray.cycle_idx);
+                _check_footprint(ray);
+                ++rays;
+                REQUIRE(find_ray(source, target, ray, opc, LOS_MAX_RANGE,
+                                 true));
+            }
+            while (ray.cycle_idx != 0);
+        }
+    REQUIRE(rays > 0);
+}
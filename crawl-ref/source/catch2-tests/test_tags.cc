@@ -4,9 +4,12 @@
 
 #include "AppHdr.h"
 
+#include "coordit.h"
+#include "errors.h"
 #include "map-cell.h"
 #include "random.h"
 #include "tags.h"
+#include "travel.h"
 
 TEST_CASE( "Vehumet gifts can be decoded", "[single-file]" ) {
 
@@ -245,3 +248,79 @@ TEST_CASE( "Basic marshalling/unmarshalling works correctly.", "[single-file]" )
         }
     }
 }
+
+// A level's worth of travel costs: walls, a room of floor, some shallow
+// water and a few scattered costs that don't form runs.
+static FixedArray<uint8_t, GXM, GYM> _test_travel_grid()
+{
+    FixedArray<uint8_t, GXM, GYM> costs;
+    costs.init(0);
+    for (rectangle_iterator ri(coord_def(5, 5), coord_def(60, 40)); ri; ++ri)
+        costs(*ri) = 1;
+    for (rectangle_iterator ri(coord_def(20, 10), coord_def(30, 12)); ri; ++ri)
+        costs(*ri) = 2;
+    for (int i = 0; i < 50; ++i)
+        costs(coord_def(1 + i, 50 + i % 5)) = i * 5;
+    costs(coord_def(1, 1)) = 255;
+    costs(coord_def(GXM - 2, GYM - 2)) = 7;
+    return costs;
+}
+
+static void _check_travel_grid(const FixedArray<uint8_t, GXM, GYM> &costs)
+{
+    const FixedArray<uint8_t, GXM, GYM> expected = _test_travel_grid();
+    for (rectangle_iterator ri(1); ri; ++ri)
+    {
+        CAPTURE(ri->x, ri->y);
+        REQUIRE(costs(*ri) == expected(*ri));
+    }
+}
+
+TEST_CASE( "Travel grids can be saved and loaded", "[single-file]" ) {
+
+    SECTION ("run-length encoded grids round trip") {
+        vector<unsigned char> buf;
+        {
+            writer w(&buf);
+            marshall_travel_grid(w, _test_travel_grid());
+        }
+        // Far smaller than a byte per cell.
+        REQUIRE(buf.size() < (GXM - 2) * (GYM - 2) / 10);
+
+        auto r = reader(buf);
+        r.setMinorVersion(TAG_MINOR_VERSION);
+        FixedArray<uint8_t, GXM, GYM> costs;
+        costs.init(0);
+        unmarshall_travel_grid(r, costs);
+        _check_travel_grid(costs);
+        REQUIRE(r.valid() == false);
+    }
+
+    SECTION ("grids stored a byte per cell can be read") {
+        const FixedArray<uint8_t, GXM, GYM> grid = _test_travel_grid();
+        vector<unsigned char> buf;
+        for (rectangle_iterator ri(1); ri; ++ri)
+            buf.push_back(grid(*ri));
+
+        auto r = reader(buf);
+        r.setMinorVersion(TAG_MINOR_TRAVEL_GRID);
+        FixedArray<uint8_t, GXM, GYM> costs;
+        costs.init(0);
+        unmarshall_travel_grid(r, costs);
+        _check_travel_grid(costs);
+        REQUIRE(r.valid() == false);
+    }
+
+    SECTION ("runs past the end of the map are rejected") {
+        vector<unsigned char> buf;
+        {
+            writer w(&buf);
+            marshallUByte(w, 1);
+            marshallUnsigned(w, GXM * GYM);
+        }
+        auto r = reader(buf);
+        r.setMinorVersion(TAG_MINOR_VERSION);
+        FixedArray<uint8_t, GXM, GYM> costs;
+        REQUIRE_THROWS_AS(unmarshall_travel_grid(r, costs), corrupted_save);
+    }
+}
@@ -0,0 +1,98 @@
+#include "catch_amalgamated.hpp"
+
+#include "AppHdr.h"
+
+#include "syscalls.h"
+#include "text-table.h"
+
+static const string TEST_TEXT = "text-table-test.txt";
+static const string TEST_TABLE = "text-table-test.tdb";
+
+static void _write_text(const string &text)
+{
+    FILE *f = fopen_u(TEST_TEXT.c_str(), "wb");
+    REQUIRE( f );
+    fputs(text.c_str(), f);
+    fclose(f);
+}
+
+static string _body(const TextTable &table, const string &key)
+{
+    const text_table_entry *e = table.find(key);
+    if (!e)
+        return "<missing>";
+    uint32_t len;
+    const char *body = table.body(e, &len);
+    return string(body, len);
+}
+
+TEST_CASE( "Compiled text tables hold what was written to them",
+           "[single-file]" ) {
+    _write_text("%%%%\nsome text\n");
+
+    vector<pair<string, string>> entries;
+    for (int i = 0; i < 1000; ++i)
+        entries.emplace_back("key " + to_string(i), "body " + to_string(i));
+    entries.emplace_back("weighted", "w:1\nrare\n\nw:99\ncommon\n");
+    entries.emplace_back("key 10", "replaced");
+    entries.emplace_back("broken", "w:5");
+    REQUIRE( TextTable::write(TEST_TABLE, { TEST_TEXT }, entries) );
+
+    TextTable table;
+    REQUIRE( table.open(TEST_TABLE, { TEST_TEXT }) );
+
+    SECTION ("lookups") {
+        REQUIRE( table.size() == 1002 );
+        REQUIRE( _body(table, "key 0") == "body 0" );
+        REQUIRE( _body(table, "key 999") == "body 999" );
+        REQUIRE( _body(table, "key 10") == "replaced" );
+        REQUIRE( _body(table, "key 1000") == "<missing>" );
+        REQUIRE( _body(table, "") == "<missing>" );
+    }
+
+    SECTION ("entries keep the order they were written in") {
+        REQUIRE( table.key(table.entry(0)) == "key 0" );
+        REQUIRE( table.key(table.entry(10)) == "key 10" );
+        REQUIRE( table.key(table.entry(1001)) == "broken" );
+    }
+
+    SECTION ("weighted choices") {
+        string result;
+        REQUIRE( table.choose(table.find("weighted"), 0, result) );
+        REQUIRE( result == "rare" );
+        REQUIRE( table.choose(table.find("weighted"), 1, result) );
+        REQUIRE( result == "common" );
+        REQUIRE( table.choose(table.find("key 3"), -1, result) );
+        REQUIRE( result == "body 3" );
+        REQUIRE_FALSE( table.choose(table.find("broken"), -1, result) );
+    }
+
+    SECTION ("trigram searches") {
+        vector<uint32_t> trigrams;
+        add_text_trigrams("Rare", trigrams);
+        CHECK( table.find_trigrams(trigrams, true)
+               == vector<uint32_t>{ 1000 } );
+        CHECK( table.find_trigrams(trigrams, false).empty() );
+
+        trigrams.clear();
+        add_text_trigrams("key 99", trigrams);
+        const vector<uint32_t> found = table.find_trigrams(trigrams, false);
+        CHECK( found.size() == 11 ); // 99 and 990-999
+        CHECK( found[0] == 99 );
+
+        trigrams.clear();
+        add_text_trigrams("xyz", trigrams);
+        CHECK( table.find_trigrams(trigrams, true).empty() );
+    }
+
+    SECTION ("tables of edited files aren't used") {
+        TextTable stale;
+        REQUIRE_FALSE( stale.open(TEST_TABLE, { TEST_TEXT, TEST_TEXT }) );
+        _write_text("%%%%\nsome other text\n");
+        REQUIRE_FALSE( stale.open(TEST_TABLE, { TEST_TEXT }) );
+    }
+
+    table.close();
+    unlink_u(TEST_TABLE.c_str());
+    unlink_u(TEST_TEXT.c_str());
+}
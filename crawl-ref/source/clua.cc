@@ -5,6 +5,7 @@
 #include <algorithm>
 
 #include "cluautil.h"
+#include "dbg-prof.h"
 #include "dlua.h"
 #include "end.h"
 #include "files.h"
@@ -535,6 +536,7 @@ bool CLua::calltopfn(lua_State *ls, const char *params, va_list args,
     int argc = push_args(ls, params, args, copyto);
     if (retc == -1)
         retc = return_count(ls, params);
+    PROF_SCOPE(PROF_LUA_CALLS);
     lua_call_throttle strangler(this);
     int err = lua_pcall(ls, argc, retc, 0);
     set_error(err, ls);
@@ -706,6 +708,7 @@ bool CLua::callfn(const char *fn, int nargs, int nret)
             lua_insert(ls, -nargs - 1);
     }
 
+    PROF_SCOPE(PROF_LUA_CALLS);
     lua_call_throttle strangler(this);
     int err = lua_pcall(ls, nargs, nret, 0);
     set_error(err, ls);
@@ -10,6 +10,7 @@
 #include "act-iter.h"
 #include "attitude-change.h"
 #include "coordit.h"
+#include "dbg-prof.h"
 #include "decks.h"
 #include "dungeon.h"
 #include "god-companions.h" // hepliaklqana_ancestor
@@ -405,6 +406,7 @@ static void _apply_daction(daction_type act)
 
 void catchup_dactions()
 {
+    TRANSITION_PHASE(TRANS_UPDATE);
     while (env.dactions_done < you.dactions.size())
         _apply_daction(you.dactions[env.dactions_done++]);
 }
@@ -21,12 +21,15 @@
 #include "libutil.h"
 #include "options.h"
 #include "random.h"
+#include "state.h"
 #include "stringutil.h"
 #include "syscalls.h"
+#include "text-table.h"
 #include "unicode.h"
 
 // TextDB handles dependency checking the db vs text files, creating the
-// db, loading, and destroying the DB.
+// db, loading, and destroying the DB. If -builddb has compiled a table of
+// the current text files, that's used instead of the db.
 class TextDB
 {
 public:
@@ -37,15 +40,20 @@ public:
     ~TextDB() { shutdown(true); delete translation; }
     void init();
     void shutdown(bool recursive = false);
-    DBM* get() { return _db; }
+    DBM* get() const { return _db; }
+    const TextTable &table() const { return _table; }
+    bool loaded() const { return _db || _table.is_open(); }
 
     // Make it easier to migrate from raw DBM* to TextDB
-    operator bool() const { return _db != 0; }
+    operator bool() const { return loaded(); }
     operator DBM*() const { return _db; }
 
  private:
     bool _needs_update() const;
     void _regenerate_db();
+    vector<string> _input_paths() const;
+    string _table_path() const;
+    bool _open_table();
 
  private:
     bool open_db();
@@ -53,6 +61,7 @@ public:
     string _directory;
     vector<string> _input_files;
     DBM* _db;
+    TextTable _table;
     string timestamp;
     TextDB *_parent;
     const char* lang() { return _parent ? Options.lang_name : 0; }
@@ -62,11 +71,12 @@ public:
 
 // Convenience functions for (read-only) access to generic
 // berkeley DB databases.
-static void _store_text_db(const string &in, DBM *db);
+static void _store_text_db(const string &in,
+                           vector<pair<string, string>> &entries);
 
 static string _query_database(TextDB &db, string key, bool canonicalise_key,
                               bool run_lua, bool untranslated = false);
-static void _add_entry(DBM *db, const string &k, string &v);
+static void _store_entry(DBM *db, const string &k, const string &v);
 
 static TextDB AllDBs[] =
 {
@@ -206,6 +216,9 @@ void TextDB::init()
         translation->init();
     }
 
+    if (!crawl_state.build_db && _open_table())
+        return;
+
     open_db();
 
     if (!_needs_update())
@@ -226,6 +239,7 @@ void TextDB::shutdown(bool recursive)
         dbm_close(_db);
         _db = nullptr;
     }
+    _table.close();
     if (recursive && translation)
         translation->shutdown(recursive);
 }
@@ -266,7 +280,40 @@ bool TextDB::_needs_update() const
         return false;
     }
 
-    return ts != timestamp;
+    // -builddb always rebuilds, to compile the tables.
+    return ts != timestamp || crawl_state.build_db;
+}
+
+// The text files a table is compiled from: the same ones as the db.
+vector<string> TextDB::_input_paths() const
+{
+    vector<string> paths;
+    for (const string &file : _input_files)
+    {
+        const string path = datafile_path(_directory + file, !_parent);
+        if (!path.empty())
+            paths.push_back(path);
+    }
+    return paths;
+}
+
+// Tables live next to their text files, so that they get installed (and
+// shared) along with them.
+string TextDB::_table_path() const
+{
+    for (const string &file : _input_files)
+    {
+        const string path = datafile_path(_directory + file, false);
+        if (!path.empty())
+            return get_path_relative_to(path, string(_db_name) + ".tdb");
+    }
+    return "";
+}
+
+bool TextDB::_open_table()
+{
+    const string path = _table_path();
+    return !path.empty() && _table.open(path, _input_paths());
 }
 
 void TextDB::_regenerate_db()
@@ -302,6 +349,7 @@ void TextDB::_regenerate_db()
 #endif
 
     string ts;
+    vector<pair<string, string>> entries;
     if (!(_db = dbm_open(db_path.c_str(), O_RDWR | O_CREAT, 0660)))
         end(1, true, "Unable to open DB: %s", db_path.c_str());
     for (const string &file : _input_files)
@@ -315,13 +363,26 @@ void TextDB::_regenerate_db()
         {
             snprintf(buf, sizeof(buf), ":%" PRId64, (int64_t)mtime);
             ts += buf;
-            _store_text_db(full_input_path, _db);
+            _store_text_db(full_input_path, entries);
         }
     }
-    _add_entry(_db, "TIMESTAMP", ts);
+    for (const auto &entry : entries)
+        _store_entry(_db, entry.first, entry.second);
+    _store_entry(_db, "TIMESTAMP", ts);
 
     dbm_close(_db);
     _db = 0;
+
+    if (crawl_state.build_db)
+    {
+        const string table_path = _table_path();
+        if (table_path.empty()
+            || !TextTable::write(table_path, _input_paths(), entries))
+        {
+            mprf(MSGCH_ERROR, "Unable to write compiled db: %s",
+                 table_path.c_str());
+        }
+    }
 }
 
 // ----------------------------------------------------------------------
@@ -345,51 +406,118 @@ void databaseSystemShutdown()
 ////////////////////////////////////////////////////////////////////////////
 // Main DB functions
 
-static datum _database_fetch(DBM *database, const string &key)
+static datum _database_fetch(const TextDB *db, const string &key)
 {
     datum result;
     result.dptr = nullptr;
     result.dsize = 0;
-    datum dbKey;
 
+    // Don't use the database if called from "monster".
+    if (!db)
+        return result;
+
+    const TextTable &table = db->table();
+    if (table.is_open())
+    {
+        if (const text_table_entry *e = table.find(key))
+        {
+            uint32_t len;
+            result.dptr = const_cast<DPTR_COERCE>(table.body(e, &len));
+            result.dsize = len;
+        }
+        return result;
+    }
+
+    datum dbKey;
     dbKey.dptr = (DPTR_COERCE) key.c_str();
     dbKey.dsize = key.length();
 
-    // Don't use the database if called from "monster".
-    if (database)
-        result = dbm_fetch(database, dbKey);
+    if (db->get())
+        result = dbm_fetch(db->get(), dbKey);
 
     return result;
 }
 
-static vector<string> _database_find_keys(DBM *database,
-                                          const string &regex,
-                                          bool ignore_case,
-                                          db_find_filter filter = nullptr)
+// Call f(key, body) for each entry whose key (or body, if searching
+// bodies) might match tpat. The body is only looked up for body searches.
+template <typename F>
+static void _database_for_each(const TextDB &db, const text_pattern &tpat,
+                               bool want_body, F f)
 {
-    text_pattern             tpat(regex, ignore_case);
-    vector<string> matches;
+    const TextTable &table = db.table();
+    if (table.is_open())
+    {
+        auto visit = [&](uint32_t i)
+        {
+            const text_table_entry *e = table.entry(i);
+            uint32_t len = 0;
+            const char *body = want_body ? table.body(e, &len) : "";
+            f(table.key(e), string(body, len));
+        };
+
+        // Only entries with every trigram of the pattern's literal parts
+        // can match; patterns without any have to check everything.
+        vector<string> literals;
+        vector<uint32_t> trigrams;
+        if (tpat.required_substrings(literals))
+            for (const string &literal : literals)
+                add_text_trigrams(literal, trigrams);
+
+        if (!trigrams.empty())
+        {
+            for (uint32_t i : table.find_trigrams(trigrams, want_body))
+                visit(i);
+        }
+        else
+        {
+            for (uint32_t i = 0; i < table.size(); ++i)
+                visit(i);
+        }
+        return;
+    }
 
+    DBM *database = db.get();
     datum dbKey = dbm_firstkey(database);
 
     while (dbKey.dptr != nullptr)
     {
         string key((const char *)dbKey.dptr, dbKey.dsize);
 
-        if (tpat.matches(key)
-            && key.find("__") == string::npos
-            && (filter == nullptr || !(*filter)(key, "")))
+        string body;
+        if (want_body)
         {
-            matches.push_back(key);
+            datum dbBody = dbm_fetch(database, dbKey);
+            body = string((const char *)dbBody.dptr, dbBody.dsize);
         }
+        f(key, body);
 
         dbKey = dbm_nextkey(database);
     }
+}
+
+static vector<string> _database_find_keys(const TextDB &db,
+                                          const string &regex,
+                                          bool ignore_case,
+                                          db_find_filter filter = nullptr)
+{
+    text_pattern             tpat(regex, ignore_case);
+    vector<string> matches;
+
+    _database_for_each(db, tpat, false,
+        [&](const string &key, const string &)
+        {
+            if (tpat.matches(key)
+                && key.find("__") == string::npos
+                && (filter == nullptr || !(*filter)(key, "")))
+            {
+                matches.push_back(key);
+            }
+        });
 
     return matches;
 }
 
-static vector<string> _database_find_bodies(DBM *database,
+static vector<string> _database_find_bodies(const TextDB &db,
                                             const string &regex,
                                             bool ignore_case,
                                             db_find_filter filter = nullptr)
@@ -397,24 +525,16 @@ static vector<string> _database_find_bodies(DBM *database,
     text_pattern             tpat(regex, ignore_case);
     vector<string> matches;
 
-    datum dbKey = dbm_firstkey(database);
-
-    while (dbKey.dptr != nullptr)
-    {
-        string key((const char *)dbKey.dptr, dbKey.dsize);
-
-        datum dbBody = dbm_fetch(database, dbKey);
-        string body((const char *)dbBody.dptr, dbBody.dsize);
-
-        if (tpat.matches(body)
-            && key.find("__") == string::npos
-            && (filter == nullptr || !(*filter)(key, body)))
+    _database_for_each(db, tpat, true,
+        [&](const string &key, const string &body)
         {
-            matches.push_back(key);
-        }
-
-        dbKey = dbm_nextkey(database);
-    }
+            if (tpat.matches(body)
+                && key.find("__") == string::npos
+                && (filter == nullptr || !(*filter)(key, body)))
+            {
+                matches.push_back(key);
+            }
+        });
 
     return matches;
 }
@@ -485,9 +605,15 @@ static void _trim_leading_newlines(string &s)
     s.erase(0, s.find_first_not_of("\n"));
 }
 
-static void _add_entry(DBM *db, const string &k, string &v)
+static void _add_entry(vector<pair<string, string>> &entries,
+                       const string &k, string &v)
 {
     _trim_leading_newlines(v);
+    entries.emplace_back(k, v);
+}
+
+static void _store_entry(DBM *db, const string &k, const string &v)
+{
     datum key, value;
     key.dptr = (char *) k.c_str();
     key.dsize = k.length();
@@ -499,7 +625,8 @@ static void _add_entry(DBM *db, const string &k, string &v)
         end(1, true, "Error storing %s", k.c_str());
 }
 
-static void _parse_text_db(LineInput &inf, DBM *db)
+static void _parse_text_db(LineInput &inf,
+                           vector<pair<string, string>> &entries)
 {
     string key;
     string value;
@@ -515,7 +642,7 @@ static void _parse_text_db(LineInput &inf, DBM *db)
         if (!line.compare(0, 4, "%%%%"))
         {
             if (!key.empty())
-                _add_entry(db, key, value);
+                _add_entry(entries, key, value);
             key.clear();
             value.clear();
             in_entry = true;
@@ -539,16 +666,17 @@ static void _parse_text_db(LineInput &inf, DBM *db)
     }
 
     if (!key.empty())
-        _add_entry(db, key, value);
+        _add_entry(entries, key, value);
 }
 
-static void _store_text_db(const string &in, DBM *db)
+static void _store_text_db(const string &in,
+                           vector<pair<string, string>> &entries)
 {
     UTF8FileLineInput inf(in.c_str());
     if (inf.error())
         end(1, true, "Unable to open input file: %s", in.c_str());
 
-    _parse_text_db(inf, db);
+    _parse_text_db(inf, entries);
 }
 
 static string _chooseStrByWeight(const string &entry, int fixed_weight = -1)
@@ -556,46 +684,10 @@ static string _chooseStrByWeight(const string &entry, int fixed_weight = -1)
     vector<string> parts;
     vector<int>    weights;
 
-    vector<string> lines = split_string("\n", entry, false, true);
-
-    int total_weight = 0;
-    for (int i = 0, size = lines.size(); i < size; i++)
-    {
-        // Skip over multiple blank lines, and leading and trailing
-        // blank lines.
-        while (i < size && lines[i].empty())
-            i++;
-
-        if (i == size)
-            break;
-
-        int         weight;
-        string part = "";
-
-        if (sscanf(lines[i].c_str(), "w:%d", &weight))
-        {
-            i++;
-            if (i == size)
-                return "BUG, WEIGHT AT END OF ENTRY";
-        }
-        else
-            weight = 10;
-
-        total_weight += weight;
-
-        while (i < size && !lines[i].empty())
-        {
-            part += lines[i++];
-            part += "\n";
-        }
-        trim_string(part);
-
-        parts.push_back(part);
-        weights.push_back(total_weight);
-    }
-
-    if (parts.empty())
-        return "BUG, EMPTY ENTRY";
+    const string error = parse_weighted_entry(entry, parts, weights);
+    if (!error.empty())
+        return error;
+    const int total_weight = weights.back();
 
     int choice = 0;
     if (fixed_weight != -1)
@@ -613,6 +705,33 @@ static string _chooseStrByWeight(const string &entry, int fixed_weight = -1)
 #define MAX_RECURSION_DEPTH 10
 #define MAX_REPLACEMENTS    100
 
+// Choose from the entry for key, if it has one. Compiled tables have the
+// alternatives already split out.
+static bool _fetch_weighted(const TextDB *db, const string &key,
+                            int fixed_weight, string &result)
+{
+    if (db && db->table().is_open())
+    {
+        const TextTable &table = db->table();
+        const text_table_entry *e = table.find(key);
+        uint32_t len = 0;
+        const char *body = e ? table.body(e, &len) : nullptr;
+        if (!len)
+            return false;
+        if (!table.choose(e, fixed_weight, result))
+            result = _chooseStrByWeight(string(body, len), fixed_weight);
+        return true;
+    }
+
+    datum entry = _database_fetch(db, key);
+    if (entry.dsize <= 0)
+        return false;
+
+    result = _chooseStrByWeight(string((const char *)entry.dptr, entry.dsize),
+                                fixed_weight);
+    return true;
+}
+
 static string _getWeightedString(TextDB &db, const string &key,
                                  const string &suffix, int fixed_weight = -1)
 {
@@ -622,33 +741,23 @@ static string _getWeightedString(TextDB &db, const string &key,
     lowercase(canonical_key);
 
     // Query the DB.
-    datum result;
-
-    if (db.translation)
-        result = _database_fetch(db.translation->get(), canonical_key);
-    if (result.dsize <= 0)
-        result = _database_fetch(db.get(), canonical_key);
-
-    if (result.dsize <= 0)
+    string result;
+    if (_fetch_weighted(db.translation, canonical_key, fixed_weight, result)
+        || _fetch_weighted(&db, canonical_key, fixed_weight, result))
     {
-        // Try ignoring the suffix.
-        canonical_key = key;
-        lowercase(canonical_key);
-
-        // Query the DB.
-        if (db.translation)
-            result = _database_fetch(db.translation->get(), canonical_key);
-        if (result.dsize <= 0)
-            result = _database_fetch(db.get(), canonical_key);
-
-        if (result.dsize <= 0)
-            return "";
+        return result;
     }
 
-    // Cons up a (C++) string to return. The caller must release it.
-    string str = string((const char *)result.dptr, result.dsize);
+    // Try ignoring the suffix.
+    canonical_key = key;
+    lowercase(canonical_key);
 
-    return _chooseStrByWeight(str, fixed_weight);
+    if (_fetch_weighted(db.translation, canonical_key, fixed_weight, result)
+        || _fetch_weighted(&db, canonical_key, fixed_weight, result))
+    {
+        return result;
+    }
+    return "";
 }
 
 static void _call_recursive_replacement(string &str, TextDB &db,
@@ -739,9 +848,9 @@ static string _query_database(TextDB &db, string key, bool canonicalise_key,
     datum result;
 
     if (db.translation && !untranslated)
-        result = _database_fetch(db.translation->get(), key);
+        result = _database_fetch(db.translation, key);
     if (result.dsize <= 0)
-        result = _database_fetch(db.get(), key);
+        result = _database_fetch(&db, key);
 
     if (result.dsize <= 0)
         return "";
@@ -784,7 +893,7 @@ string getLongDescription(const string &key)
 vector<string> getLongDescKeysByRegex(const string &regex,
                                       db_find_filter filter)
 {
-    if (!DescriptionDB.get())
+    if (!DescriptionDB)
     {
         vector<string> empty;
         return empty;
@@ -792,13 +901,13 @@ vector<string> getLongDescKeysByRegex(const string &regex,
 
     // FIXME: need to match regex against translated keys, which can't
     // be done by db only.
-    return _database_find_keys(DescriptionDB.get(), regex, true, filter);
+    return _database_find_keys(DescriptionDB, regex, true, filter);
 }
 
 vector<string> getLongDescBodiesByRegex(const string &regex,
                                         db_find_filter filter)
 {
-    if (!DescriptionDB.get())
+    if (!DescriptionDB)
     {
         vector<string> empty;
         return empty;
@@ -808,8 +917,8 @@ vector<string> getLongDescBodiesByRegex(const string &regex,
     // Not good, but otherwise we'd have to check hundreds of keys, with
     // two queries for each.
     // SQL can do this in one go, DBM can't.
-    DBM *database = DescriptionDB.translation ?
-        DescriptionDB.translation->get() : DescriptionDB.get();
+    const TextDB &database = DescriptionDB.translation ?
+        *DescriptionDB.translation : DescriptionDB;
     return _database_find_bodies(database, regex, true, filter);
 }
 
@@ -875,13 +984,13 @@ string getHelpString(const string &topic)
 // FAQ DB specific functions.
 vector<string> getAllFAQKeys()
 {
-    if (!FAQDB.get())
+    if (!FAQDB)
     {
         vector<string> empty;
         return empty;
     }
 
-    return _database_find_keys(FAQDB.get(), "^q.+", false);
+    return _database_find_keys(FAQDB, "^q.+", false);
 }
 
 string getFAQ_Question(const string &key)
@@ -7,6 +7,8 @@
 
 #include "dbg-maps.h"
 
+#include <exception>
+
 #include "branch.h"
 #include "chardump.h"
 #include "crash.h"
@@ -49,6 +51,29 @@ static int build_attempts = 0, level_vetoes = 0;
 // Map from message to counts.
 static map<string, int> veto_messages;
 
+// Builder timings, for the phases of the builder and for each map placed.
+struct mapstat_time
+{
+    int calls = 0;
+    int vetoes = 0;
+    double total_ms = 0;
+    double max_ms = 0;
+};
+
+static const char *builder_phase_names[] =
+{
+    "layout", "primary_vault", "extra_vaults", "items", "monsters",
+    "connectivity",
+};
+COMPILE_CHECK(ARRAYSZ(builder_phase_names) == NUM_BUILDER_PHASES);
+
+static mapstat_time phase_times[NUM_BUILDER_PHASES];
+static map<string, mapstat_time> map_times;
+static map<string, mapstat_time> layout_times;
+
+// Maps taking less than this aren't mentioned in the builder log.
+#define MAPSTAT_LOG_MS 1.0
+
 void mapstat_report_map_build_start()
 {
     build_attempts++;
@@ -62,6 +87,44 @@ void mapstat_report_map_veto(const string &message)
     map_builds[level_id::current()].second++;
 }
 
+mapstat_timer::mapstat_timer(builder_phase _phase)
+    : phase(_phase), map(nullptr), start(chrono::steady_clock::now())
+{
+}
+
+mapstat_timer::mapstat_timer(const map_def &_map)
+    : phase(NUM_BUILDER_PHASES), map(&_map),
+      start(chrono::steady_clock::now())
+{
+}
+
+mapstat_timer::~mapstat_timer()
+{
+    const double ms = chrono::duration<double, milli>(
+                          chrono::steady_clock::now() - start).count();
+    const bool vetoed = uncaught_exception();
+
+    mapstat_time &t = !map ? phase_times[phase]
+                    : map->has_tag("layout") ? layout_times[map->name]
+                    : map_times[map->name];
+    t.calls++;
+    t.total_ms += ms;
+    t.max_ms = max(t.max_ms, ms);
+    if (vetoed)
+        t.vetoes++;
+
+    if (!map)
+    {
+        dprf(DIAG_DNGN, "Builder phase %s: %.2f ms%s",
+             builder_phase_names[phase], ms, vetoed ? " (vetoed)" : "");
+    }
+    else if (ms >= MAPSTAT_LOG_MS || vetoed)
+    {
+        dprf(DIAG_DNGN, "Placing %s: %.2f ms%s", map->name.c_str(), ms,
+             vetoed ? " (vetoed)" : "");
+    }
+}
+
 static bool _is_disconnected_level()
 {
     // Don't care about non-Dungeon levels.
@@ -317,6 +380,58 @@ static void _check_mapless(const level_id &lid, vector<level_id> &mapless)
         mapless.push_back(lid);
 }
 
+static void _write_time_row(FILE *outf, const char *kind, const string &name,
+                            const mapstat_time &t)
+{
+    fprintf(outf, "%s\t%s\t%d\t%d\t%.2f\t%.3f\t%.2f\n", kind,
+            name.c_str(), t.calls, t.vetoes, t.total_ms,
+            t.calls ? t.total_ms / t.calls : 0.0, t.max_ms);
+}
+
+static void _write_map_times()
+{
+    const char *out_file = "mapstat-times.tsv";
+    FILE *outf = fopen_u(out_file, "w");
+    if (!outf)
+    {
+        fprintf(stderr, "Unable to open %s for writing.\n", out_file);
+        return;
+    }
+
+    fprintf(outf, "Kind\tName\tCalls\tVetoes\tTotal ms\tMean ms\t"
+                  "Max ms\n");
+    for (int i = 0; i < NUM_BUILDER_PHASES; ++i)
+        _write_time_row(outf, "phase", builder_phase_names[i], phase_times[i]);
+    for (const auto &entry : layout_times)
+        _write_time_row(outf, "layout", entry.first, entry.second);
+    for (const auto &entry : map_times)
+        _write_time_row(outf, "map", entry.first, entry.second);
+    fclose(outf);
+}
+
+static void _write_slowest_maps(FILE *outf)
+{
+    multimap<double, string> slowest;
+    for (const auto &entry : layout_times)
+        slowest.insert(make_pair(entry.second.total_ms, entry.first));
+    for (const auto &entry : map_times)
+        slowest.insert(make_pair(entry.second.total_ms, entry.first));
+    if (slowest.empty())
+        return;
+
+    fprintf(outf, "\n\nSlowest maps (total ms, max ms, placements, "
+                  "vetoes; all in mapstat-times.tsv):\n\n");
+    int count = 0;
+    for (auto i = slowest.rbegin(); i != slowest.rend() && count < 30; ++i)
+    {
+        const mapstat_time &t = layout_times.count(i->second)
+                                ? layout_times[i->second]
+                                : map_times[i->second];
+        fprintf(outf, "%3d) %9.1f, %7.1f, %4d, %4d: %s\n", ++count,
+                t.total_ms, t.max_ms, t.calls, t.vetoes, i->second.c_str());
+    }
+}
+
 static void _write_map_stats()
 {
     const char *out_file = "mapstat.log";
@@ -403,6 +518,8 @@ static void _write_map_stats()
             fprintf(outf, "%3d) %s\n", i->first, i->second.c_str());
     }
 
+    _write_slowest_maps(outf);
+
     if (!unused_maps.empty() && !SysEnv.map_gen_range)
     {
         fprintf(outf, "\n\nUnused maps:\n\n");
@@ -525,6 +642,7 @@ void mapstat_generate_stats()
     mapstat_build_levels();
 
     _write_map_stats();
+    _write_map_times();
     printf("Map stats complete.\n");
 }
 
@@ -7,7 +7,45 @@
 
 #ifdef DEBUG_STATISTICS
 
+#include <chrono>
+
 class map_def;
+
+enum builder_phase
+{
+    BPHASE_LAYOUT,
+    BPHASE_PRIMARY_VAULT,
+    BPHASE_EXTRA_VAULTS,
+    BPHASE_ITEMS,
+    BPHASE_MONSTERS,
+    BPHASE_CONNECTIVITY,
+    NUM_BUILDER_PHASES
+};
+
+// Times a builder phase, or the placement of one map, from construction to
+// destruction, for -mapstat and the builder log. A veto or map load error
+// unwinding through the timer counts against its phase or map.
+class mapstat_timer
+{
+public:
+    explicit mapstat_timer(builder_phase phase);
+    explicit mapstat_timer(const map_def &map);
+    ~mapstat_timer();
+
+    mapstat_timer(const mapstat_timer &) = delete;
+    mapstat_timer &operator=(const mapstat_timer &) = delete;
+
+private:
+    builder_phase phase;
+    const map_def *map;
+    chrono::steady_clock::time_point start;
+};
+
+# define MAPSTAT_CAT2(a, b) a##b
+# define MAPSTAT_CAT(a, b) MAPSTAT_CAT2(a, b)
+# define MAPSTAT_TIMER(what) \
+    mapstat_timer MAPSTAT_CAT(mapstat_timer_, __LINE__)(what)
+
 void mapstat_report_map_try(const map_def &map);
 void mapstat_report_map_use(const map_def &map);
 void mapstat_report_map_success(const string &map_name);
@@ -17,4 +55,9 @@ void mapstat_report_map_veto(const string &message);
 void mapstat_generate_stats();
 bool mapstat_build_levels();
 bool mapstat_find_forced_map();
+
+#else
+
+# define MAPSTAT_TIMER(what) ((void) 0)
+
 #endif
@@ -0,0 +1,661 @@
+/**
+ * @file
+ * @brief Scoped timers and per-turn counters for the main subsystems.
+**/
+
+#include "AppHdr.h"
+
+#include "dbg-prof.h"
+
+#include <algorithm>
+#include <chrono>
+#ifdef UNIX
+ #include <sys/resource.h>
+#endif
+
+#include "branch.h"
+#include "end.h"
+#include "hiscores.h"
+#include "json.h"
+#include "json-wrapper.h"
+#include "level-id.h"
+#include "scroller.h"
+#include "stringutil.h"
+#include "syscalls.h"
+#ifdef USE_TILE_WEB
+ #include "tileweb.h"
+#endif
+
+static const char *prof_section_names[] =
+{
+    "world_reacts",
+    "handle_monsters",
+    "los_update",
+    "monster_pathfind",
+    "travel_pathfind",
+    "level_builder",
+    "save_game",
+    "level_load",
+    "send_map",
+    "lua_calls",
+};
+COMPILE_CHECK(ARRAYSZ(prof_section_names) == NUM_PROF_SECTIONS);
+
+static const char *transition_phase_names[] =
+{
+    "other",
+    "leave",
+    "save",
+    "travel",
+    "build",
+    "ghosts",
+    "restore",
+    "update",
+    "los",
+    "tiles",
+    "send_map",
+    "commit",
+    "arrive",
+};
+COMPILE_CHECK(ARRAYSZ(transition_phase_names) == NUM_TRANSITION_PHASES);
+
+typedef chrono::steady_clock prof_clock;
+
+// Counted in all builds, for -bench.
+static int prof_turn_count = 0;
+static unsigned long long prof_monster_actions = 0;
+// Levels loaded from the hot level cache, and from the save.
+static unsigned long long prof_hot_level_hits = 0;
+static unsigned long long prof_hot_level_misses = 0;
+// Monster tracers fired, and reused from earlier in the same spell choice.
+static unsigned long long prof_tracers_fired = 0;
+static unsigned long long prof_tracers_reused = 0;
+
+// The level transition being timed. It runs from prof_begin_transition() to
+// prof_end_transition(), and then in webtiles builds waits for the new
+// level's map to be sent.
+static struct
+{
+    bool running;
+    bool awaiting_map;
+    level_id from;
+    level_id to;
+    bool new_level;
+    vector<transition_phase> phases;
+    prof_clock::time_point mark;
+    prof_clock::duration times[NUM_TRANSITION_PHASES];
+} transition;
+
+// Completed transitions, by the abbreviation of the branch arrived in.
+struct transition_totals
+{
+    int count;
+    prof_clock::duration total;
+    prof_clock::duration max;
+    prof_clock::duration phases[NUM_TRANSITION_PHASES];
+};
+static map<string, transition_totals> transition_branches;
+static bool send_transitions = false;
+
+// -bench: where to write the results, and how many turns to run for. Turns
+// are timed from the end of the first one, to leave out startup.
+static string bench_file;
+static int bench_turn_limit = 0;
+static prof_clock::time_point bench_start;
+static unsigned long long bench_start_actions = 0;
+
+static double _ms(prof_clock::duration d)
+{
+    return chrono::duration<double, milli>(d).count();
+}
+
+#ifdef PROFILE_COUNTERS
+
+// Per-turn times are binned by powers of two: bucket 0 counts turns in which
+// the section took under a microsecond (usually: didn't run at all), and
+// bucket n those where it took [2^(n-1), 2^n) microseconds.
+#define PROF_BUCKETS 28
+
+// How often to send the counters to the webtiles server, in turns.
+#define PROF_SEND_INTERVAL 1000
+
+struct prof_counter
+{
+    int depth;
+    prof_clock::time_point start;
+
+    // The turn in progress.
+    unsigned long long turn_calls;
+    prof_clock::duration turn_time;
+
+    // All completed turns.
+    unsigned long long calls;
+    prof_clock::duration total;
+    prof_clock::duration max_turn;
+    unsigned long long histogram[PROF_BUCKETS];
+};
+
+static prof_counter prof_counters[NUM_PROF_SECTIONS];
+static string prof_exit_file;
+
+prof_timer::prof_timer(prof_section s) : section(s)
+{
+    prof_counter &c = prof_counters[section];
+    ++c.turn_calls;
+    if (!c.depth++)
+        c.start = prof_clock::now();
+}
+
+prof_timer::~prof_timer()
+{
+    prof_counter &c = prof_counters[section];
+    if (!--c.depth)
+        c.turn_time += prof_clock::now() - c.start;
+}
+
+// Time charged to the turn in progress, including any still running.
+static prof_clock::duration _pending(const prof_counter &c)
+{
+    if (c.depth)
+        return c.turn_time + (prof_clock::now() - c.start);
+    return c.turn_time;
+}
+
+static int _bucket(prof_clock::duration d)
+{
+    auto us = chrono::duration_cast<chrono::microseconds>(d).count();
+    int bucket = 0;
+    while (us > 0 && bucket < PROF_BUCKETS - 1)
+    {
+        us >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+static string _bucket_limit(int bucket)
+{
+    const long long us = 1LL << bucket;
+    if (us < 1000)
+        return make_stringf("%lldus", us);
+    else if (us < 1000 * 1000)
+        return make_stringf("%.3gms", us / 1000.0);
+    else
+        return make_stringf("%.3gs", us / (1000.0 * 1000.0));
+}
+
+#ifdef USE_TILE_WEB
+static void _send_profile()
+{
+    JsonWrapper json(prof_json());
+    json_append_member(json.node, "msg", json_mkstring("profile"));
+    tiles.write_message("*");
+    tiles.write_message("%s", json.to_string().c_str());
+    tiles.finish_message();
+}
+#endif
+
+#endif // PROFILE_COUNTERS
+
+/**
+ * Close off the current turn: fold each section's time for the turn into its
+ * totals and histogram. Sections still running are charged for the time they
+ * have taken so far, and carry on into the next turn.
+ */
+void prof_end_turn()
+{
+    const auto now = prof_clock::now();
+#ifdef PROFILE_COUNTERS
+    for (prof_counter &c : prof_counters)
+    {
+        if (c.depth)
+        {
+            c.turn_time += now - c.start;
+            c.start = now;
+        }
+        c.calls += c.turn_calls;
+        c.total += c.turn_time;
+        c.max_turn = max(c.max_turn, c.turn_time);
+        ++c.histogram[_bucket(c.turn_time)];
+
+        c.turn_calls = 0;
+        c.turn_time = prof_clock::duration::zero();
+    }
+#endif
+    ++prof_turn_count;
+
+#if defined(PROFILE_COUNTERS) && defined(USE_TILE_WEB)
+    if (prof_turn_count % PROF_SEND_INTERVAL == 0)
+        _send_profile();
+#endif
+
+    if (bench_file.empty())
+        return;
+    if (prof_turn_count == 1)
+    {
+        bench_start = now;
+        bench_start_actions = prof_monster_actions;
+    }
+    else if (bench_turn_limit && prof_turn_count > bench_turn_limit)
+        end(0);
+}
+
+void prof_count_monster_action()
+{
+    ++prof_monster_actions;
+}
+
+void prof_count_hot_level(bool hit)
+{
+    if (hit)
+        ++prof_hot_level_hits;
+    else
+        ++prof_hot_level_misses;
+}
+
+void prof_count_tracer_fired()
+{
+    ++prof_tracers_fired;
+}
+
+void prof_count_tracer_reused()
+{
+    ++prof_tracers_reused;
+}
+
+static double _tracer_reuse_rate()
+{
+    const unsigned long long tracers = prof_tracers_fired
+                                       + prof_tracers_reused;
+    return tracers ? prof_tracers_reused * 100.0 / tracers : 0.0;
+}
+
+static JsonNode *_tracers_json()
+{
+    JsonNode *obj(json_mkobject());
+    json_append_member(obj, "fired", json_mknumber(prof_tracers_fired));
+    json_append_member(obj, "reused", json_mknumber(prof_tracers_reused));
+    json_append_member(obj, "reuse_rate", json_mknumber(_tracer_reuse_rate()));
+    return obj;
+}
+
+// Charge the time since the last mark to the innermost phase running.
+static void _charge_transition()
+{
+    const auto now = prof_clock::now();
+    if (!transition.phases.empty())
+        transition.times[transition.phases.back()] += now - transition.mark;
+    transition.mark = now;
+}
+
+static void _finish_transition()
+{
+    transition.running = false;
+    transition.awaiting_map = false;
+    transition.phases.clear();
+
+    transition_totals &totals =
+        transition_branches[branches[transition.to.branch].abbrevname];
+    prof_clock::duration total = prof_clock::duration::zero();
+    for (int i = 0; i < NUM_TRANSITION_PHASES; ++i)
+    {
+        totals.phases[i] += transition.times[i];
+        total += transition.times[i];
+    }
+    ++totals.count;
+    totals.total += total;
+    totals.max = max(totals.max, total);
+
+    vector<pair<string, string>> fields;
+    fields.emplace_back("oplace", transition.from.describe());
+    fields.emplace_back("new", transition.new_level ? "1" : "0");
+    fields.emplace_back("ms", make_stringf("%.2f", _ms(total)));
+    for (int i = 0; i < NUM_TRANSITION_PHASES; ++i)
+    {
+        fields.emplace_back(string(transition_phase_names[i]) + "_ms",
+                            make_stringf("%.2f", _ms(transition.times[i])));
+    }
+    mark_level_transition(fields, send_transitions);
+}
+
+transition_timer::transition_timer(transition_phase p, bool when)
+    : active(when && (transition.running
+                      || (transition.awaiting_map && p == TRANS_SEND_MAP)))
+{
+    if (!active)
+        return;
+    _charge_transition();
+    transition.phases.push_back(p);
+}
+
+transition_timer::~transition_timer()
+{
+    if (!active)
+        return;
+    _charge_transition();
+    transition.phases.pop_back();
+    if (transition.awaiting_map && transition.phases.empty())
+        _finish_transition();
+}
+
+/// Start timing a level transition away from the given level.
+void prof_begin_transition(const level_id &from)
+{
+    // The last one never got its map sent.
+    if (transition.awaiting_map)
+        _finish_transition();
+
+    transition.running = true;
+    transition.from = from;
+    transition.phases.assign(1, TRANS_OTHER);
+    for (auto &t : transition.times)
+        t = prof_clock::duration::zero();
+    transition.mark = prof_clock::now();
+}
+
+/**
+ * The level transition being timed has arrived. It is logged once the new
+ * level's map has been sent to webtiles, or straight away if nobody is
+ * watching there.
+ *
+ * @param to        The level arrived at.
+ * @param new_level Whether it was created for the transition.
+ */
+void prof_end_transition(const level_id &to, bool new_level)
+{
+    if (!transition.running)
+        return;
+    _charge_transition();
+    transition.running = false;
+    transition.phases.clear();
+    transition.to = to;
+    transition.new_level = new_level;
+#ifdef USE_TILE_WEB
+    if (tiles.has_receivers())
+    {
+        transition.awaiting_map = true;
+        return;
+    }
+#endif
+    _finish_transition();
+}
+
+/// Send each level transition's timings to the webtiles server too.
+void prof_send_transitions()
+{
+    send_transitions = true;
+}
+
+static JsonNode *_transitions_json()
+{
+    JsonNode *obj(json_mkobject());
+    for (const auto &entry : transition_branches)
+    {
+        const transition_totals &totals = entry.second;
+        JsonNode *branch(json_mkobject());
+        json_append_member(branch, "count", json_mknumber(totals.count));
+        json_append_member(branch, "total_ms",
+                           json_mknumber(_ms(totals.total)));
+        json_append_member(branch, "max_ms", json_mknumber(_ms(totals.max)));
+        JsonNode *phases(json_mkobject());
+        for (int i = 0; i < NUM_TRANSITION_PHASES; ++i)
+        {
+            json_append_member(phases, transition_phase_names[i],
+                               json_mknumber(_ms(totals.phases[i])));
+        }
+        json_append_member(branch, "phases_ms", phases);
+        json_append_member(obj, entry.first.c_str(), branch);
+    }
+    return obj;
+}
+
+static double _hot_level_hit_rate()
+{
+    const unsigned long long loads = prof_hot_level_hits
+                                     + prof_hot_level_misses;
+    return loads ? prof_hot_level_hits * 100.0 / loads : 0.0;
+}
+
+static JsonNode *_hot_level_json()
+{
+    JsonNode *obj(json_mkobject());
+    json_append_member(obj, "hits", json_mknumber(prof_hot_level_hits));
+    json_append_member(obj, "misses", json_mknumber(prof_hot_level_misses));
+    json_append_member(obj, "hit_rate", json_mknumber(_hot_level_hit_rate()));
+    return obj;
+}
+
+/// A human-readable summary of the counters, with per-turn histograms.
+string prof_report()
+{
+#ifdef PROFILE_COUNTERS
+    string out = make_stringf("Subsystem timings over %d turns (in ms; "
+                              "totals include the turn in progress)\n\n",
+                              prof_turn_count);
+    out += make_stringf("%-18s %10s %12s %10s %10s\n",
+                        "section", "calls", "total", "per turn", "max turn");
+    for (int i = 0; i < NUM_PROF_SECTIONS; ++i)
+    {
+        const prof_counter &c = prof_counters[i];
+        const double total = _ms(c.total + _pending(c));
+        out += make_stringf("%-18s %10llu %12.2f %10.4f %10.2f\n",
+                            prof_section_names[i], c.calls + c.turn_calls,
+                            total,
+                            prof_turn_count ? total / prof_turn_count : 0.0,
+                            _ms(c.max_turn));
+    }
+
+    out += "\nTime taken per turn:\n";
+    for (int i = 0; i < NUM_PROF_SECTIONS; ++i)
+    {
+        const prof_counter &c = prof_counters[i];
+        if (!c.calls)
+            continue;
+
+        out += make_stringf("\n%s\n", prof_section_names[i]);
+        for (int b = 0; b < PROF_BUCKETS; ++b)
+        {
+            if (!c.histogram[b])
+                continue;
+            out += make_stringf("  %8s - %-8s %10llu %6.2f%%\n",
+                                b ? _bucket_limit(b - 1).c_str() : "0",
+                                _bucket_limit(b).c_str(), c.histogram[b],
+                                c.histogram[b] * 100.0 / prof_turn_count);
+        }
+    }
+
+    out += make_stringf("\nHot levels: %llu loaded from memory, %llu from "
+                        "the save (%.1f%% hit rate)\n",
+                        prof_hot_level_hits, prof_hot_level_misses,
+                        _hot_level_hit_rate());
+    out += make_stringf("Monster tracers: %llu fired, %llu reused (%.1f%% "
+                        "reuse rate)\n",
+                        prof_tracers_fired, prof_tracers_reused,
+                        _tracer_reuse_rate());
+
+    if (!transition_branches.empty())
+    {
+        out += "\nLevel transitions by branch arrived in (mean ms per "
+               "transition):\n\n";
+        out += make_stringf("%-8s %6s %8s %8s", "branch", "count", "mean",
+                            "max");
+        for (const char *name : transition_phase_names)
+            out += make_stringf(" %8s", name);
+        out += "\n";
+        for (const auto &entry : transition_branches)
+        {
+            const transition_totals &totals = entry.second;
+            out += make_stringf("%-8s %6d %8.2f %8.2f", entry.first.c_str(),
+                                totals.count,
+                                _ms(totals.total) / totals.count,
+                                _ms(totals.max));
+            for (auto phase : totals.phases)
+                out += make_stringf(" %8.2f", _ms(phase) / totals.count);
+            out += "\n";
+        }
+    }
+    return out;
+#else
+    return "This build doesn't keep subsystem timings; rebuild with "
+           "PROFILE_COUNTERS=y.\n";
+#endif
+}
+
+/**
+ * The counters as a JSON object: the number of turns, and for each section
+ * its calls, total and maximum per-turn time (in ms), and the per-turn
+ * histogram (bucket n counting turns taking under 2^n microseconds); the
+ * hot level cache's hits and misses; monster tracers fired and reused; and
+ * for each branch arrived in by a level transition, their count, total and
+ * maximum time and the total time for each phase (in ms).
+ */
+JsonNode *prof_json()
+{
+    JsonNode *obj(json_mkobject());
+#ifdef PROFILE_COUNTERS
+    json_append_member(obj, "turns", json_mknumber(prof_turn_count));
+    JsonNode *sections(json_mkobject());
+    for (int i = 0; i < NUM_PROF_SECTIONS; ++i)
+    {
+        const prof_counter &c = prof_counters[i];
+        JsonNode *section(json_mkobject());
+        json_append_member(section, "calls",
+                           json_mknumber(c.calls + c.turn_calls));
+        json_append_member(section, "total_ms",
+                           json_mknumber(_ms(c.total + _pending(c))));
+        json_append_member(section, "max_turn_ms",
+                           json_mknumber(_ms(c.max_turn)));
+
+        int last = PROF_BUCKETS - 1;
+        while (last >= 0 && !c.histogram[last])
+            --last;
+        JsonNode *histogram(json_mkarray());
+        for (int b = 0; b <= last; ++b)
+            json_append_element(histogram, json_mknumber(c.histogram[b]));
+        json_append_member(section, "histogram", histogram);
+
+        json_append_member(sections, prof_section_names[i], section);
+    }
+    json_append_member(obj, "sections", sections);
+#endif
+    json_append_member(obj, "hot_levels", _hot_level_json());
+    json_append_member(obj, "tracers", _tracers_json());
+    json_append_member(obj, "transitions", _transitions_json());
+    return obj;
+}
+
+/// Ask for the report to be written to filename when the game exits.
+void prof_report_at_exit(const string &filename)
+{
+#ifdef PROFILE_COUNTERS
+    prof_exit_file = filename;
+#else
+    UNUSED(filename);
+#endif
+}
+
+/// Send the final counters to the webtiles server, if it's listening.
+void prof_send_final()
+{
+#if defined(PROFILE_COUNTERS) && defined(USE_TILE_WEB)
+    _send_profile();
+#endif
+}
+
+/// Write the -bench results for the game to filename at exit.
+void prof_bench_at_exit(const string &filename)
+{
+    bench_file = filename;
+}
+
+/// Exit after timing this many turns (if benchmarking).
+void prof_bench_turn_limit(int turns)
+{
+    bench_turn_limit = turns;
+}
+
+static long _peak_rss_kb()
+{
+#ifdef UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return -1;
+# ifdef TARGET_OS_MACOSX
+    return usage.ru_maxrss / 1024; // bytes, here
+# else
+    return usage.ru_maxrss;
+# endif
+#else
+    return -1;
+#endif
+}
+
+static void _write_bench_results()
+{
+    const int turns = max(prof_turn_count - 1, 0);
+    const double secs = turns ? chrono::duration<double>(
+                                    prof_clock::now() - bench_start).count()
+                              : 0.0;
+    const unsigned long long actions = turns ? prof_monster_actions
+                                               - bench_start_actions
+                                             : 0;
+
+    JsonWrapper json(json_mkobject());
+    json_append_member(json.node, "turns", json_mknumber(turns));
+    json_append_member(json.node, "seconds", json_mknumber(secs));
+    json_append_member(json.node, "turns_per_sec",
+                       json_mknumber(secs > 0 ? turns / secs : 0));
+    json_append_member(json.node, "monster_actions", json_mknumber(actions));
+    json_append_member(json.node, "monster_actions_per_sec",
+                       json_mknumber(secs > 0 ? actions / secs : 0));
+    const long rss = _peak_rss_kb();
+    json_append_member(json.node, "peak_rss_kb",
+                       rss >= 0 ? json_mknumber(rss) : json_mknull());
+    json_append_member(json.node, "hot_levels", _hot_level_json());
+    json_append_member(json.node, "tracers", _tracers_json());
+    json_append_member(json.node, "transitions", _transitions_json());
+#ifdef PROFILE_COUNTERS
+    json_append_member(json.node, "profile", prof_json());
+#endif
+
+    FILE *f = bench_file == "-" ? stdout : fopen_u(bench_file.c_str(), "w");
+    if (!f)
+    {
+        fprintf(stderr, "Unable to write benchmark results to %s\n",
+                bench_file.c_str());
+        return;
+    }
+    fprintf(f, "%s\n", json.to_string().c_str());
+    if (f != stdout)
+        fclose(f);
+}
+
+void prof_exit_report()
+{
+    if (!bench_file.empty())
+        _write_bench_results();
+#ifdef PROFILE_COUNTERS
+    if (prof_exit_file.empty())
+        return;
+
+    FILE *f = prof_exit_file == "-" ? stdout
+                                    : fopen_u(prof_exit_file.c_str(), "w");
+    if (!f)
+    {
+        fprintf(stderr, "Unable to write profile report to %s\n",
+                prof_exit_file.c_str());
+        return;
+    }
+    fputs(prof_report().c_str(), f);
+    if (f != stdout)
+        fclose(f);
+#endif
+}
+
+void debug_profile_report()
+{
+    formatted_scroller report;
+    report.set_more();
+    report.add_raw_text(prof_report(), false);
+    report.show();
+}
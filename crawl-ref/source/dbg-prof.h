@@ -0,0 +1,121 @@
+/**
+ * @file
+ * @brief Scoped timers and per-turn counters for the main subsystems.
+ *
+ * The timers are only compiled in when PROFILE_COUNTERS is defined (make
+ * PROFILE_COUNTERS=y); otherwise PROF_SCOPE() expands to nothing.
+ *
+ * Some things are tracked in every build. -bench reports counts of turns,
+ * monster actions, hot level loads and monster tracers. Level transitions
+ * are timed phase by phase for the transitions log.
+**/
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+using std::string;
+
+struct JsonNode;
+class level_id;
+
+enum prof_section
+{
+    PROF_WORLD_REACTS,
+    PROF_HANDLE_MONSTERS,
+    PROF_LOS_UPDATE,
+    PROF_MONSTER_PATHFIND,
+    PROF_TRAVEL_PATHFIND,
+    PROF_LEVEL_BUILDER,
+    PROF_SAVE_GAME,
+    PROF_LEVEL_LOAD,
+    PROF_SEND_MAP,
+    PROF_LUA_CALLS,
+    NUM_PROF_SECTIONS
+};
+
+// The phases of a level transition. Time spent in a phase nested inside
+// another is only charged to the inner one; time outside any is "other".
+enum transition_phase
+{
+    TRANS_OTHER,
+    TRANS_LEAVE,        // leaving the old level: followers, summons, stack
+    TRANS_SAVE,         // writing levels to the save
+    TRANS_TRAVEL,       // travel cache and stash tracker updates
+    TRANS_BUILD,        // generating new levels
+    TRANS_GHOSTS,       // loading ghosts from bones files
+    TRANS_RESTORE,      // reading the level back from the save
+    TRANS_UPDATE,       // catching the level up on the time it was away
+    TRANS_LOS,          // recomputing line of sight
+    TRANS_TILES,        // resetting the tiles view and map
+    TRANS_SEND_MAP,     // sending the new level's map to webtiles
+    TRANS_COMMIT,       // writing out and syncing the whole save
+    TRANS_ARRIVE,       // new_level(): level state and whereis updates
+    NUM_TRANSITION_PHASES
+};
+
+#define PROF_CAT2(a, b) a##b
+#define PROF_CAT(a, b) PROF_CAT2(a, b)
+
+#ifdef PROFILE_COUNTERS
+
+// Times its section from construction to destruction. Timers nested inside
+// another one for the same section only count as extra calls.
+class prof_timer
+{
+public:
+    explicit prof_timer(prof_section s);
+    ~prof_timer();
+
+    prof_timer(const prof_timer &) = delete;
+    prof_timer &operator=(const prof_timer &) = delete;
+
+private:
+    prof_section section;
+};
+
+# define PROF_SCOPE(s) prof_timer PROF_CAT(prof_scope_, __LINE__)(s)
+
+#else
+
+# define PROF_SCOPE(s) ((void) 0)
+
+#endif
+
+// Charges the time from construction to destruction to its phase, if a level
+// transition is being timed and the timer is active.
+class transition_timer
+{
+public:
+    explicit transition_timer(transition_phase p, bool when = true);
+    ~transition_timer();
+
+    transition_timer(const transition_timer &) = delete;
+    transition_timer &operator=(const transition_timer &) = delete;
+
+private:
+    bool active;
+};
+
+#define TRANSITION_PHASE(p) \
+    transition_timer PROF_CAT(transition_phase_, __LINE__)(p)
+
+void prof_begin_transition(const level_id &from);
+void prof_end_transition(const level_id &to, bool new_level);
+void prof_send_transitions();
+
+void prof_end_turn();
+void prof_count_monster_action();
+void prof_count_hot_level(bool hit);
+void prof_count_tracer_fired();
+void prof_count_tracer_reused();
+
+string prof_report();
+JsonNode *prof_json();
+void prof_report_at_exit(const string &filename);
+void prof_bench_at_exit(const string &filename);
+void prof_bench_turn_limit(int turns);
+void prof_send_final();
+void prof_exit_report();
+void debug_profile_report();
@@ -7,6 +7,7 @@
 
 #include "dbg-scan.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <cmath>
 #include <sstream>
@@ -330,6 +331,13 @@ void debug_mons_scan()
         ASSERT(m->mid > 0);
         coord_def pos = m->pos();
 
+        if (!binary_search(env.mon_slots.begin(), env.mon_slots.end(), i))
+        {
+            mprf(MSGCH_ERROR, "Monster %s at (%d, %d) is missing from "
+                              "env.mon_slots, midx = %d",
+                 m->full_name(DESC_PLAIN).c_str(), pos.x, pos.y, i);
+        }
+
         if (invalid_monster_type(m->type))
         {
             mprf(MSGCH_ERROR, "Bogus monster type %d at (%d, %d), midx = %d",
@@ -23,6 +23,10 @@
     #define DEBUG_ITEM_SCAN
     #define DEBUG_MONS_SCAN
 
+    // Check stats cached from the player's equipment against a fresh count
+    // every time they're used.
+    #define DEBUG_STAT_CACHE
+
     #define DEBUG_BONES
 #endif
 
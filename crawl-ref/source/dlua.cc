@@ -290,6 +290,7 @@ void init_dungeon_lua()
     dluaopen_crawl(dlua);
     dluaopen_file(dlua);
     dluaopen_mapgrd(dlua);
+    dluaopen_gridbuf(dlua);
     dluaopen_monsters(dlua);
     dluaopen_you(dlua);
     dluaopen_dgn(dlua);
@@ -28,6 +28,7 @@
 #include "describe.h"
 #include "directn.h"
 #include "dbg-maps.h"
+#include "dbg-prof.h"
 #include "dbg-scan.h"
 #include "dgn-delve.h"
 #include "dgn-height.h"
@@ -274,6 +275,8 @@ int dgn_builder_y()
  *********************************************************************/
 bool builder(bool enable_random_maps)
 {
+    PROF_SCOPE(PROF_LEVEL_BUILDER);
+
 #ifndef DEBUG_FULL_DUNGEON_SPAM
     // hide builder debug spam by default -- this is still collected by a tee
     // and accessible via &ctrl-l without this #define.
@@ -776,6 +779,7 @@ void dgn_reset_player_data()
     you.octopus_king_rings = 0x00;
     you.item_description.init(255); // random names need reset after this, e.g.
                                     // via debug.dungeon_setup()
+    invalidate_item_names();
     you.attribute[ATTR_GOLD_GENERATED] = 0;
     // potentially relevant for item placement in e.g. troves:
     you.seen_weapon.init(0);
@@ -959,49 +963,99 @@ static bool _dgn_fill_zone(
     bool (*passable)(const coord_def &) = _dgn_square_is_passable,
     bool (*iswanted)(const coord_def &) = nullptr)
 {
+    // Every cell is marked before it is queued, so it is queued at most
+    // once and a flat queue of one slot per cell is enough; no fill
+    // reenters another, so it can be shared.
+    static coord_def queue[GXM * GYM];
+    int head = 0, tail = 0;
     bool ret = false;
-    list<coord_def> points[2];
-    int cur = 0;
-#ifdef DEBUG_DIAGNOSTICS
-    int found_points = 0;
-#endif
 
     // No bounds checks, assuming the level has at least one layer of
     // rock border.
 
-    for (points[cur].push_back(start); !points[cur].empty();)
+    travel_point_distance[start.x][start.y] = zone;
+    queue[tail++] = start;
+    while (head < tail)
     {
-        for (const auto &c : points[cur])
+        const coord_def c = queue[head++];
+
+        if (iswanted && iswanted(c))
+            ret = true;
+
+        for (int i = 0; i < 8; ++i)
         {
-            travel_point_distance[c.x][c.y] = zone;
-#ifdef DEBUG_DIAGNOSTICS
-            found_points++;
-#endif
+            const coord_def cp = c + Compass[i];
+            if (!map_bounds(cp)
+                || travel_point_distance[cp.x][cp.y] || !passable(cp))
+            {
+                continue;
+            }
+
+            travel_point_distance[cp.x][cp.y] = zone;
+            record_point(cp);
+            queue[tail++] = cp;
+        }
+    }
+    dprf("Zone %d contains %d points from seed %d,%d", zone, tail,
+        start.x, start.y);
+    return ret;
+}
 
-            if (iswanted && iswanted(c))
-                ret = true;
+static int _zone_root(int *parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// Counts the zones _dgn_fill_zone would find, without filling any: one
+// scanline pass joins each passable cell to the passable neighbours
+// already scanned, in a union-find over the whole map. If iswanted is
+// given, counts only the zones with no wanted cell in them.
+static int _dgn_count_zones(bool (*passable)(const coord_def &),
+                            bool (*iswanted)(const coord_def &))
+{
+    static int parent[GXM * GYM];
+    static bool wanted[GXM * GYM];
+    // Already-scanned neighbours: W, NW, N and NE.
+    static const coord_def back[] = { {-1, 0}, {-1, -1}, {0, -1}, {1, -1} };
 
-            for (adjacent_iterator ai(c); ai; ++ai)
+    for (int y = 0; y < GYM; ++y)
+        for (int x = 0; x < GXM; ++x)
+        {
+            const coord_def c(x, y);
+            const int i = y * GXM + x;
+            if (!map_bounds(c) || !passable(c))
             {
-                const coord_def& cp = *ai;
-                if (!map_bounds(cp)
-                    || travel_point_distance[cp.x][cp.y] || !passable(cp))
-                {
+                parent[i] = -1;
+                continue;
+            }
+
+            parent[i] = i;
+            wanted[i] = iswanted && iswanted(c);
+            for (const coord_def &d : back)
+            {
+                const coord_def n = c + d;
+                if (!map_bounds(n) || parent[n.y * GXM + n.x] < 0)
                     continue;
-                }
 
-                travel_point_distance[cp.x][cp.y] = zone;
-                record_point(cp);
-                points[!cur].push_back(cp);
+                const int a = _zone_root(parent, i);
+                const int b = _zone_root(parent, n.y * GXM + n.x);
+                if (a == b)
+                    continue;
+                parent[a] = b;
+                wanted[b] = wanted[b] || wanted[a];
             }
         }
 
-        points[cur].clear();
-        cur = !cur;
-    }
-    dprf("Zone %d contains %d points from seed %d,%d", zone, found_points,
-        start.x, start.y);
-    return ret;
+    int zones = 0;
+    for (int i = 0; i < GXM * GYM; ++i)
+        if (parent[i] == i && (!iswanted || !wanted[i]))
+            ++zones;
+    return zones;
 }
 
 static bool _is_perm_down_stair(const coord_def &c)
@@ -1108,19 +1162,28 @@ static bool _is_exit_stair(const coord_def &c)
 // If fill is non-zero, it fills any disconnected regions with fill.
 //
 // TODO: refactor this to something more usable
-static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
-                bool choose_stairless,
+static int _process_disconnected_zones(bool choose_stairless,
                 dungeon_feature_type fill,
                 bool (*passable)(const coord_def &) = _dgn_square_is_passable,
                 bool (*fill_check)(const coord_def &) = nullptr,
                 int fill_small_zones = 0)
 {
+    bool (*exit_stair)(const coord_def &) =
+        choose_stairless ? (at_branch_bottom() ? _is_upwards_exit_stair
+                                               : _is_exit_stair)
+                         : nullptr;
+
+    // Just counting, which the builder does after every vault: no need to
+    // know which cell is in which zone.
+    if (!fill)
+        return _dgn_count_zones(passable, exit_stair);
+
     memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
     int nzones = 0;
     int ngood = 0;
-    for (int y = y1; y <= y2 ; ++y)
+    for (int y = 0; y < GYM; ++y)
     {
-        for (int x = x1; x <= x2; ++x)
+        for (int x = 0; x < GXM; ++x)
         {
             if (!map_bounds(x, y)
                 || travel_point_distance[x][y]
@@ -1134,11 +1197,7 @@ static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
 
             const bool found_exit_stair =
                 _dgn_fill_zone(coord_def(x, y), ++nzones,
-                               inc_zone_size,
-                               passable,
-                               choose_stairless ? (at_branch_bottom() ?
-                                                   _is_upwards_exit_stair :
-                                                   _is_exit_stair) : nullptr);
+                               inc_zone_size, passable, exit_stair);
 
             // If we want only stairless zones, screen out zones that did
             // have stairs.
@@ -1154,9 +1213,9 @@ static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
                 bool veto = false;
                 vector<coord_def> coords;
                 dprf("Filling zone %d", nzones);
-                for (int fy = y1; fy <= y2 ; ++fy)
+                for (int fy = 0; fy < GYM; ++fy)
                 {
-                    for (int fx = x1; fx <= x2; ++fx)
+                    for (int fx = 0; fx < GXM; ++fx)
                     {
                         if (travel_point_distance[fx][fy] == nzones)
                         {
@@ -1206,8 +1265,8 @@ static int _process_disconnected_zones(int x1, int y1, int x2, int y2,
 int dgn_count_tele_zones(bool choose_stairless)
 {
     dprf("Counting teleport zones");
-    return _process_disconnected_zones(0, 0, GXM-1, GYM-1, choose_stairless,
-                                    DNGN_UNSEEN, _dgn_square_is_tele_connected);
+    return _process_disconnected_zones(choose_stairless, DNGN_UNSEEN,
+                                       _dgn_square_is_tele_connected);
 }
 
 // Count number of mutually isolated zones. If choose_stairless, only count
@@ -1216,8 +1275,7 @@ int dgn_count_tele_zones(bool choose_stairless)
 int dgn_count_disconnected_zones(bool choose_stairless,
                                  dungeon_feature_type fill)
 {
-    return _process_disconnected_zones(0, 0, GXM-1, GYM-1, choose_stairless,
-                                       fill);
+    return _process_disconnected_zones(choose_stairless, fill);
 }
 
 static void _fill_small_disconnected_zones()
@@ -1225,10 +1283,10 @@ static void _fill_small_disconnected_zones()
     // debugging tip: change the feature to something like lava that will be
     // very noticeable.
     // TODO: make even more aggressive, up to ~25?
-    _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_ROCK_WALL,
-                                       _dgn_square_is_passable,
-                                       _dgn_square_is_boring,
-                                       10);
+    _process_disconnected_zones(true, DNGN_ROCK_WALL,
+                                _dgn_square_is_passable,
+                                _dgn_square_is_boring,
+                                10);
 }
 
 static void _fixup_hell_stairs()
@@ -2302,6 +2360,8 @@ static bool _branch_needs_stairs()
 
 static void _dgn_verify_connectivity(unsigned nvaults)
 {
+    MAPSTAT_TIMER(BPHASE_CONNECTIVITY);
+
     // After placing vaults, make sure parts of the level have not been
     // disconnected.
     if (dgn_zones && nvaults != env.level_vaults.size())
@@ -2745,6 +2805,7 @@ static void _build_dungeon_level()
     {
         if (place_vaults)
         {
+            MAPSTAT_TIMER(BPHASE_EXTRA_VAULTS);
             // Moved branch entries to place first so there's a good
             // chance of having room for a vault
             _place_branch_entrances(true);
@@ -2754,6 +2815,7 @@ static void _build_dungeon_level()
         }
         else
         {
+            MAPSTAT_TIMER(BPHASE_EXTRA_VAULTS);
             // Place any branch entries vaultlessly
             _place_branch_entrances(false);
             // Still place chance vaults - important things like Abyss,
@@ -3025,6 +3087,7 @@ static bool _builder_by_type()
 {
     if (player_in_branch(BRANCH_ABYSS))
     {
+        MAPSTAT_TIMER(BPHASE_LAYOUT);
         generate_abyss();
         // Should place some vaults in abyss because
         // there's never an encompass vault
@@ -3032,6 +3095,7 @@ static bool _builder_by_type()
     }
     else if (player_in_branch(BRANCH_PANDEMONIUM))
     {
+        MAPSTAT_TIMER(BPHASE_LAYOUT);
         // Generate a random monster table for Pan.
         init_pandemonium();
         setup_vault_mon_list();
@@ -3522,6 +3586,7 @@ static bool _builder_normal()
 
     if (vault)
     {
+        MAPSTAT_TIMER(BPHASE_PRIMARY_VAULT);
         // TODO: figure out a good way to do this only in Temple
         dgn_map_parameters mp(
             you.props.exists(TEMPLE_SIZE_KEY)
@@ -3540,6 +3605,7 @@ static bool _builder_normal()
 
     if (vault)
     {
+        MAPSTAT_TIMER(BPHASE_PRIMARY_VAULT);
         env.level_build_method += " random_map_in_depth";
         _ensure_vault_placed_ex(_build_primary_vault(vault), vault);
         // Only place subsequent random vaults on non-encompass maps
@@ -3547,6 +3613,7 @@ static bool _builder_normal()
         return vault->orient != MAP_ENCOMPASS;
     }
 
+    MAPSTAT_TIMER(BPHASE_LAYOUT);
     vault = random_map_for_tag("layout", true, true);
 
     if (!vault)
@@ -4141,6 +4208,8 @@ bool door_vetoed(const coord_def pos)
 
 static void _builder_monsters()
 {
+    MAPSTAT_TIMER(BPHASE_MONSTERS);
+
     if (player_in_branch(BRANCH_TEMPLE))
         return;
 
@@ -4236,6 +4305,8 @@ static void _randomly_place_item(int item)
  */
 static void _builder_items()
 {
+    MAPSTAT_TIMER(BPHASE_ITEMS);
+
     int i = 0;
     object_class_type specif_type = OBJ_RANDOM;
     int items_levels = env.absdepth0;
@@ -4543,6 +4614,8 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
                   bool build_only, bool check_collisions,
                   bool make_no_exits, const coord_def &where)
 {
+    MAPSTAT_TIMER(*vault);
+
     if (dgn_check_connectivity && !dgn_zones)
     {
         dgn_zones = dgn_count_disconnected_zones(false);
@@ -4648,13 +4721,13 @@ static const vault_placement *_build_vault_impl(const map_def *vault,
     if (!build_only && (placed_vault_orientation != MAP_ENCOMPASS || is_layout)
         && player_in_branch(BRANCH_SWAMP))
     {
-        _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_MANGROVE);
+        _process_disconnected_zones(true, DNGN_MANGROVE);
         // do a second pass to remove tele closets consisting of deep water
         // created by the first pass -- which will not fill in deep water
         // because it is treated as impassable.
         // TODO: get zonify to prevent these?
         // TODO: does this come up anywhere outside of swamp?
-        _process_disconnected_zones(0, 0, GXM-1, GYM-1, true, DNGN_MANGROVE,
+        _process_disconnected_zones(true, DNGN_MANGROVE,
                 _dgn_square_is_ever_passable);
     }
 
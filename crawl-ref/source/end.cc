@@ -14,6 +14,7 @@
 #include "colour.h"
 #include "crash.h"
 #include "database.h"
+#include "dbg-prof.h"
 #include "describe.h"
 #include "dungeon.h"
 #include "files.h"
@@ -171,6 +172,7 @@ NORETURN void end(int exit_code, bool print_error, const char *format, ...)
             fatal_error_notification(error);
 
 #ifdef USE_TILE_WEB
+        prof_send_final();
         tiles.shutdown();
 #endif
 
@@ -181,6 +183,7 @@ NORETURN void end(int exit_code, bool print_error, const char *format, ...)
 #ifdef DEBUG_PROPS
         dump_prop_accesses();
 #endif
+        prof_exit_report();
 
         if (!error.empty())
         {
@@ -42,6 +42,14 @@ struct crawl_environment
     // completely safe if it's an overestimate - just not an underestimate.
     int                             max_mon_index;
 
+    // Sorted indices of the slots in mons that might currently contain a
+    // real monster, so that iterators and per-turn scans only touch the few
+    // monster objects in use rather than striding over all of mons. Like
+    // max_mon_index, slots are added by get_free_monster() and dead ones are
+    // pruned by clear_monster_flags(); it may hold dead slots, but must never
+    // miss a live one.
+    vector<int>                     mon_slots;
+
     feature_grid                             grid;  // terrain grid
     FixedArray<terrain_property_t, GXM, GYM> pgrid; // terrain properties
     FixedArray< unsigned short, GXM, GYM >   mgrid; // monster grid
@@ -43,6 +43,7 @@
 #include "cloud.h"
 #include "coordit.h"
 #include "dactions.h"
+#include "dbg-prof.h"
 #include "dbg-util.h"
 #include "dgn-overview.h"
 #include "directn.h"
@@ -140,6 +141,8 @@ static bool _ghost_version_compatible(const save_version &version);
 
 static bool _restore_tagged_chunk(package *save, const string &name,
                                   tag_type tag, const char* complaint);
+static bool _restore_tagged_chunk(reader &inf, const string &name,
+                                  tag_type tag, const char* complaint);
 static player_save_info _read_character_info(package *save);
 
 static bool _convert_obsolete_species();
@@ -1055,6 +1058,89 @@ static void _write_tagged_chunk(const string &chunkname, tag_type tag)
     tag_write(tag, outf);
 }
 
+// The levels written most recently, most recent first, kept as the exact
+// bytes of their chunks before compression. Going back to one of these reads
+// it from memory, rather than reading and inflating its chunk again.
+struct hot_level
+{
+    string name;
+    vector<unsigned char> data;
+};
+#define MAX_HOT_LEVELS 4
+static vector<hot_level> hot_levels;
+
+static vector<hot_level>::iterator _find_hot_level(const string &name)
+{
+    return find_if(hot_levels.begin(), hot_levels.end(),
+                   [&name](const hot_level &h) { return h.name == name; });
+}
+
+static void _forget_hot_level(const string &name)
+{
+    auto it = _find_hot_level(name);
+    if (it != hot_levels.end())
+        hot_levels.erase(it);
+}
+
+// Forget every level, when a different save is opened.
+void forget_hot_levels()
+{
+    hot_levels.clear();
+}
+
+static void _remember_hot_level(const string &name,
+                                vector<unsigned char> &data)
+{
+    _forget_hot_level(name);
+    if (hot_levels.size() >= MAX_HOT_LEVELS)
+        hot_levels.pop_back();
+    hot_levels.insert(hot_levels.begin(), hot_level());
+    hot_levels.front().name = name;
+    hot_levels.front().data.swap(data);
+}
+
+// Level chunks are the only ones kept hot: save the level to the package,
+// and keep the bytes written.
+static void _write_level_chunk(const string &chunkname)
+{
+    vector<unsigned char> data;
+    {
+        writer buf(&data);
+        write_save_version(buf, save_version::current());
+        tag_write(TAG_LEVEL, buf);
+    }
+    {
+        writer outf(you.save, chunkname);
+        outf.write(data.data(), data.size());
+    }
+    _remember_hot_level(chunkname, data);
+}
+
+static void _restore_level_chunk(const string &chunkname)
+{
+    TRANSITION_PHASE(TRANS_RESTORE);
+    auto it = _find_hot_level(chunkname);
+    prof_count_hot_level(it != hot_levels.end());
+    if (it == hot_levels.end())
+    {
+        _restore_tagged_chunk(you.save, chunkname, TAG_LEVEL,
+                              "Level file is invalid.");
+        return;
+    }
+
+    // Take the bytes out while reading them, in case reading the level
+    // writes another one; they're still what's saved, so put them back after.
+    vector<unsigned char> data;
+    data.swap(it->data);
+    hot_levels.erase(it);
+    {
+        reader inf(data);
+        _restore_tagged_chunk(inf, chunkname, TAG_LEVEL,
+                              "Level file is invalid.");
+    }
+    _remember_hot_level(chunkname, data);
+}
+
 static int _get_dest_stair_type(dungeon_feature_type stair_taken,
                                 bool &find_first)
 {
@@ -1223,6 +1309,7 @@ static void _expire_temporary_allies()
 
 static void _grab_followers_and_expire_summons()
 {
+    TRANSITION_PHASE(TRANS_LEAVE);
     int non_stair_using_allies = 0;
     int non_stair_using_undead = 0;
     int non_stair_using_summons = 0;
@@ -1369,6 +1456,7 @@ static void _do_lost_items()
 static bool _leave_level(dungeon_feature_type stair_taken,
                          const level_id& old_level, coord_def *return_pos)
 {
+    TRANSITION_PHASE(TRANS_LEAVE);
     bool popped = false;
 
     if (!you.level_stack.empty()
@@ -1520,6 +1608,7 @@ static void _place_player(dungeon_feature_type stair_taken,
 // note: also run on load for some reason in startup.cc
 void trackers_init_new_level()
 {
+    TRANSITION_PHASE(TRANS_TRAVEL);
     travel_init_new_level();
 }
 
@@ -1877,6 +1966,7 @@ static bool _branch_pregenerates(branch_type b)
 */
 bool pregen_dungeon(const level_id &stopping_point)
 {
+    TRANSITION_PHASE(TRANS_BUILD);
     // TODO: the is_valid() check here doesn't look quite right to me, but so
     // far I can't get it to break anything...
     if (stopping_point.is_valid()
@@ -2085,6 +2175,7 @@ static void _learn_transporters()
 bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
                 const level_id& old_level)
 {
+    PROF_SCOPE(PROF_LEVEL_LOAD);
     const string level_name = level_id::current().describe();
     if (!you.save->has_chunk(level_name) && load_mode == LOAD_VISITOR)
         return false;
@@ -2158,6 +2249,7 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
 #ifdef USE_TILE
     if (load_mode != LOAD_VISITOR)
     {
+        TRANSITION_PHASE(TRANS_TILES);
         tiles.clear_minimap();
         crawl_view_buffer empty_vbuf;
         tiles.load_dungeon(empty_vbuf, crawl_view.vgrdc);
@@ -2216,7 +2308,7 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
         }
 
         dprf("Loading old level '%s'.", level_name.c_str());
-        _restore_tagged_chunk(you.save, level_name, TAG_LEVEL, "Level file is invalid.");
+        _restore_level_chunk(level_name);
         if (load_mode != LOAD_VISITOR)
             you.on_current_level = true;
         _redraw_all(); // TODO why is there a redraw call here?
@@ -2534,13 +2626,17 @@ bool load_level(dungeon_feature_type stair_taken, load_mode_type load_mode,
 
 void save_level(const level_id& lid)
 {
+    TRANSITION_PHASE(TRANS_SAVE);
     if (you.level_visited(lid))
+    {
+        TRANSITION_PHASE(TRANS_TRAVEL);
         travel_cache.get_level_info(lid).update();
+    }
 
     // Nail all items to the ground.
     fix_item_coordinates();
 
-    _write_tagged_chunk(lid.describe(), TAG_LEVEL);
+    _write_level_chunk(lid.describe());
 }
 
 #if TAG_MAJOR_VERSION == 34
@@ -2621,6 +2717,7 @@ static void _save_game_exit()
 
 void save_game(bool leave_game, const char *farewellmsg)
 {
+    PROF_SCOPE(PROF_SAVE_GAME);
     unwind_bool saving_game(crawl_state.saving_game, true);
     // Should you.no_save disable more here? Currently it entails an empty
     // package, and persists won't save, but there's a bunch of other stuff
@@ -2676,6 +2773,7 @@ void save_game(bool leave_game, const char *farewellmsg)
 // Saves the game without exiting.
 void save_game_state()
 {
+    TRANSITION_PHASE(TRANS_COMMIT);
     save_game(false);
     if (crawl_state.seen_hups)
         save_game(true);
@@ -3055,6 +3153,7 @@ static vector<ghost_demon> _load_permastore_ghosts(bool backup_on_upgrade=false)
  */
 bool define_ghost_from_bones(monster& mons)
 {
+    TRANSITION_PHASE(TRANS_GHOSTS);
     rng::generator rng(rng::SYSTEM_SPECIFIC);
 
     bool used_permastore = false;
@@ -3197,6 +3296,7 @@ static bool _restore_game(const string& filename)
     clear_message_store();
 
     you.save = new package((_get_savefile_directory() + filename).c_str(), true);
+    forget_hot_levels();
 
     player_save_info save_info = _read_character_info(you.save);
     if (!save_info.save_loadable)
@@ -3383,6 +3483,7 @@ void delete_level(const level_id &level)
 
     if (you.save)
         you.save->delete_chunk(level.describe());
+    _forget_hot_level(level.describe());
 
     auto &visited = you.props[VISITED_LEVELS_KEY].get_table();
     visited.erase(level.describe());
@@ -3687,6 +3788,12 @@ static bool _restore_tagged_chunk(package *save, const string &name,
                                   tag_type tag, const char* complaint)
 {
     reader inf(save, name);
+    return _restore_tagged_chunk(inf, name, tag, complaint);
+}
+
+static bool _restore_tagged_chunk(reader &inf, const string &name,
+                                  tag_type tag, const char* complaint)
+{
     string reason;
     if (!_tagged_chunk_version_compatible(inf, &reason))
     {
@@ -138,6 +138,107 @@ void formatted_string::parse_string_to_multiple(const string &s,
     }
 }
 
+void formatted_string::wrap_to_multiple(vector<formatted_string> &out,
+                                        int wrap_col) const
+{
+    // The text, and the colour changes to make along the way.
+    string text;
+    vector<pair<size_t, const fs_op *>> changes;
+    for (const fs_op &op : ops)
+    {
+        if (op.type == FSOP_TEXT)
+            text += op.text;
+        else
+            changes.emplace_back(text.size(), &op);
+    }
+
+    // As in parse_string_to_multiple(), every line starts with the current
+    // colour, and the background too once one has been set.
+    int colour = LIGHTGREY, bg = BLACK;
+    bool bg_set = false;
+    size_t next_change = 0;
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = text.find('\n', start);
+        if (end == string::npos)
+            end = text.size();
+
+        // wordwrap_line() has to see each line as it would in the output of
+        // to_colour_string() to break and indent it the same way, but
+        // nothing needs the colours' names: each change is an empty "<>"
+        // tag, and '<' is doubled as usual.
+        string line;
+        size_t change = next_change;
+        for (size_t i = start; i <= end; ++i)
+        {
+            while (change < changes.size() && changes[change].first == i)
+            {
+                line += "<>";
+                ++change;
+            }
+            if (i < end)
+            {
+                if (text[i] == '<')
+                    line += '<';
+                line += text[i];
+            }
+        }
+
+        do
+        {
+            string piece;
+            if (wrap_col > 0)
+                piece = wordwrap_line(line, wrap_col, true, true);
+            else
+                piece.swap(line);
+
+            out.emplace_back();
+            formatted_string &fs = out.back();
+            fs.textcolour(colour);
+            if (bg_set)
+                fs.textbackground(bg);
+            size_t run = 0;
+            for (size_t i = 0; i < piece.size(); ++i)
+            {
+                if (piece[i] != '<')
+                    continue;
+                if (i > run)
+                    fs.cprintf(piece.substr(run, i - run));
+                if (piece[++i] == '<')
+                {
+                    run = i;
+                    continue;
+                }
+                run = i + 1;
+                const fs_op &op = *changes[next_change++].second;
+                if (op.type == FSOP_BG)
+                {
+                    bg = op.colour;
+                    bg_set = true;
+                    fs.textbackground(bg);
+                }
+                else
+                {
+                    colour = op.colour;
+                    fs.textcolour(colour);
+                }
+            }
+            if (run < piece.size())
+                fs.cprintf(piece.substr(run));
+            if (colour != LIGHTGREY)
+                fs.textcolour(LIGHTGREY);
+            if (bg != BLACK)
+                fs.textbackground(BLACK);
+        }
+        while (!line.empty());
+
+        if (end == text.size())
+            break;
+        start = end + 1;
+    }
+}
+
 // Helper for the other parse_ methods.
 void formatted_string::parse_string1(const string &s, formatted_string &fs,
                                      vector<int> &colour_stack,
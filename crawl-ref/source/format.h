@@ -64,6 +64,11 @@ public:
                                          vector<formatted_string> &out,
                                          int wrap_col = 0);
 
+    // The same lines as parse_string_to_multiple(to_colour_string(), out,
+    // wrap_col), without the round trip through colour tags.
+    void wrap_to_multiple(vector<formatted_string> &out,
+                          int wrap_col = 0) const;
+
 
 private:
     static int get_colour(const string &tag);
@@ -103,6 +103,14 @@ static string _log_file_name(bool milestones=false)
         + crawl_state.game_type_qualifier());
 }
 
+#ifdef DGL_MILESTONES
+static string _transitions_file_name()
+{
+    return catpath(Options.shared_dir,
+                   "transitions" + crawl_state.game_type_qualifier());
+}
+#endif
+
 int hiscores_new_entry(const scorefile_entry &ne)
 {
     unwind_bool score_update(crawl_state.updating_scores, true);
@@ -3215,6 +3223,45 @@ void mark_milestone(const string &type, const string &milestone,
 #endif // USE_TILE_WEB
 }
 
+/**
+ * Log how long a level transition took, as an xlog line in the transitions
+ * file next to the milestones file, and to the webtiles server if asked.
+ *
+ * @param timings  Fields to add to the player's usual xlog fields.
+ * @param send     Whether to send the line to the webtiles server.
+ */
+void mark_level_transition(const vector<pair<string, string>> &timings,
+                           bool send)
+{
+#if defined(USE_TILE_WEB) || defined(DGL_MILESTONES)
+    if (crawl_state.game_is_arena() || !crawl_state.need_save)
+        return;
+
+    const scorefile_entry se(0, MID_NOBODY, KILL_NON_ACTOR, nullptr);
+    se.set_base_xlog_fields();
+    xlog_fields xl = se.get_fields();
+    xl.add_field("time", "%s", make_date_string(time(nullptr)).c_str());
+    xl.add_field("type", "transition");
+    for (const auto &field : timings)
+        xl.add_field(field.first, "%s", field.second.c_str());
+#ifdef USE_TILE_WEB
+    if (send && !crawl_state.game_crashed)
+        tiles.send_level_transition(xl);
+#else
+    UNUSED(send);
+#endif
+#ifdef DGL_MILESTONES
+    if (FILE *fp = lk_open("a", _transitions_file_name()))
+    {
+        fprintf(fp, "%s\n", xl.xlog_line().c_str());
+        lk_close(fp);
+    }
+#endif
+#else
+    UNUSED(timings, send);
+#endif
+}
+
 #if defined(USE_TILE_WEB) || defined(DGL_WHEREIS)
 static xlog_fields _xlog_status(const char *status)
 {
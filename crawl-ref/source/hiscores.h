@@ -34,6 +34,9 @@ string hiscores_format_single_long(const scorefile_entry &se,
 void mark_milestone(const string &type, const string &milestone,
                     const string &origin_level = "", time_t t = 0);
 
+void mark_level_transition(const vector<pair<string, string>> &timings,
+                           bool send);
+
 void update_whereis(const char *status = "active");
 
 #if defined(USE_TILE_WEB)
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <cinttypes>
 #include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <iomanip>
@@ -30,6 +31,7 @@
 #include "chardump.h"
 #include "clua.h"
 #include "colour.h"
+#include "dbg-prof.h"
 #include "defines.h"
 #include "delay.h"
 #include "describe.h"
@@ -44,6 +46,7 @@
 #include "game-options.h"
 #include "ghost.h"
 #include "invent.h"
+#include "item-name.h"
 #include "item-prop.h"
 #include "items.h"
 #include "jobs.h"
@@ -2828,6 +2831,10 @@ void base_game_options::read_options(LineInput &il, bool runscripts,
         }
 #endif
     }
+
+    // Lua in the file may have (re)defined annotation and autopickup hooks.
+    if (runscripts)
+        invalidate_item_names();
 }
 
 // Note the distinction between:
@@ -3769,6 +3776,10 @@ void base_game_options::read_option_line(const string &str, bool runscripts)
     if (!state.is_valid_option_line())
         return; // either invalid, or already handled directive
 
+    // Almost any option can change item annotations (autopickup, menu
+    // colours, ...), so drop anything cached against the old values.
+    invalidate_item_names();
+
     // handle a bunch of option parsing directives that use an `=` syntax
     // should macro file loading be here?
     if (state.key == "include")
@@ -4695,6 +4706,8 @@ enum commandline_option_type
     CLO_ITERATIONS,
     CLO_FORCE_MAP,
     CLO_ARENA,
+    CLO_ARENA_BATCH,
+    CLO_ARENA_JOBS,
     CLO_DUMP_MAPS,
     CLO_TEST,
     CLO_SCRIPT,
@@ -4726,13 +4739,18 @@ enum commandline_option_type
     CLO_GAMETYPES_JSON,
     CLO_EDIT_BONES,
     CLO_DESCENT,
+    CLO_PROFILE_REPORT,
+    CLO_BENCH,
+    CLO_BENCH_TURNS,
 #if defined(UNIX) || defined(USE_TILE_LOCAL)
     CLO_HEADLESS,
 #endif
 #ifdef USE_TILE_WEB
     CLO_WEBTILES_SOCKET,
+    CLO_WEBTILES_RECORD,
     CLO_AWAIT_CONNECTION,
     CLO_PRINT_WEBTILES_OPTIONS,
+    CLO_TRANSITION_TIMING,
 #endif
     CLO_RESET_CACHE,
 
@@ -4758,12 +4776,19 @@ static set<commandline_option_type> clo_headless_ok = {
     CLO_RC,
 #endif
     CLO_ARENA,
+    CLO_ARENA_BATCH,
+    CLO_ARENA_JOBS,
     CLO_TEST,
     CLO_SCRIPT,
+    CLO_PROFILE_REPORT,
+    CLO_BENCH,
+    CLO_BENCH_TURNS,
 #ifdef USE_TILE_WEB
     CLO_WEBTILES_SOCKET,
+    CLO_WEBTILES_RECORD,
     CLO_AWAIT_CONNECTION,
     CLO_PRINT_WEBTILES_OPTIONS,
+    CLO_TRANSITION_TIMING,
     CLO_SAVE_JSON,
     CLO_GAMETYPES_JSON,
 #endif
@@ -4773,18 +4798,21 @@ static const char *cmd_ops[] =
 {
     "scores", "name", "species", "background", "dir", "rc", "rcdir", "tscores",
     "vscores", "scorefile", "morgue", "macro", "mapstat", "dump-disconnect",
-    "objstat", "iters", "force-map", "arena", "dump-maps", "test", "script",
+    "objstat", "iters", "force-map", "arena", "arena-batch", "arena-jobs",
+    "dump-maps", "test", "script",
     "builddb", "help", "version", "seed", "pregen", "save-version", "sprint",
     "extra-opt-first", "extra-opt-last", "sprint-map", "edit-save",
     "print-charset", "tutorial", "wizard", "explore", "no-save",
     "no-player-bones", "gdb", "no-gdb", "nogdb", "throttle", "no-throttle",
     "lua-max-memory", "playable-json", "branches-json", "save-json",
-    "gametypes-json", "bones", "descent",
+    "gametypes-json", "bones", "descent", "profile-report",
+    "bench", "bench-turns",
 #if defined(UNIX) || defined(USE_TILE_LOCAL)
     "headless",
 #endif
 #ifdef USE_TILE_WEB
-    "webtiles-socket", "await-connection", "print-webtiles-options",
+    "webtiles-socket", "webtiles-record", "await-connection",
+    "print-webtiles-options", "transition-timing",
 #endif
     "reset-cache",
 };
@@ -4889,6 +4917,7 @@ enum es_command_type
     ES_PUT,
     ES_REPACK,
     ES_INFO,
+    ES_BENCH,
     NUM_ES
 };
 
@@ -4917,6 +4946,7 @@ static edit_command<es_command_type> es_commands[] =
     { ES_RM,      "rm",      true,  1, 1, },
     { ES_REPACK,  "repack",  false, 0, 0, },
     { ES_INFO,    "info",    false, 0, 0, },
+    { ES_BENCH,   "bench",   false, 0, 1, },
 };
 
 static edit_command<eb_command_type> eb_commands[] =
@@ -4927,6 +4957,79 @@ static edit_command<eb_command_type> eb_commands[] =
     { EB_REWRITE,  "rewrite", true,  0, 1 },
 };
 
+// Best time of iters runs of f(), in milliseconds.
+template <typename F>
+static double _best_time_ms(int iters, F f)
+{
+    double best = 0;
+    for (int i = 0; i < iters; ++i)
+    {
+        const auto start = chrono::steady_clock::now();
+        f();
+        const double ms = chrono::duration<double, milli>(
+                              chrono::steady_clock::now() - start).count();
+        if (!i || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+// Time reading and writing each chunk of a save a byte at a time, the way
+// marshalling does, both through tags.cc's reader/writer and straight
+// through the (unbuffered) chunk streams. Writes go to a scratch package.
+static void _bench_save_chunks(package &save, const string &filename,
+                               int iters)
+{
+    const string scratch_name = filename + ".bench";
+    package scratch(scratch_name.c_str(), true, true);
+
+    vector<string> list = save.list_chunks();
+    sort(list.begin(), list.end(), numcmpstr);
+    printf("Best of %d, in ms: (size, read/write via reader/writer, read/"
+           "write via chunk streams, name)\n", iters);
+    double totals[4] = { 0, 0, 0, 0 };
+    for (const string &chunk : list)
+    {
+        vector<char> data;
+        {
+            chunk_reader in(&save, chunk);
+            in.read_all(data);
+        }
+
+        const double times[4] =
+        {
+            _best_time_ms(iters, [&]() {
+                reader in(&save, chunk);
+                for (size_t i = 0; i < data.size(); ++i)
+                    in.readByte();
+            }),
+            _best_time_ms(iters, [&]() {
+                writer out(&scratch, chunk);
+                for (char c : data)
+                    out.writeByte(c);
+            }),
+            _best_time_ms(iters, [&]() {
+                chunk_reader in(&save, chunk);
+                unsigned char c;
+                for (size_t i = 0; i < data.size(); ++i)
+                    in.read(&c, 1);
+            }),
+            _best_time_ms(iters, [&]() {
+                chunk_writer out(&scratch, chunk);
+                for (char c : data)
+                    out.write(&c, 1);
+            }),
+        };
+        printf("%8u %9.2f %9.2f %9.2f %9.2f %s\n", (unsigned int) data.size(),
+               times[0], times[1], times[2], times[3], chunk.c_str());
+        for (int i = 0; i < 4; ++i)
+            totals[i] += times[i];
+    }
+    printf("   total %9.2f %9.2f %9.2f %9.2f\n",
+           totals[0], totals[1], totals[2], totals[3]);
+    scratch.unlink();
+}
+
 #define FAIL(...) do { fprintf(stderr, __VA_ARGS__); return; } while (0)
 static void _edit_save(int argc, char **argv)
 {
@@ -4940,6 +5043,7 @@ static void _edit_save(int argc, char **argv)
                "     <chunkfile> defaults to \"chunk\"; use \"-\" for stdout/stdin\n"
                "  rm <chunk>                  delete a chunk\n"
                "  repack                      defrag and reclaim unused space\n"
+               "  bench [<iterations>]        time (un)marshalling each chunk\n"
              );
         return;
     }
@@ -5087,6 +5191,13 @@ static void _edit_save(int argc, char **argv)
             // there's also wasted space due to fragmentation, but since
             // it's linear, there's no need to print it
         }
+        else if (cmd == ES_BENCH)
+        {
+            const int iters = argc == 3 ? atoi(argv[2]) : 5;
+            if (iters <= 0)
+                FAIL("Invalid number of iterations \"%s\".\n", argv[2]);
+            _bench_save_chunks(save, filename, iters);
+        }
     }
     catch (ext_fail_exception &fe)
     {
@@ -5814,6 +5925,26 @@ bool parse_args(int argc, char **argv, bool rc_only)
             }
             break;
 
+        case CLO_ARENA_BATCH:
+            if (!next_is_param)
+                end(1, false, "Matchup file required for -%s\n", arg);
+            if (!rc_only)
+            {
+                Options.game.type = GAME_TYPE_ARENA;
+                Options.restart_after_game = false;
+                crawl_state.arena_batch = next_arg;
+            }
+            enter_headless_mode();
+            nextUsed = true;
+            break;
+
+        case CLO_ARENA_JOBS:
+            if (!next_is_param || !isadigit(*next_arg))
+                end(1, false, "Integer argument required for -%s\n", arg);
+            crawl_state.arena_jobs = atoi(next_arg);
+            nextUsed = true;
+            break;
+
         case CLO_DUMP_MAPS:
             crawl_state.dump_maps = true;
             break;
@@ -6044,6 +6175,31 @@ bool parse_args(int argc, char **argv, bool rc_only)
                 Options.game.type = GAME_TYPE_DESCENT;
             break;
 
+        case CLO_PROFILE_REPORT:
+#ifdef PROFILE_COUNTERS
+            prof_report_at_exit(next_is_param ? next_arg : "profile.txt");
+            if (next_is_param)
+                nextUsed = true;
+            break;
+#else
+            end(1, false, "-profile-report is only available in builds with "
+                          "PROFILE_COUNTERS.\n");
+#endif
+
+        case CLO_BENCH:
+            if (!next_is_param)
+                return false;
+            prof_bench_at_exit(next_arg);
+            nextUsed = true;
+            break;
+
+        case CLO_BENCH_TURNS:
+            if (!next_is_param || !isadigit(*next_arg))
+                end(1, false, "Integer argument required for -%s\n", arg);
+            prof_bench_turn_limit(atoi(next_arg));
+            nextUsed = true;
+            break;
+
         case CLO_SPRINT_MAP:
             if (!next_is_param)
                 return false;
@@ -6074,10 +6230,19 @@ bool parse_args(int argc, char **argv, bool rc_only)
             tiles.m_sock_name = next_arg;
             break;
 
+        case CLO_WEBTILES_RECORD:
+            nextUsed            = true;
+            tiles.m_record_name = next_arg;
+            break;
+
         case CLO_AWAIT_CONNECTION:
             tiles.m_await_connection = true;
             break;
 
+        case CLO_TRANSITION_TIMING:
+            prof_send_transitions();
+            break;
+
         case CLO_PRINT_WEBTILES_OPTIONS:
             if (!rc_only)
             {
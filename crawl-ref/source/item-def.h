@@ -154,6 +154,9 @@ public:
     colour_t gem_colour() const;
 
 private:
+    string name_uncached(description_level_type descrip, bool terse,
+                         bool ident, bool with_inscription,
+                         bool quantity_in_words) const;
     string name_aux(description_level_type desc, bool terse, bool ident,
                     bool with_inscription) const;
 
@@ -11,6 +11,7 @@
 #include <cstring>
 #include <iomanip>
 #include <sstream>
+#include <unordered_map>
 
 #include "areas.h"
 #include "artefact.h"
@@ -133,12 +134,152 @@ static string _item_inscription(const item_def &item)
                                              ", ").c_str());
 }
 
+// Everything about an item and a name() call that the name can depend on,
+// for items where _name_memo_applies().
+struct item_name_key
+{
+    object_class_type base_type;
+    uint8_t sub_type;
+    short plus;
+    short plus2;
+    int special;
+    uint8_t rnd;
+    short quantity;
+    iflags_t flags;
+    short slot;
+    short orig_monnum;
+    bool in_inventory;
+    string inscription;
+    description_level_type descrip;
+    bool terse;
+    bool ident;
+    bool with_inscription;
+    bool quantity_in_words;
+
+    bool operator==(const item_name_key &o) const
+    {
+        return base_type == o.base_type && sub_type == o.sub_type
+               && plus == o.plus && plus2 == o.plus2
+               && special == o.special && rnd == o.rnd
+               && quantity == o.quantity && flags == o.flags
+               && slot == o.slot && orig_monnum == o.orig_monnum
+               && in_inventory == o.in_inventory
+               && inscription == o.inscription && descrip == o.descrip
+               && terse == o.terse && ident == o.ident
+               && with_inscription == o.with_inscription
+               && quantity_in_words == o.quantity_in_words;
+    }
+};
+
+struct item_name_key_hash
+{
+    size_t operator()(const item_name_key &k) const
+    {
+        size_t h = hash<string>()(k.inscription);
+        const uint64_t fields[] =
+        {
+            (uint64_t) k.base_type << 8 | k.sub_type,
+            (uint64_t) (uint16_t) k.plus << 16 | (uint16_t) k.plus2,
+            (uint64_t) (uint32_t) k.special << 8 | k.rnd,
+            (uint64_t) (uint16_t) k.quantity << 32 | k.flags,
+            (uint64_t) (uint16_t) k.slot << 16 | (uint16_t) k.orig_monnum,
+            (uint64_t) k.descrip << 8 | k.in_inventory << 4 | k.terse << 3
+                | k.ident << 2 | k.with_inscription << 1
+                | k.quantity_in_words,
+        };
+        for (uint64_t f : fields)
+            h ^= hash<uint64_t>()(f) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+// Names are memoised until item_name_generation() moves on. The memo is
+// simply dropped when it gets this big; a level's worth of items plus the
+// inventory, in every description level that sees regular use, fits easily.
+#define ITEM_NAME_MEMO_SIZE 8192
+
+static unordered_map<item_name_key, string, item_name_key_hash> _name_memo;
+static unsigned int _name_memo_generation = 0;
+static bool _name_memo_enabled = true;
+static item_name_memo_stats _name_memo_stats;
+
+/**
+ * Can this item's name be memoised, i.e. does it depend on nothing but the
+ * fields in item_name_key and state that bumps item_name_generation()?
+ *
+ * That rules out anything named from props (artefacts, corpses, damnation
+ * bolts), and names that depend on the player: equipment annotations,
+ * experience evoker charges and ziggurat figurines.
+ */
+static bool _name_memo_applies(const item_def &item,
+                               description_level_type descrip)
+{
+    return _name_memo_enabled
+           && descrip != DESC_INVENTORY_EQUIP
+           && item.props.empty()
+           && !is_artefact(item)
+           && item.base_type != OBJ_CORPSES
+           && !is_xp_evoker(item)
+           && !item.is_type(OBJ_MISCELLANY, MISC_ZIGGURAT);
+}
+
+void set_item_name_memo(bool enabled)
+{
+    _name_memo_enabled = enabled;
+    _name_memo.clear();
+}
+
+item_name_memo_stats item_name_memo_counts()
+{
+    return _name_memo_stats;
+}
+
 string item_def::name(description_level_type descrip, bool terse, bool ident,
                       bool with_inscription, bool quantity_in_words) const
 {
     if (descrip == DESC_NONE)
         return "";
 
+    if (!_name_memo_applies(*this, descrip))
+    {
+        ++_name_memo_stats.bypassed;
+        return name_uncached(descrip, terse, ident, with_inscription,
+                             quantity_in_words);
+    }
+
+    if (_name_memo_generation != item_name_generation()
+        || _name_memo.size() >= ITEM_NAME_MEMO_SIZE)
+    {
+        _name_memo.clear();
+        _name_memo_generation = item_name_generation();
+    }
+
+    const item_name_key key = { base_type, sub_type, plus, plus2, special,
+                                rnd, quantity, flags, slot, orig_monnum,
+                                in_inventory(*this), inscription, descrip,
+                                terse, ident, with_inscription,
+                                quantity_in_words };
+    auto it = _name_memo.find(key);
+    if (it != _name_memo.end())
+    {
+        ++_name_memo_stats.hits;
+        return it->second;
+    }
+
+    ++_name_memo_stats.misses;
+    const string result = name_uncached(descrip, terse, ident,
+                                        with_inscription, quantity_in_words);
+    // Naming can itself identify things; only keep names made with
+    // up-to-date knowledge.
+    if (_name_memo_generation == item_name_generation())
+        _name_memo.emplace(key, result);
+    return result;
+}
+
+string item_def::name_uncached(description_level_type descrip, bool terse,
+                               bool ident, bool with_inscription,
+                               bool quantity_in_words) const
+{
     ostringstream buff;
 
     const string auxname = name_aux(descrip, terse, ident, with_inscription);
@@ -2015,6 +2156,18 @@ void check_if_everything_is_identified()
     you.props[IDENTIFIED_ALL_KEY] = true;
 }
 
+static unsigned int _item_name_generation = 0;
+
+unsigned int item_name_generation()
+{
+    return _item_name_generation;
+}
+
+void invalidate_item_names()
+{
+    ++_item_name_generation;
+}
+
 bool identify_item_type(object_class_type basetype, int subtype)
 {
     if (!item_type_has_ids(basetype))
@@ -2025,6 +2178,7 @@ bool identify_item_type(object_class_type basetype, int subtype)
         return false;
 
     you.type_ids[basetype][subtype] = true;
+    invalidate_item_names();
     maybe_mark_set_known(basetype, subtype);
     request_autoinscribe();
 
@@ -145,6 +145,22 @@ bool type_is_identified(const item_def &item);
 bool type_is_identified(object_class_type basetype, int subtype);
 bool identify_item_type(object_class_type basetype, int subtype);
 
+// Item names and search annotations may be cached against this counter, which
+// is bumped whenever something that changes how items are described happens
+// (type identification, option changes, ...).
+unsigned int item_name_generation();
+void invalidate_item_names();
+
+// item_def::name() memoises names that only depend on the item's own fields.
+struct item_name_memo_stats
+{
+    int hits = 0;
+    int misses = 0;
+    int bypassed = 0; // names that can't be memoised
+};
+item_name_memo_stats item_name_memo_counts();
+void set_item_name_memo(bool enabled);
+
 string item_prefix(const item_def &item, bool temp = true);
 string menu_colour_item_name(const item_def &item,
                                    description_level_type desc);
@@ -14,6 +14,7 @@
 #include <cstring>
 #include <functional> // mem_fn
 #include <limits>
+#include <unordered_map>
 
 #include "adjust.h"
 #include "areas.h"
@@ -91,6 +92,7 @@ static void _autoinscribe_item(item_def& item);
 static void _autoinscribe_floor_items();
 static void _autoinscribe_inventory();
 static void _multidrop(vector<SelItem> tmp_items);
+static void _forget_autopickup_decisions();
 static bool _merge_items_into_inv(item_def &it, int quant_got,
                                   int &inv_slot, bool quiet);
 
@@ -1782,6 +1784,8 @@ static bool _put_item_in_inv(item_def& it, int quant_got, bool quiet, bool& put_
     if (_merge_items_into_inv(it, quant_got, inv_slot, quiet))
     {
         put_in_inv = true;
+        // What's already carried matters to autopickup functions.
+        _forget_autopickup_decisions();
 
         // cleanup items that ended up in an inventory slot (not gold, etc)
         if (inv_slot != -1)
@@ -2962,6 +2966,7 @@ static bool _drop_item_order(const SelItem &first, const SelItem &second)
 void set_item_autopickup(const item_def &item, autopickup_level_type ap)
 {
     you.force_autopickup[item.base_type][_autopickup_subtype(item)] = ap;
+    invalidate_item_names();
 }
 
 int item_autopickup_level(const item_def &item)
@@ -3186,7 +3191,115 @@ static int _autopickup_subtype(const item_def &item)
     }
 }
 
+// Options.force_autopickup (autopickup_exceptions), matched as one list.
+static pattern_list _autopickup_exceptions;
+static unsigned int _autopickup_exceptions_generation = UINT_MAX;
+
+static int _autopickup_exception_match(const string &iname)
+{
+    // Option changes bump the item name generation, so that's when the
+    // exception list may have changed.
+    if (_autopickup_exceptions_generation != item_name_generation())
+    {
+        _autopickup_exceptions.clear();
+        for (const pair<text_pattern, bool>& option : Options.force_autopickup)
+            _autopickup_exceptions.add(option.first);
+        _autopickup_exceptions_generation = item_name_generation();
+    }
+    return _autopickup_exceptions.first_match(iname);
+}
+
+static bool _is_option_autopickup_uncached(const item_def &item,
+                                           bool ignore_force);
+
+// The parts of an item that _is_option_autopickup() can look at.
+struct autopickup_key
+{
+    object_class_type base_type;
+    uint8_t sub_type;
+    short plus;
+    short plus2;
+    int special;
+    uint8_t rnd;
+    short quantity;
+    iflags_t flags;
+    string inscription;
+    bool ignore_force;
+
+    bool operator==(const autopickup_key &o) const
+    {
+        return base_type == o.base_type && sub_type == o.sub_type
+               && plus == o.plus && plus2 == o.plus2
+               && special == o.special && rnd == o.rnd
+               && quantity == o.quantity && flags == o.flags
+               && inscription == o.inscription
+               && ignore_force == o.ignore_force;
+    }
+};
+
+struct autopickup_key_hash
+{
+    size_t operator()(const autopickup_key &k) const
+    {
+        size_t h = hash<string>()(k.inscription);
+        const uint64_t fields[] =
+        {
+            (uint64_t) k.base_type << 9 | k.sub_type << 1 | k.ignore_force,
+            (uint64_t) (uint16_t) k.plus << 16 | (uint16_t) k.plus2,
+            (uint64_t) (uint32_t) k.special << 8 | k.rnd,
+            (uint64_t) (uint16_t) k.quantity << 32 | k.flags,
+        };
+        for (uint64_t f : fields)
+            h ^= hash<uint64_t>()(f) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+    }
+};
+
+// Autopickup decisions, which are asked for over and over (by explore's
+// greed, the stash tracker, tile drawing, ...) for the same items. Besides
+// item names and options, user autopickup functions can depend on anything
+// about the player (the defaults look at the inventory and at what the
+// player already has), so decisions are only kept for the current turn,
+// and not across changes to the inventory.
+static unordered_map<autopickup_key, bool, autopickup_key_hash>
+    _autopickup_decisions;
+static unsigned int _autopickup_decisions_generation = 0;
+static int _autopickup_decisions_turn = -1;
+
+static void _forget_autopickup_decisions()
+{
+    _autopickup_decisions.clear();
+}
+
 static bool _is_option_autopickup(const item_def &item, bool ignore_force)
+{
+    // Names of items with props can depend on them (artefacts and so on).
+    if (!item.props.empty())
+        return _is_option_autopickup_uncached(item, ignore_force);
+
+    if (_autopickup_decisions_generation != item_name_generation()
+        || _autopickup_decisions_turn != you.num_turns)
+    {
+        _forget_autopickup_decisions();
+        _autopickup_decisions_generation = item_name_generation();
+        _autopickup_decisions_turn = you.num_turns;
+    }
+
+    const autopickup_key key = { item.base_type, item.sub_type, item.plus,
+                                 item.plus2, item.special, item.rnd,
+                                 item.quantity, item.flags, item.inscription,
+                                 ignore_force };
+    auto it = _autopickup_decisions.find(key);
+    if (it != _autopickup_decisions.end())
+        return it->second;
+
+    const bool result = _is_option_autopickup_uncached(item, ignore_force);
+    _autopickup_decisions.emplace(key, result);
+    return result;
+}
+
+static bool _is_option_autopickup_uncached(const item_def &item,
+                                           bool ignore_force)
 {
     if (item.base_type < NUM_OBJECT_CLASSES)
     {
@@ -3215,9 +3328,9 @@ static bool _is_option_autopickup(const item_def &item, bool ignore_force)
         return bool(res);
 
     // Check for initial settings
-    for (const pair<text_pattern, bool>& option : Options.force_autopickup)
-        if (option.first.matches(iname))
-            return option.second;
+    const int exception = _autopickup_exception_match(iname);
+    if (exception >= 0)
+        return Options.force_autopickup[exception].second;
 
     return Options.autopickups[item.base_type];
 }
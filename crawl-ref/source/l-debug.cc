@@ -14,6 +14,7 @@
 #include "dungeon.h"
 #include "files.h"
 #include "god-wrath.h"
+#include "item-name.h"
 #include "los.h"
 #include "maps.h"
 #include "message.h"
@@ -27,6 +28,7 @@
 #include "state.h"
 #include "stringutil.h"
 #include "tileview.h"
+#include "ui.h"
 #include "unique-creature-list-type.h"
 #include "unwind.h"
 #include "view.h"
@@ -472,6 +474,73 @@ LUAFN(debug_check_moncasts)
     return 1;
 }
 
+// Turn memoisation of item names on or off (clearing the memo either way).
+LUAFN(debug_item_name_memo)
+{
+    set_item_name_memo(lua_toboolean(ls, 1));
+    return 0;
+}
+
+// Returns how many item names were memo hits, misses, and not memoisable.
+LUAFN(debug_item_name_memo_stats)
+{
+    const item_name_memo_stats stats = item_name_memo_counts();
+    lua_pushnumber(ls, stats.hits);
+    lua_pushnumber(ls, stats.misses);
+    lua_pushnumber(ls, stats.bypassed);
+    return 3;
+}
+
+// Usage: layout_text(text, { width, ... }[, repeats[, fresh]])
+// Ask a wrapping ui::Text holding text (with colour tags) for its height at
+// each of the widths in turn, repeats times over, as a layout pass would;
+// with fresh, each pass uses a new widget. Returns the last pass's heights.
+LUAFN(debug_layout_text)
+{
+#ifdef USE_TILE_LOCAL
+    // Text widgets need a font, and headless tiles has none.
+    return luaL_error(ls, "layout_text is only available in console builds");
+#else
+    const formatted_string text =
+        formatted_string::parse_string(luaL_checkstring(ls, 1));
+    luaL_checktype(ls, 2, LUA_TTABLE);
+    vector<int> widths;
+    for (int i = 1; i <= (int) lua_objlen(ls, 2); ++i)
+    {
+        lua_rawgeti(ls, 2, i);
+        widths.push_back(max(1, (int) lua_tonumber(ls, -1)));
+        lua_pop(ls, 1);
+    }
+    const int repeats = lua_isnumber(ls, 3) ? lua_tointeger(ls, 3) : 1;
+    const bool fresh = lua_toboolean(ls, 4);
+
+    shared_ptr<ui::Text> widget;
+    vector<int> heights;
+    for (int r = 0; r < repeats; ++r)
+    {
+        if (!widget || fresh)
+        {
+            widget = make_shared<ui::Text>(text);
+            widget->set_wrap_text(true);
+        }
+        heights.clear();
+        for (int width : widths)
+        {
+            heights.push_back(
+                widget->get_preferred_size(ui::Widget::VERT, width).nat);
+        }
+    }
+
+    lua_newtable(ls);
+    for (int i = 0; i < (int) heights.size(); ++i)
+    {
+        lua_pushnumber(ls, heights[i]);
+        lua_rawseti(ls, -2, i + 1);
+    }
+    return 1;
+#endif
+}
+
 const struct luaL_reg debug_dlib[] =
 {
 { "goto_place", debug_goto_place },
@@ -504,5 +573,8 @@ const struct luaL_reg debug_dlib[] =
 { "reset_rng", debug_reset_rng },
 { "get_rng_state", debug_get_rng_state },
 { "check_moncasts", debug_check_moncasts },
+{ "item_name_memo", debug_item_name_memo },
+{ "item_name_memo_stats", debug_item_name_memo_stats },
+{ "layout_text", debug_layout_text },
 { nullptr, nullptr }
 };
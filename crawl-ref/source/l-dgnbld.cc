@@ -10,6 +10,7 @@
 
 #include "cluautil.h"
 #include "coordit.h"
+#include "directn.h"
 #include "dgn-delve.h"
 #include "dgn-irregular-box.h"
 #include "dgn-layouts.h"
@@ -2297,6 +2298,434 @@ LUAFN(dgn_farthest_from)
     return 2;
 }
 
+/* Grid buffers: flat grids of ints for layout code to work on in bulk,
+ * rather than a cell at a time through mapgrd or Lua tables. Coordinates
+ * are zero-based, like the map's. */
+
+#define GRIDBUF_METATABLE "dgn.gridbuf"
+
+struct grid_buffer
+{
+    int width;
+    int height;
+    vector<int> cells;
+
+    grid_buffer(int w, int h, int value)
+        : width(w), height(h), cells(w * h, value)
+    {
+    }
+
+    bool in_bounds(int x, int y) const
+    {
+        return x >= 0 && x < width && y >= 0 && y < height;
+    }
+
+    int &operator()(int x, int y)
+    {
+        return cells[y * width + x];
+    }
+};
+
+#define GRIDBUF(ls, n, var) \
+    grid_buffer *var = *(grid_buffer **) luaL_checkudata(ls, n, \
+                                                         GRIDBUF_METATABLE); \
+    if (!var) \
+        return 0
+
+static grid_buffer *_push_gridbuf(lua_State *ls, int width, int height,
+                                  int value = 0)
+{
+    if (width <= 0 || height <= 0 || width > GXM || height > GYM)
+    {
+        luaL_error(ls, "Invalid grid buffer size: %d, %d", width, height);
+        return nullptr;
+    }
+
+    grid_buffer **ref = clua_new_userdata<grid_buffer *>(ls,
+                                                         GRIDBUF_METATABLE);
+    *ref = new grid_buffer(width, height, value);
+    return *ref;
+}
+
+static const coord_def _gridbuf_orth[] =
+{
+    { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 },
+};
+
+// Visits the cells connected to start (including start) that satisfy
+// wanted, breadth first, and returns how many there were. Cells are
+// passed to visit as they are found, which must stop them satisfying
+// wanted.
+template <typename is_wanted, typename visitor>
+static int _gridbuf_flood(grid_buffer &buf, coord_def start, bool diagonal,
+                          is_wanted wanted, visitor visit)
+{
+    vector<coord_def> queue;
+    queue.reserve(buf.cells.size());
+    visit(start);
+    queue.push_back(start);
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        const coord_def c = queue[head];
+        for (int i = 0; i < (diagonal ? 8 : 4); ++i)
+        {
+            const coord_def n = c + (diagonal ? Compass[i] : _gridbuf_orth[i]);
+            if (!buf.in_bounds(n.x, n.y) || !wanted(n))
+                continue;
+            visit(n);
+            queue.push_back(n);
+        }
+    }
+    return queue.size();
+}
+
+/*** Make a new grid buffer.
+ * @tparam int width
+ * @tparam int height
+ * @tparam[opt=0] int value the initial value of every cell
+ * @treturn gridbuf
+ * @function gridbuf
+ */
+LUAFN(dgn_gridbuf)
+{
+    const int width = luaL_safe_checkint(ls, 1);
+    const int height = luaL_safe_checkint(ls, 2);
+    ARG_INT(ls, 3, value, 0);
+    _push_gridbuf(ls, width, height, value);
+    return 1;
+}
+
+/*** Make a grid buffer the size of a map from its glyphs.
+ * @tparam map map
+ * @tparam table values the value of each glyph, e.g. `{ ["x"] = 1 }`
+ * @tparam[opt=0] int default the value of glyphs not in values
+ * @treturn gridbuf
+ * @function gridbuf_from_map
+ */
+LUAFN(dgn_gridbuf_from_map)
+{
+    LINES(ls, 1, map, lines);
+    luaL_checktype(ls, 2, LUA_TTABLE);
+    ARG_INT(ls, 3, def, 0);
+
+    int values[256];
+    for (int &v : values)
+        v = def;
+    lua_pushnil(ls);
+    while (lua_next(ls, 2))
+    {
+        // Don't let luaL_checkstring convert a key under lua_next.
+        if (lua_type(ls, -2) != LUA_TSTRING)
+            return luaL_error(ls, "Glyph keys must be strings");
+        const char *glyph = lua_tostring(ls, -2);
+        values[static_cast<unsigned char>(glyph[0])] =
+            luaL_safe_checkint(ls, -1);
+        lua_pop(ls, 1);
+    }
+
+    grid_buffer *buf = _push_gridbuf(ls, lines.width(), lines.height());
+    for (int y = 0; y < buf->height; ++y)
+        for (int x = 0; x < buf->width; ++x)
+            (*buf)(x, y) = values[static_cast<unsigned char>(lines(x, y))];
+    return 1;
+}
+
+LUAFN(gridbuf_width)
+{
+    GRIDBUF(ls, 1, buf);
+    PLUARET(number, buf->width);
+}
+
+LUAFN(gridbuf_height)
+{
+    GRIDBUF(ls, 1, buf);
+    PLUARET(number, buf->height);
+}
+
+// buf:get(x, y): the value at x, y, or nil if that's outside the buffer.
+LUAFN(gridbuf_get)
+{
+    GRIDBUF(ls, 1, buf);
+    const int x = luaL_safe_checkint(ls, 2);
+    const int y = luaL_safe_checkint(ls, 3);
+    if (!buf->in_bounds(x, y))
+        return 0;
+    PLUARET(number, (*buf)(x, y));
+}
+
+LUAFN(gridbuf_set)
+{
+    GRIDBUF(ls, 1, buf);
+    const int x = luaL_safe_checkint(ls, 2);
+    const int y = luaL_safe_checkint(ls, 3);
+    if (!buf->in_bounds(x, y))
+        return luaL_error(ls, "Invalid coords: %d, %d", x, y);
+    (*buf)(x, y) = luaL_safe_checkint(ls, 4);
+    return 0;
+}
+
+// buf:fill(value, [x1, y1, x2, y2]): fill the whole buffer, or the given
+// (inclusive, clipped) rectangle of it.
+LUAFN(gridbuf_fill)
+{
+    GRIDBUF(ls, 1, buf);
+    const int value = luaL_safe_checkint(ls, 2);
+    ARG_INT(ls, 3, x1, 0);
+    ARG_INT(ls, 4, y1, 0);
+    ARG_INT(ls, 5, x2, buf->width - 1);
+    ARG_INT(ls, 6, y2, buf->height - 1);
+
+    x1 = max(x1, 0);
+    y1 = max(y1, 0);
+    x2 = min(x2, buf->width - 1);
+    y2 = min(y2, buf->height - 1);
+    for (int y = y1; y <= y2; ++y)
+        for (int x = x1; x <= x2; ++x)
+            (*buf)(x, y) = value;
+    return 0;
+}
+
+LUAFN(gridbuf_copy)
+{
+    GRIDBUF(ls, 1, buf);
+    grid_buffer *copy = _push_gridbuf(ls, buf->width, buf->height);
+    copy->cells = buf->cells;
+    return 1;
+}
+
+// buf:stamp(src, x, y, [transparent]): copy src into buf with its top left
+// corner at x, y, clipped to buf, skipping cells of src with the value
+// transparent (if given).
+LUAFN(gridbuf_stamp)
+{
+    GRIDBUF(ls, 1, buf);
+    GRIDBUF(ls, 2, src);
+    const int ox = luaL_safe_checkint(ls, 3);
+    const int oy = luaL_safe_checkint(ls, 4);
+    const bool masked = !lua_isnoneornil(ls, 5);
+    const int transparent = masked ? luaL_safe_checkint(ls, 5) : 0;
+
+    for (int y = 0; y < src->height; ++y)
+        for (int x = 0; x < src->width; ++x)
+        {
+            const int value = (*src)(x, y);
+            if (buf->in_bounds(ox + x, oy + y)
+                && (!masked || value != transparent))
+            {
+                (*buf)(ox + x, oy + y) = value;
+            }
+        }
+    return 0;
+}
+
+// buf:replace(from, to): returns the number of cells changed.
+LUAFN(gridbuf_replace)
+{
+    GRIDBUF(ls, 1, buf);
+    const int from = luaL_safe_checkint(ls, 2);
+    const int to = luaL_safe_checkint(ls, 3);
+    int count = 0;
+    for (int &cell : buf->cells)
+        if (cell == from)
+        {
+            cell = to;
+            ++count;
+        }
+    PLUARET(number, count);
+}
+
+LUAFN(gridbuf_count)
+{
+    GRIDBUF(ls, 1, buf);
+    const int value = luaL_safe_checkint(ls, 2);
+    PLUARET(number, count(buf->cells.begin(), buf->cells.end(), value));
+}
+
+static int _gridbuf_neighbours(grid_buffer &buf, int x, int y, int value)
+{
+    int count = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        const coord_def n = coord_def(x, y) + Compass[i];
+        if (buf.in_bounds(n.x, n.y) && buf(n.x, n.y) == value)
+            ++count;
+    }
+    return count;
+}
+
+// buf:count_neighbours(x, y, value): how many of the eight cells around
+// x, y have the value.
+LUAFN(gridbuf_count_neighbours)
+{
+    GRIDBUF(ls, 1, buf);
+    const int x = luaL_safe_checkint(ls, 2);
+    const int y = luaL_safe_checkint(ls, 3);
+    const int value = luaL_safe_checkint(ls, 4);
+    PLUARET(number, _gridbuf_neighbours(*buf, x, y, value));
+}
+
+// buf:neighbour_counts(value): a new buffer holding count_neighbours for
+// every cell, for cellular automata and the like.
+LUAFN(gridbuf_neighbour_counts)
+{
+    GRIDBUF(ls, 1, buf);
+    const int value = luaL_safe_checkint(ls, 2);
+    grid_buffer *counts = _push_gridbuf(ls, buf->width, buf->height);
+    for (int y = 0; y < buf->height; ++y)
+        for (int x = 0; x < buf->width; ++x)
+            (*counts)(x, y) = _gridbuf_neighbours(*buf, x, y, value);
+    return 1;
+}
+
+// buf:flood_fill(x, y, value, [diagonal]): set the cells connected to x, y
+// that have its value to the new value. Returns the number of cells set.
+LUAFN(gridbuf_flood_fill)
+{
+    GRIDBUF(ls, 1, buf);
+    const int x = luaL_safe_checkint(ls, 2);
+    const int y = luaL_safe_checkint(ls, 3);
+    const int value = luaL_safe_checkint(ls, 4);
+    const bool diagonal = lua_toboolean(ls, 5);
+    if (!buf->in_bounds(x, y))
+        return luaL_error(ls, "Invalid coords: %d, %d", x, y);
+
+    const int old = (*buf)(x, y);
+    if (old == value)
+        PLUARET(number, 0);
+
+    PLUARET(number, _gridbuf_flood(*buf, coord_def(x, y), diagonal,
+        [&](const coord_def &c) { return (*buf)(c.x, c.y) == old; },
+        [&](const coord_def &c) { (*buf)(c.x, c.y) = value; }));
+}
+
+// buf:label_zones(value, [diagonal]): a new buffer in which each connected
+// zone of cells with the value is numbered from 1, and all other cells are
+// 0; also returns the number of zones.
+LUAFN(gridbuf_label_zones)
+{
+    GRIDBUF(ls, 1, buf);
+    const int value = luaL_safe_checkint(ls, 2);
+    const bool diagonal = lua_toboolean(ls, 3);
+
+    grid_buffer *zones = _push_gridbuf(ls, buf->width, buf->height);
+    int nzones = 0;
+    for (int y = 0; y < buf->height; ++y)
+        for (int x = 0; x < buf->width; ++x)
+        {
+            if ((*buf)(x, y) != value || (*zones)(x, y))
+                continue;
+
+            ++nzones;
+            _gridbuf_flood(*buf, coord_def(x, y), diagonal,
+                [&](const coord_def &c)
+                {
+                    return (*buf)(c.x, c.y) == value && !(*zones)(c.x, c.y);
+                },
+                [&](const coord_def &c) { (*zones)(c.x, c.y) = nzones; });
+        }
+
+    lua_pushnumber(ls, nzones);
+    return 2;
+}
+
+// buf:distance(value, [through]): a new buffer holding each cell's distance
+// in moves (diagonals included) to the nearest cell with the value, or -1
+// if none can be reached. With through, moves may only pass over cells with
+// that value; otherwise anything is passable.
+LUAFN(gridbuf_distance)
+{
+    GRIDBUF(ls, 1, buf);
+    const int value = luaL_safe_checkint(ls, 2);
+    const bool blocked = !lua_isnoneornil(ls, 3);
+    const int through = blocked ? luaL_safe_checkint(ls, 3) : 0;
+
+    grid_buffer *dist = _push_gridbuf(ls, buf->width, buf->height, -1);
+    vector<coord_def> queue;
+    queue.reserve(buf->cells.size());
+    for (int y = 0; y < buf->height; ++y)
+        for (int x = 0; x < buf->width; ++x)
+            if ((*buf)(x, y) == value)
+            {
+                (*dist)(x, y) = 0;
+                queue.emplace_back(x, y);
+            }
+
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        const coord_def c = queue[head];
+        for (int i = 0; i < 8; ++i)
+        {
+            const coord_def n = c + Compass[i];
+            if (!buf->in_bounds(n.x, n.y) || (*dist)(n.x, n.y) >= 0
+                || blocked && (*buf)(n.x, n.y) != through)
+            {
+                continue;
+            }
+            (*dist)(n.x, n.y) = (*dist)(c.x, c.y) + 1;
+            queue.push_back(n);
+        }
+    }
+    return 1;
+}
+
+// buf:to_map(map, glyphs, [x, y]): write the glyph for each value in the
+// glyphs table (e.g. `{ [1] = "x" }`) into the map, with the buffer's top
+// left corner at x, y. Cells with values not in the table are left alone.
+LUAFN(gridbuf_to_map)
+{
+    GRIDBUF(ls, 1, buf);
+    LINES(ls, 2, mdef, lines);
+    luaL_checktype(ls, 3, LUA_TTABLE);
+    ARG_INT(ls, 4, ox, 0);
+    ARG_INT(ls, 5, oy, 0);
+
+    map<int, char> glyphs;
+    lua_pushnil(ls);
+    while (lua_next(ls, 3))
+    {
+        glyphs[luaL_safe_checkint(ls, -2)] = luaL_checkstring(ls, -1)[0];
+        lua_pop(ls, 1);
+    }
+
+    for (int y = 0; y < buf->height; ++y)
+        for (int x = 0; x < buf->width; ++x)
+        {
+            const coord_def c(ox + x, oy + y);
+            if (!lines.in_map(c))
+                continue;
+            auto glyph = glyphs.find((*buf)(x, y));
+            if (glyph != glyphs.end())
+                lines(c) = glyph->second;
+        }
+    return 0;
+}
+
+static const struct luaL_reg gridbuf_dlib[] =
+{
+    { "width", gridbuf_width },
+    { "height", gridbuf_height },
+    { "get", gridbuf_get },
+    { "set", gridbuf_set },
+    { "fill", gridbuf_fill },
+    { "copy", gridbuf_copy },
+    { "stamp", gridbuf_stamp },
+    { "replace", gridbuf_replace },
+    { "count", gridbuf_count },
+    { "count_neighbours", gridbuf_count_neighbours },
+    { "neighbour_counts", gridbuf_neighbour_counts },
+    { "flood_fill", gridbuf_flood_fill },
+    { "label_zones", gridbuf_label_zones },
+    { "distance", gridbuf_distance },
+    { "to_map", gridbuf_to_map },
+    { nullptr, nullptr }
+};
+
+void dluaopen_gridbuf(lua_State *ls)
+{
+    clua_register_metatable(ls, GRIDBUF_METATABLE, gridbuf_dlib,
+                            lua_object_gc<grid_buffer>);
+}
+
 /* Wrappers for C++ layouts, to facilitate choosing of layouts by weight and
  * depth */
 
@@ -2375,6 +2804,8 @@ const struct luaL_reg dgn_build_dlib[] =
     { "delve", &dgn_delve },
     { "width", dgn_width },
     { "farthest_from", &dgn_farthest_from },
+    { "gridbuf", &dgn_gridbuf },
+    { "gridbuf_from_map", &dgn_gridbuf_from_map },
 
     { "layout_basic", &dgn_layout_basic },
     { "layout_bigger_room", &dgn_layout_bigger_room },
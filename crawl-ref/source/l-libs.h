@@ -66,6 +66,7 @@ void register_builder_funcs(lua_State *ls);
 void dluaopen_crawl(lua_State *ls);
 void dluaopen_file(lua_State *ls);
 void dluaopen_mapgrd(lua_State *ls);
+void dluaopen_gridbuf(lua_State *ls);
 void dluaopen_monsters(lua_State *ls);
 void dluaopen_you(lua_State *ls);
 void dluaopen_dgn(lua_State *ls);
@@ -11,6 +11,7 @@ module "crawl"
 #include "cluautil.h"
 #include "mon-util.h"
 #include "options.h"
+#include "stash.h"
 #include "stringutil.h"
 #include "wiz-dgn.h"
 #include "wiz-fsim.h"
@@ -42,15 +43,60 @@ LUAFN(wiz_quick_fsim)
     PLUARET(number, fdata.player.av_eff_dam);
 }
 
+// Runs the fight sim against each of the given monsters, appending to the
+// fsim file as the wizard command does; the fsim options are used as they
+// are. Raises an error if a sim couldn't be run.
+LUAFN(wiz_fsim_batch)
+{
+    vector<string> monsters;
+    luaL_checktype(ls, 1, LUA_TTABLE);
+    for (int i = 1; ; ++i)
+    {
+        lua_rawgeti(ls, 1, i);
+        if (lua_isnil(ls, -1))
+        {
+            lua_pop(ls, 1);
+            break;
+        }
+        monsters.emplace_back(luaL_checkstring(ls, -1));
+        lua_pop(ls, 1);
+    }
+    const bool double_scale = lua_toboolean(ls, 2);
+    const int jobs = lua_isnoneornil(ls, 3) ? 0 : luaL_safe_checkint(ls, 3);
+    const uint64_t seed = lua_isnoneornil(ls, 4)
+                          ? 0 : (uint64_t) luaL_checknumber(ls, 4);
+
+    string error;
+    if (!fight_sim_batch(monsters, double_scale, jobs, seed, error))
+        return luaL_error(ls, "%s", error.c_str());
+    return 0;
+}
+
 LUAWRAP(wiz_identify_all_items, wizard_identify_all_items())
 
 LUAWRAP(wiz_map_level, wizard_map_level())
 
+// Returns the names of everything a stash search for the given term finds.
+LUAFN(wiz_stash_search)
+{
+    const string term = luaL_checkstring(ls, 1);
+    lua_newtable(ls);
+    int index = 0;
+    for (const stash_search_result &res : StashTrack.find_matches(term))
+    {
+        lua_pushstring(ls, res.match.c_str());
+        lua_rawseti(ls, -2, ++index);
+    }
+    return 1;
+}
+
 static const struct luaL_reg wiz_dlib[] =
 {
 { "quick_fsim", wiz_quick_fsim },
+{ "fsim_batch", wiz_fsim_batch },
 { "identify_all_items", wiz_identify_all_items},
 { "map_level", wiz_map_level},
+{ "stash_search", wiz_stash_search},
 { nullptr, nullptr }
 };
 
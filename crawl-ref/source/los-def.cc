@@ -7,6 +7,7 @@
 
 #include "los-def.h"
 
+#include "dbg-prof.h"
 
 los_def::los_def()
     : show(0), opc(opc_default.clone()), bds(BDS_DEFAULT)
@@ -51,6 +52,7 @@ los_def::~los_def()
 
 void los_def::update()
 {
+    PROF_SCOPE(PROF_LOS_UPDATE);
     losight(show, center, *opc, bds);
 }
 
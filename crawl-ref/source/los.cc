@@ -50,6 +50,7 @@
 #include "areas.h"
 #include "coord.h"
 #include "coordit.h"
+#include "dbg-prof.h"
 #include "env.h"
 #include "losglobal.h"
 #include "mon-act.h"
@@ -585,6 +586,8 @@ static bool _find_ray_se(const coord_def& target, ray_def& ray,
 
     ray = c.ray;
     ray.cycle_idx = index;
+    ray.fp_cells = &ray_coords[c.ray.start];
+    ray.fp_length = c.ray.length;
 
     return true;
 }
@@ -648,6 +651,9 @@ bool find_ray(const coord_def& source, const coord_def& target,
     ray.r.start.x += source.x;
     ray.r.start.y += source.y;
 
+    ray.fp_origin = source;
+    ray.fp_sign = coord_def(signx, signy);
+
     return true;
 }
 
@@ -690,6 +696,8 @@ void fallback_ray(const coord_def& source, const coord_def& target,
     ray.r.dir.x = diff.x;
     ray.r.dir.y = diff.y;
     ray.on_corner = false;
+    ray.fp_cells = nullptr;
+    ray.fp_length = ray.fp_step = 0;
 }
 
 // Is p2 visible from p1, disregarding half-opaque objects?
@@ -876,6 +884,7 @@ void los_terrain_changed(const coord_def& p)
 
 void los_changed()
 {
+    TRANSITION_PHASE(TRANS_LOS);
     mons_reset_just_seen();
     invalidate_los();
     _handle_los_change();
@@ -48,6 +48,7 @@
 #include "corpse.h"
 #include "crash.h"
 #include "database.h"
+#include "dbg-prof.h"
 #include "dbg-scan.h"
 #include "dbg-util.h"
 #include "delay.h"
@@ -558,6 +559,10 @@ static void _show_commandline_options_help()
     puts("");
     puts("Arena options: (Stage a tournament between various monsters.)");
     puts("  -arena \"<monster list> v <monster list> arena:<arena map>\"");
+    puts("  -arena-batch <file> fight each matchup in <file> with no display,");
+    puts("      writing totals to arena-batch.tsv and arena-batch.json");
+    puts("  -arena-jobs <n>     worker processes for -arena-batch (default: one");
+    puts("      per CPU)");
 #ifdef DEBUG_DIAGNOSTICS
     puts("");
     puts("Diagnostic options:");
@@ -567,6 +572,13 @@ static void _show_commandline_options_help()
 #endif
     // XX should this really be advertised outside of debug builds?
     puts("  -headless           force headless mode (no pty)");
+#ifdef PROFILE_COUNTERS
+    puts("  -profile-report [<file>] write subsystem timings to <file>");
+    puts("      (default profile.txt, - for stdout) on exit");
+#endif
+    puts("  -bench <file>       write turns/sec, monster actions/sec and peak");
+    puts("      memory use as JSON to <file> (- for stdout) on exit");
+    puts("  -bench-turns <n>    with -bench, exit after timing <n> turns");
     puts("  -script <name>      run script matching <name> in ./scripts");
 #ifdef DEBUG_STATISTICS
 #ifndef DEBUG_DIAGNOSTICS
@@ -590,7 +602,8 @@ static void _show_commandline_options_help()
 #endif
     puts("");
     puts("Miscellaneous options:");
-    puts("  -builddb         don't start the game; rebuild the .des cache and exit");
+    puts("  -builddb         don't start the game; rebuild the .des cache and the");
+    puts("                   compiled text databases, and exit");
     puts("  -reset-cache     force a full rebuild of the .des cache");
     puts("  -dump-maps       write map Lua to stderr when parsing .des files");
 #ifndef TARGET_OS_WINDOWS
@@ -2547,6 +2560,8 @@ static void _update_still_winds()
 
 void world_reacts()
 {
+    PROF_SCOPE(PROF_WORLD_REACTS);
+
     // All markers should be activated at this point.
     ASSERT(!env.markers.need_activate());
 
@@ -2686,6 +2701,8 @@ void world_reacts()
     // the loudest noise tracking for the next world_reacts cycle.
     you.los_noise_last_turn = you.los_noise_level;
     you.los_noise_level = 0;
+
+    prof_end_turn();
 }
 
 static command_type _get_next_cmd()
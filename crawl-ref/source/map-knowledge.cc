@@ -23,6 +23,7 @@ void set_terrain_mapped(const coord_def gc)
     map_cell* cell = &env.map_knowledge(gc);
     cell->flags &= (~MAP_CHANGED_FLAG);
     cell->flags |= MAP_MAGIC_MAPPED_FLAG;
+    invalidate_travel_plan();
 #ifdef USE_TILE
     // This may have changed the explore horizon, so update adjacent minimap
     // squares as well.
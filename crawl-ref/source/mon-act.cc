@@ -16,6 +16,7 @@
 #include "colour.h"
 #include "coordit.h"
 #include "corpse.h"
+#include "dbg-prof.h"
 #include "dbg-scan.h"
 #include "delay.h"
 #include "directn.h" // feature_description_at
@@ -2681,17 +2682,21 @@ void clear_monster_flags()
 {
     // Clear any summoning flags so that lower indiced monsters get their
     // actions in the next round. Also clear one-turn deep sleep flag.
-    // Finally, track the highest index of monster still alive, for
-    // monster_iterator optimisation purposes.
+    // Finally, track the highest index of monster still alive, and drop
+    // empty slots from env.mon_slots, for monster_iterator optimisation
+    // purposes.
     env.max_mon_index = 0;
-    for (int i = 0; i < MAX_MONSTERS; ++i)
+    size_t live = 0;
+    for (int i : env.mon_slots)
     {
         if (env.mons[i].defined())
         {
             env.max_mon_index = i;
             env.mons[i].flags &= ~MF_JUST_SUMMONED & ~MF_JUST_SLEPT;
+            env.mon_slots[live++] = i;
         }
     }
+    env.mon_slots.resize(live);
 }
 
 /**
@@ -2753,6 +2758,8 @@ static void _display_just_seen()
  */
 void handle_monsters(bool with_noise)
 {
+    PROF_SCOPE(PROF_HANDLE_MONSTERS);
+
     for (monster_iterator mi; mi; ++mi)
     {
         _pre_monster_move(**mi);
@@ -2787,6 +2794,7 @@ void handle_monsters(bool with_noise)
         if (oldspeed == mon->speed_increment)
         {
             handle_monster_move(mon);
+            prof_count_monster_action();
             _post_monster_move(mon);
             fire_final_effects();
         }
@@ -23,6 +23,7 @@
 #include "colour.h"
 #include "coordit.h"
 #include "database.h"
+#include "dbg-prof.h"
 #include "delay.h"
 #include "directn.h"
 #include "english.h"
@@ -89,6 +90,43 @@
 
 static bool _valid_mon_spells[NUM_SPELLS];
 
+// A tracer fired while a monster picks its spell for the turn, so that a
+// beam it considers more than once (in the emergency pass and then the
+// normal one, on the second attempt, or from several slots) is only traced
+// once. Everything that can differ between two setups of the same spell for
+// the same caster is part of the key, including the foe_ratio that some
+// spells roll anew each time and mons_should_fire() judges the tracer by.
+struct tracer_memo
+{
+    spell_type spell;
+    coord_def target;
+    int range;
+    beam_type flavour;
+    dice_def damage;
+    bool pierce;
+    bool is_explosion;
+    int ex_size;
+    bool aimed_at_spot;
+    bool explode;
+    int foe_ratio;
+
+    bolt beam;          // the beam after its tracer was fired
+    bool should_fire;
+
+    bool matches(const bolt &b, spell_type sp, bool exp) const
+    {
+        return spell == sp && target == b.target && range == b.range
+               && flavour == b.flavour && damage.num == b.damage.num
+               && damage.size == b.damage.size && pierce == b.pierce
+               && is_explosion == b.is_explosion && ex_size == b.ex_size
+               && aimed_at_spot == b.aimed_at_spot && explode == exp
+               && foe_ratio == b.foe_ratio;
+    }
+};
+
+// The memos for the monster choosing its spell, if any.
+static vector<tracer_memo> *tracer_memos = nullptr;
+
 static const string MIRROR_RECAST_KEY = "mirror_recast_time";
 
 static bool _trace_los(const monster* agent, bool (*vulnerable)(const actor*));
@@ -4790,10 +4828,35 @@ static bool _should_cast_spell(const monster &mons, spell_type spell,
     if (get_spell_flags(spell) & spflag::needs_tracer)
     {
         const bool explode = spell_is_direct_explosion(spell);
+        if (tracer_memos)
+        {
+            for (const tracer_memo &memo : *tracer_memos)
+            {
+                if (memo.matches(beem, spell, explode))
+                {
+                    prof_count_tracer_reused();
+                    beem = memo.beam;
+                    return memo.should_fire;
+                }
+            }
+        }
+
+        tracer_memo memo = { spell, beem.target, beem.range, beem.flavour,
+                             beem.damage, beem.pierce, beem.is_explosion,
+                             beem.ex_size, beem.aimed_at_spot, explode,
+                             beem.foe_ratio };
         targeting_tracer tracer;
         fire_tracer(&mons, tracer, beem, explode);
         // Good idea?
-        return mons_should_fire(beem, tracer, ignore_good_idea);
+        const bool should_fire = mons_should_fire(beem, tracer,
+                                                  ignore_good_idea);
+        if (tracer_memos)
+        {
+            memo.beam = beem;
+            memo.should_fire = should_fire;
+            tracer_memos->push_back(memo);
+        }
+        return should_fire;
     }
 
     // Spells with custom marionette logic get to bypass certain normal checks
@@ -5082,6 +5145,9 @@ bool handle_mon_spell(monster* mons)
 
     bolt beem = setup_targeting_beam(*mons);
 
+    vector<tracer_memo> memos;
+    unwind_var<vector<tracer_memo> *> memo_scope(tracer_memos, &memos);
+
     bool ignore_good_idea = false;
     if (does_ru_wanna_redirect(*mons))
     {
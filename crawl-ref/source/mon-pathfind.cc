@@ -2,6 +2,7 @@
 
 #include "mon-pathfind.h"
 
+#include "dbg-prof.h"
 #include "directn.h"
 #include "env.h"
 #include "los.h"
@@ -150,6 +151,8 @@ void monster_pathfind::fill_traversability(const monster* mon, int _range,
 
 bool monster_pathfind::start_pathfind(bool msg)
 {
+    PROF_SCOPE(PROF_MONSTER_PATHFIND);
+
     // NOTE: We never do any traversable() check for the target square.
     //       This means that even if the target cannot be reached
     //       we may still find a path leading adjacent to this position, which
@@ -830,6 +830,11 @@ monster* get_free_monster()
             if (mons.mindex() > env.max_mon_index)
                 env.max_mon_index = mons.mindex();
 
+            auto slot = lower_bound(env.mon_slots.begin(),
+                                    env.mon_slots.end(), mons.mindex());
+            if (slot == env.mon_slots.end() || *slot != mons.mindex())
+                env.mon_slots.insert(slot, mons.mindex());
+
             mons.reset();
             return &mons;
         }
@@ -13,6 +13,7 @@
 #include "abyss.h" // splash_corruption
 #include "act-iter.h"
 #include "areas.h"
+#include "arena.h"
 #include "artefact.h"
 #include "art-enum.h"
 #include "attack.h"
@@ -4363,6 +4364,9 @@ int monster::hurt(const actor *agent, int amount, beam_type flavour,
             hit_points = max_hit_points;
         }
 
+        if (amount > 0 && crawl_state.game_is_arena())
+            arena_monster_hurt(this, agent, amount);
+
         if (flavour == BEAM_DESTRUCTION || flavour == BEAM_MINDBURST)
         {
             if (has_blood())
@@ -424,6 +424,8 @@ void initialise_item_descriptions()
             }
         }
     }
+    // Unidentified items are named after these.
+    invalidate_item_names();
 }
 
 void fix_up_jiyva_name()
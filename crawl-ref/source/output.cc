@@ -1561,6 +1561,11 @@ void print_stats()
         you.redraw_status_lights = true;
     }
 
+#ifdef USE_TILE_WEB
+    // The flags are cleared below, so webtiles has to look at them now.
+    tiles.note_player_redraw();
+#endif
+
     if (you.redraw_title)
         _redraw_title();
     if (you.redraw_hit_points)
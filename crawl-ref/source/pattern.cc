@@ -1,5 +1,7 @@
 #include "AppHdr.h"
 
+#include <climits>
+
 #ifdef REGEX_PCRE
     // Statically link pcre on Windows
     #if defined(TARGET_OS_WINDOWS)
@@ -193,6 +195,215 @@ pattern_match text_pattern::match_location(const char *s, int length) const
         return pattern_match::failed(string(s));
 }
 
+// The index of the ] closing the bracket expression that starts at i, or
+// string::npos if it isn't closed.
+static size_t _bracket_end(const string &pattern, size_t i)
+{
+    const size_t len = pattern.size();
+    // A leading ] (after any ^) is part of the class.
+    size_t j = i + 1;
+    if (j < len && pattern[j] == '^')
+        ++j;
+    if (j < len && pattern[j] == ']')
+        ++j;
+    for (; j < len && pattern[j] != ']'; ++j)
+    {
+        if (pattern[j] == '\\')
+            ++j;
+        // [:alpha:], [=e=] and [.-.] can hold a ] of their own.
+        else if (pattern[j] == '[' && j + 1 < len && pattern[j + 1]
+                 && strchr(":=.", pattern[j + 1]))
+        {
+            const char close[] = { pattern[j + 1], ']', 0 };
+            j = pattern.find(close, j + 2);
+            if (j == string::npos)
+                return string::npos;
+            ++j;
+        }
+    }
+    return j < len ? j : string::npos;
+}
+
+// The index of the last character of the escape whose backslash is at i.
+// Erring long is fine: it only means fewer literals are found.
+static size_t _escape_end(const string &pattern, size_t i)
+{
+    const size_t len = pattern.size();
+    size_t j = i + 1;
+    const char c = pattern[j];
+    if (!isaalnum(c))
+        return j;
+
+    // \Q...\E quotes everything up to the \E.
+    if (c == 'Q')
+    {
+        j = pattern.find("\\E", j);
+        return j == string::npos ? len - 1 : j + 1;
+    }
+
+    // \x{41}, \p{Lu}, \k<name>, \g'name' and so on.
+    const char open = j + 1 < len ? pattern[j + 1] : 0;
+    if (open == '{'
+        || ((c == 'k' || c == 'g') && (open == '<' || open == '\'')))
+    {
+        j = pattern.find(open == '{' ? '}' : open == '<' ? '>' : '\'', j + 2);
+        return j == string::npos ? len - 1 : j;
+    }
+
+    switch (c)
+    {
+    case 'x': // \x41
+        for (int n = 0; n < 2 && j + 1 < len && isxdigit(pattern[j + 1]); ++n)
+            ++j;
+        break;
+    case 'c': // \cA
+    case 'p': // \pL
+    case 'P':
+        if (j + 1 < len)
+            ++j;
+        break;
+    case 'g': // \g-1
+        if (open == '-' || open == '+')
+            ++j;
+        while (j + 1 < len && isadigit(pattern[j + 1]))
+            ++j;
+        break;
+    default:
+        // Octal codes and backreferences: \101, \0, \12.
+        if (isadigit(c))
+            while (j + 1 < len && isadigit(pattern[j + 1]))
+                ++j;
+        break;
+    }
+    return j;
+}
+
+// Only needs to be conservative: skipping over parts of the pattern, or
+// splitting a literal string in two, just finds fewer requirements.
+bool text_pattern::required_substrings(vector<string> &subs) const
+{
+    // Inline options (such as (?x) to ignore spaces) and alternations
+    // change what the literals mean.
+    if (pattern.find("(?") != string::npos
+        || pattern.find("(*") != string::npos)
+    {
+        return false;
+    }
+
+    string run;
+    auto end_run = [&]()
+    {
+        if (!run.empty())
+            subs.push_back(run);
+        run.clear();
+    };
+
+    const size_t len = pattern.size();
+    for (size_t i = 0; i < len; ++i)
+    {
+        const char c = pattern[i];
+        switch (c)
+        {
+        case '|':
+            subs.clear();
+            return false;
+
+        case '*': case '?': case '{': case '+':
+        {
+            // Quantifiers can be stacked (a+? is (a+)? in POSIX); unless
+            // they're all +, the last character was optional.
+            bool optional = false;
+            for (; i < len && strchr("*?{+", pattern[i]); ++i)
+            {
+                if (pattern[i] != '+')
+                    optional = true;
+                if (pattern[i] == '{')
+                {
+                    i = pattern.find('}', i);
+                    if (i == string::npos)
+                        i = len - 1;
+                }
+            }
+            --i;
+            if (optional && !run.empty())
+                run.erase(run.size() - 1);
+            end_run();
+            break;
+        }
+
+        case '(':
+        {
+            end_run();
+            // Groups may be optional or repeated, so skip them.
+            int depth = 1;
+            for (++i; i < len && depth; ++i)
+            {
+                if (pattern[i] == '\\' && i + 1 < len)
+                    i = _escape_end(pattern, i);
+                else if (pattern[i] == '[')
+                {
+                    i = _bracket_end(pattern, i);
+                    if (i == string::npos)
+                        break;
+                }
+                else if (pattern[i] == '(')
+                    ++depth;
+                else if (pattern[i] == ')')
+                    --depth;
+            }
+            if (depth)
+            {
+                subs.clear();
+                return false;
+            }
+            --i;
+            break;
+        }
+
+        case '[':
+        {
+            end_run();
+            i = _bracket_end(pattern, i);
+            if (i == string::npos)
+            {
+                subs.clear();
+                return false;
+            }
+            break;
+        }
+
+        case '\\':
+            if (i + 1 == len)
+            {
+                subs.clear();
+                return false;
+            }
+            // \w, \b, \1, \x41 and so on aren't literals.
+            if (isaalnum(pattern[i + 1]) || (pattern[i + 1] & 0x80))
+            {
+                end_run();
+                i = _escape_end(pattern, i);
+            }
+            else
+            {
+                run += pattern[i + 1];
+                ++i;
+            }
+            break;
+
+        default:
+            // Case-insensitive matches of non-ASCII text are hard to predict.
+            if (c == '.' || c == '^' || c == '$' || (c & 0x80))
+                end_run();
+            else
+                run += c;
+            break;
+        }
+    }
+    end_run();
+    return true;
+}
+
 const plaintext_pattern &plaintext_pattern::operator= (const string &spattern)
 {
     if (pattern == spattern)
@@ -229,3 +440,115 @@ pattern_match plaintext_pattern::match_location(const string &s) const
     else
         return pattern_match::failed(s);
 }
+
+// Can this regex only ever match itself, literally?
+static bool _is_plain_string(const text_pattern &pat)
+{
+    const string &s = pat.tostring();
+    return !s.empty() && !pat.ignores_case()
+           && s.find_first_of(".[]()*+?{}|^$\\") == string::npos;
+}
+
+void pattern_list::clear()
+{
+    patterns.clear();
+    literals.clear();
+    regexes.clear();
+    nodes.clear();
+    built = false;
+}
+
+void pattern_list::add(const text_pattern &pat)
+{
+    const int index = patterns.size();
+    patterns.push_back(pat);
+    if (_is_plain_string(pat))
+        literals.push_back(index);
+    else
+        regexes.push_back(index);
+    built = false;
+}
+
+void pattern_list::build() const
+{
+    nodes.clear();
+    nodes.push_back({ {}, 0, INT_MAX });
+
+    for (int index : literals)
+    {
+        int node = 0;
+        for (char c : patterns[index].tostring())
+        {
+            auto it = nodes[node].next.find(c);
+            if (it == nodes[node].next.end())
+            {
+                nodes.push_back({ {}, 0, INT_MAX });
+                it = nodes[node].next.emplace(c, nodes.size() - 1).first;
+            }
+            node = it->second;
+        }
+        nodes[node].first = min(nodes[node].first, index);
+    }
+
+    // Breadth-first, so that every node's failure link is finished before
+    // its children need it.
+    vector<int> queue;
+    for (const auto &edge : nodes[0].next)
+        queue.push_back(edge.second);
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        const int node = queue[i];
+        for (const auto &edge : nodes[node].next)
+        {
+            int fail = nodes[node].fail;
+            while (fail && !nodes[fail].next.count(edge.first))
+                fail = nodes[fail].fail;
+            auto it = nodes[fail].next.find(edge.first);
+            const int child = edge.second;
+            nodes[child].fail = it != nodes[fail].next.end() ? it->second : 0;
+            nodes[child].first = min(nodes[child].first,
+                                     nodes[nodes[child].fail].first);
+            queue.push_back(child);
+        }
+    }
+
+    built = true;
+}
+
+int pattern_list::first_literal_match(const string &s) const
+{
+    if (literals.empty())
+        return INT_MAX;
+    if (!built)
+        build();
+
+    int best = INT_MAX;
+    int node = 0;
+    for (char c : s)
+    {
+        auto it = nodes[node].next.find(c);
+        while (node && it == nodes[node].next.end())
+        {
+            node = nodes[node].fail;
+            it = nodes[node].next.find(c);
+        }
+        node = it != nodes[node].next.end() ? it->second : 0;
+        best = min(best, nodes[node].first);
+        if (best == literals[0])
+            break;
+    }
+    return best;
+}
+
+int pattern_list::first_match(const string &s) const
+{
+    const int literal = first_literal_match(s);
+    for (int index : regexes)
+    {
+        if (index > literal)
+            break;
+        if (patterns[index].matches(s))
+            return index;
+    }
+    return literal == INT_MAX ? -1 : literal;
+}
@@ -116,6 +116,13 @@ public:
         return pattern;
     }
 
+    bool ignores_case() const { return ignore_case; }
+
+    // Strings of (ASCII) literal characters that every match has to
+    // contain. Returns false for patterns too clever to tell, such as
+    // alternations or ones with inline options.
+    bool required_substrings(vector<string> &subs) const;
+
 private:
     string pattern;
     mutable void *compiled_pattern;
@@ -154,3 +161,43 @@ private:
     string pattern;
     bool ignore_case;
 };
+
+/**
+ * An ordered list of text_patterns, matched as a unit. first_match() gives
+ * the index of the first pattern in the list that matches, just as trying
+ * each in turn would, but patterns that are plain strings are all looked for
+ * together in a single pass over the text (Aho-Corasick); only the real
+ * regexes listed before the earliest plain-string hit are tried separately.
+ */
+class pattern_list
+{
+public:
+    pattern_list() : built(false) { }
+
+    void clear();
+    void add(const text_pattern &pat);
+
+    bool empty() const { return patterns.empty(); }
+    size_t size() const { return patterns.size(); }
+    const text_pattern &operator[](size_t i) const { return patterns[i]; }
+
+    // Index of the first matching pattern, or -1 if none match.
+    int first_match(const string &s) const;
+
+private:
+    struct literal_node
+    {
+        map<char, int> next;
+        int fail;
+        int first;     // lowest pattern index ending here or at a suffix
+    };
+
+    void build() const;
+    int first_literal_match(const string &s) const;
+
+    vector<text_pattern> patterns;
+    vector<int> literals;          // indices of plain-string patterns
+    vector<int> regexes;           // indices of everything else
+    mutable vector<literal_node> nodes;
+    mutable bool built;
+};
@@ -332,6 +332,15 @@ player_equip_set::player_equip_set()
     artprop_cache.init(0);
     do_unrand_reacts = 0;
     do_unrand_death_effects = 0;
+    stat_totals_valid = false;
+}
+
+bool equip_stat_totals::operator==(const equip_stat_totals &other) const
+{
+    return res_fire == other.res_fire && res_cold == other.res_cold
+           && res_elec == other.res_elec && res_poison == other.res_poison
+           && res_steam == other.res_steam && res_corr == other.res_corr
+           && stealth == other.stealth && shield == other.shield;
 }
 
 int player_equip_set::wearing_ego(object_class_type obj_type, int ego) const
@@ -555,6 +564,7 @@ bool can_equip_item(const item_def& item, bool include_form, string* veto_reason
 
 void player_equip_set::update()
 {
+    stat_totals_valid = false;
     unrand_active.reset();
     artprop_cache.init(0);
 
@@ -938,6 +948,7 @@ void player_equip_set::add(item_def& item, equipment_slot slot)
     ASSERT(slot != SLOT_UNUSED);
 
     items.emplace_back(item, slot);
+    stat_totals_valid = false;
 
     // Any slots past the first must be overflow slots, so place an overflow
     // entry for this item in all of them.
@@ -977,6 +988,7 @@ void player_equip_set::add(item_def& item, equipment_slot slot)
 
 void player_equip_set::remove(const item_def& item)
 {
+    stat_totals_valid = false;
     for (int i = (int)items.size() - 1; i >= 0; --i)
     {
         if (items[i].item == item.link)
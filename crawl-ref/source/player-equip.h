@@ -37,6 +37,23 @@ struct player_equip_entry
     player_equip_entry(int _item, equipment_slot _slot, bool _melded, bool _attuned,
                        bool _is_overflow);
 };
+// What equipped items contribute to some often-checked derived stats (not
+// counting the dragonskin cloak's random half-resistances). Worked out on
+// demand by player.cc, and thrown away whenever the equipment changes.
+struct equip_stat_totals
+{
+    int res_fire;
+    int res_cold;
+    int res_elec;
+    int res_poison;
+    int res_steam;
+    bool res_corr;
+    int stealth;    // from armour types, egos, jewellery and artefacts
+    int shield;     // SH * 100 from reflection and shielding
+
+    bool operator==(const equip_stat_totals &other) const;
+};
+
 struct player_equip_set
 {
     // The number of each type of equipment slot that the player currently has
@@ -62,6 +79,11 @@ struct player_equip_set
     // Number of unrands that we should run the _*_death_effects function for.
     int do_unrand_death_effects;
 
+    // Cached equip_stat_totals, valid until the next add(), remove() or
+    // update().
+    mutable equip_stat_totals stat_totals;
+    mutable bool stat_totals_valid;
+
     player_equip_set();
 
     // Initialises proper values for cached values. (To be called after full
@@ -1227,34 +1227,100 @@ int player::piety() const
     return max(0, min((int)raw_piety, MAX_PIETY - you.attribute[ATTR_OSTRACISM]));
 }
 
-// If temp is set to false, temporary sources or resistance won't be counted.
-int player_res_fire(bool allow_random, bool temp, bool items)
+/**
+ * Count up what the player's equipment contributes to various stats.
+ * Use _equip_stats() instead, which only does this when the equipment has
+ * changed.
+ */
+static equip_stat_totals _scan_equip_stats()
 {
-    int rf = 0;
+    equip_stat_totals totals;
+    const item_def *body_armour = you.body_armour();
 
-    if (items)
-    {
-        // rings of fire resistance/fire
-        rf += you.wearing_jewellery(RING_PROTECTION_FROM_FIRE);
-        rf += you.wearing_jewellery(RING_FIRE);
+    // rings of fire resistance/fire, rings of ice, staves, body armour, ego
+    // armours and randarts:
+    totals.res_fire = you.wearing_jewellery(RING_PROTECTION_FROM_FIRE)
+                      + you.wearing_jewellery(RING_FIRE)
+                      - you.wearing_jewellery(RING_ICE)
+                      + you.wearing(OBJ_STAVES, STAFF_FIRE)
+                      + you.wearing_ego(OBJ_ARMOUR, SPARM_FIRE_RESISTANCE)
+                      + you.wearing_ego(OBJ_ARMOUR, SPARM_RESISTANCE)
+                      + you.scan_artefacts(ARTP_FIRE);
+
+    // rings of cold resistance/ice, rings of fire, and the rest as above:
+    totals.res_cold = you.wearing_jewellery(RING_PROTECTION_FROM_COLD)
+                      + you.wearing_jewellery(RING_ICE)
+                      - you.wearing_jewellery(RING_FIRE)
+                      + you.wearing(OBJ_STAVES, STAFF_COLD)
+                      + you.wearing_ego(OBJ_ARMOUR, SPARM_COLD_RESISTANCE)
+                      + you.wearing_ego(OBJ_ARMOUR, SPARM_RESISTANCE)
+                      + you.scan_artefacts(ARTP_COLD);
+
+    totals.res_elec = you.wearing(OBJ_STAVES, STAFF_AIR)
+                      + you.scan_artefacts(ARTP_ELECTRICITY);
+
+    totals.res_poison = you.wearing_jewellery(RING_POISON_RESISTANCE)
+                        + you.wearing(OBJ_STAVES, STAFF_ALCHEMY)
+                        + you.wearing_ego(OBJ_ARMOUR, SPARM_POISON_RESISTANCE)
+                        + you.scan_artefacts(ARTP_POISON);
+
+    totals.res_steam = 0;
+
+    totals.res_corr = you.scan_artefacts(ARTP_RCORR)
+                      || you.wearing(OBJ_ARMOUR, ARM_ACID_DRAGON_ARMOUR)
+                      || you.wearing_jewellery(RING_RESIST_CORROSION)
+                      || you.wearing_ego(OBJ_ARMOUR, SPARM_PRESERVATION);
+
+    totals.stealth = STEALTH_PIP * (you.scan_artefacts(ARTP_STEALTH)
+                                    + you.wearing_ego(OBJ_ARMOUR, SPARM_STEALTH)
+                                    + you.wearing_jewellery(RING_STEALTH));
+
+    totals.shield = you.wearing_jewellery(AMU_REFLECTION) * AMU_REFLECT_SH * 100
+                    + you.scan_artefacts(ARTP_SHIELDING) * 200;
 
-        // rings of ice
-        rf -= you.wearing_jewellery(RING_ICE);
+    if (body_armour)
+    {
+        const int type = body_armour->sub_type;
+        totals.res_fire += armour_type_prop(type, ARMF_RES_FIRE);
+        totals.res_cold += armour_type_prop(type, ARMF_RES_COLD);
+        totals.res_elec += armour_type_prop(type, ARMF_RES_ELEC);
+        totals.res_poison += armour_type_prop(type, ARMF_RES_POISON);
+        totals.res_steam += armour_type_prop(type, ARMF_RES_STEAM) * 2;
+        totals.stealth += armour_type_prop(type, ARMF_STEALTH) * STEALTH_PIP;
+    }
 
-        // Staves
-        rf += you.wearing(OBJ_STAVES, STAFF_FIRE);
+    return totals;
+}
 
-        // body armour:
-        const item_def *body_armour = you.body_armour();
-        if (body_armour)
-            rf += armour_type_prop(body_armour->sub_type, ARMF_RES_FIRE);
+/**
+ * What does the player's equipment contribute to various stats? These are
+ * asked for many times a turn, so they're kept with the equipment until it
+ * changes. DEBUG_STAT_CACHE builds check them against a fresh count each
+ * time.
+ */
+static const equip_stat_totals &_equip_stats()
+{
+    const player_equip_set &equipment = you.equipment;
+    if (!equipment.stat_totals_valid)
+    {
+        equipment.stat_totals = _scan_equip_stats();
+        equipment.stat_totals_valid = true;
+    }
+#ifdef DEBUG_STAT_CACHE
+    else
+        ASSERT(equipment.stat_totals == _scan_equip_stats());
+#endif
+    return equipment.stat_totals;
+}
 
-        // ego armours
-        rf += you.wearing_ego(OBJ_ARMOUR, SPARM_FIRE_RESISTANCE);
-        rf += you.wearing_ego(OBJ_ARMOUR, SPARM_RESISTANCE);
+// If temp is set to false, temporary sources or resistance won't be counted.
+int player_res_fire(bool allow_random, bool temp, bool items)
+{
+    int rf = 0;
 
-        // randart weapons:
-        rf += you.scan_artefacts(ARTP_FIRE);
+    if (items)
+    {
+        rf += _equip_stats().res_fire;
 
         // dragonskin cloak: 0.5 to draconic resistances
         if (allow_random && you.unrand_equipped(UNRAND_DRAGONSKIN)
@@ -1305,11 +1371,7 @@ int player_res_steam(bool allow_random, bool temp, bool items)
     res += you.get_mutation_level(MUT_STEAM_RESISTANCE) * 2;
 
     if (items)
-    {
-        const item_def *body_armour = you.body_armour();
-        if (body_armour)
-            res += armour_type_prop(body_armour->sub_type, ARMF_RES_STEAM) * 2;
-    }
+        res += _equip_stats().res_steam;
 
     // Don't let rF- override steam immunity.
     if (rf > 0 || res == 0)
@@ -1338,27 +1400,7 @@ int player_res_cold(bool allow_random, bool temp, bool items)
 
     if (items)
     {
-        // rings of cold resistance/ice
-        rc += you.wearing_jewellery(RING_PROTECTION_FROM_COLD);
-        rc += you.wearing_jewellery(RING_ICE);
-
-        // rings of fire
-        rc -= you.wearing_jewellery(RING_FIRE);
-
-        // Staves
-        rc += you.wearing(OBJ_STAVES, STAFF_COLD);
-
-        // body armour:
-        const item_def *body_armour = you.body_armour();
-        if (body_armour)
-            rc += armour_type_prop(body_armour->sub_type, ARMF_RES_COLD);
-
-        // ego armours
-        rc += you.wearing_ego(OBJ_ARMOUR, SPARM_COLD_RESISTANCE);
-        rc += you.wearing_ego(OBJ_ARMOUR, SPARM_RESISTANCE);
-
-        // randart weapons:
-        rc += you.scan_artefacts(ARTP_COLD);
+        rc += _equip_stats().res_cold;
 
         // dragonskin cloak: 0.5 to draconic resistances
         if (allow_random && you.unrand_equipped(UNRAND_DRAGONSKIN)
@@ -1402,13 +1444,8 @@ int player_res_corrosion(bool allow_random, bool temp, bool items)
 
     if (items)
     {
-        if (you.scan_artefacts(ARTP_RCORR)
-            || you.wearing(OBJ_ARMOUR, ARM_ACID_DRAGON_ARMOUR)
-            || you.wearing_jewellery(RING_RESIST_CORROSION)
-            || you.wearing_ego(OBJ_ARMOUR, SPARM_PRESERVATION))
-        {
+        if (_equip_stats().res_corr)
             return 1;
-        }
 
         // dragonskin cloak: 0.5 to draconic resistances
         if (allow_random && you.unrand_equipped(UNRAND_DRAGONSKIN) && coinflip())
@@ -1424,16 +1461,7 @@ int player_res_electricity(bool allow_random, bool temp, bool items)
 
     if (items)
     {
-        // staff
-        re += you.wearing(OBJ_STAVES, STAFF_AIR);
-
-        // body armour:
-        const item_def *body_armour = you.body_armour();
-        if (body_armour)
-            re += armour_type_prop(body_armour->sub_type, ARMF_RES_ELEC);
-
-        // randart weapons:
-        re += you.scan_artefacts(ARTP_ELECTRICITY);
+        re += _equip_stats().res_elec;
 
         // dragonskin cloak: 0.5 to draconic resistances
         if (allow_random && you.unrand_equipped(UNRAND_DRAGONSKIN)
@@ -1491,22 +1519,7 @@ int player_res_poison(bool allow_random, bool temp, bool items, bool forms)
 
     if (items)
     {
-        // rings of poison resistance
-        rp += you.wearing_jewellery(RING_POISON_RESISTANCE);
-
-        // Staves
-        rp += you.wearing(OBJ_STAVES, STAFF_ALCHEMY);
-
-        // ego armour:
-        rp += you.wearing_ego(OBJ_ARMOUR, SPARM_POISON_RESISTANCE);
-
-        // body armour:
-        const item_def *body_armour = you.body_armour();
-        if (body_armour)
-            rp += armour_type_prop(body_armour->sub_type, ARMF_RES_POISON);
-
-        // rPois+ artefacts
-        rp += you.scan_artefacts(ARTP_POISON);
+        rp += _equip_stats().res_poison;
 
         // dragonskin cloak: 0.5 to draconic resistances
         if (allow_random && you.unrand_equipped(UNRAND_DRAGONSKIN)
@@ -2157,8 +2170,7 @@ int player_shield_class(int scale, bool random, bool ignore_temporary)
     }
 
     shield += qazlal_sh_boost() * 100;
-    shield += you.wearing_jewellery(AMU_REFLECTION) * AMU_REFLECT_SH * 100;
-    shield += you.scan_artefacts(ARTP_SHIELDING) * 200;
+    shield += _equip_stats().shield;
 
     return random ? div_rand_round(shield * scale, 100) : ((shield * scale) / 100);
 }
@@ -3175,14 +3187,10 @@ int player_stealth()
         const int evp = you.unadjusted_body_armour_penalty();
         const int penalty = evp * evp * 2 / 3;
         stealth -= penalty;
-
-        const int pips = armour_type_prop(arm->sub_type, ARMF_STEALTH);
-        stealth += pips * STEALTH_PIP;
     }
 
-    stealth += STEALTH_PIP * you.scan_artefacts(ARTP_STEALTH);
-    stealth += STEALTH_PIP * you.wearing_ego(OBJ_ARMOUR, SPARM_STEALTH);
-    stealth += STEALTH_PIP * you.wearing_jewellery(RING_STEALTH);
+    // Armour type, egos, rings and artefacts.
+    stealth += _equip_stats().stealth;
 
     if (you.duration[DUR_STEALTH])
         stealth += STEALTH_PIP * 2;
@@ -104,6 +104,11 @@ static coord_def floor_vec(const geom::vector &v)
 
 coord_def ray_def::pos() const
 {
+    if (fp_cells && fp_step)
+    {
+        const coord_def c = fp_cells[fp_step - 1];
+        return fp_origin + coord_def(fp_sign.x * c.x, fp_sign.y * c.y);
+    }
     ASSERT(_valid());
     // XXX: pretty arbitrary if we're just on a corner.
     return floor_vec(r.start);
@@ -190,10 +195,34 @@ static geom::vector _normalize(const geom::vector &v)
     return (1.0 / n) * v;
 }
 
+// Bring r up to the cell the ray has reached on its footprint, and step it
+// geometrically from then on.
+void ray_def::drop_footprint()
+{
+    if (!fp_cells)
+        return;
+    const int steps = fp_step;
+    fp_cells = nullptr;
+    fp_length = fp_step = 0;
+    for (int i = 0; i < steps; ++i)
+        advance();
+}
+
 // Return true if we didn't hit a corner, hence if this
 // is a good ray so far.
 bool ray_def::advance()
 {
+    if (fp_cells)
+    {
+        // Footprints never pass through corners.
+        if (fp_step < fp_length)
+        {
+            ++fp_step;
+            return true;
+        }
+        drop_footprint();
+    }
+
     ASSERT(_valid());
     r.dir = _normalize(r.dir);
     if (on_corner)
@@ -226,6 +255,7 @@ bool ray_def::advance()
 
 void ray_def::regress()
 {
+    drop_footprint();
     ASSERT(_valid());
     r.dir = -r.dir;
     advance();
@@ -475,6 +505,7 @@ static geom::ray _bounce_corner(const geom::ray &rorig, const coord_def &side,
 // Nudge an on-corner ray to be inside the diamond.
 void ray_def::nudge_inside()
 {
+    drop_footprint();
     ASSERT(on_corner);
     geom::vector centre(pos().x + 0.5, pos().y + 0.5);
     // Move a little bit towards cell center.
@@ -485,6 +516,7 @@ void ray_def::nudge_inside()
 
 void ray_def::bounce(const reflect_grid &rg)
 {
+    drop_footprint();
     ASSERT(_valid());
     ASSERT(!rg(coord_def(0,0))); // The cell we bounce from is not solid.
 #ifdef ASSERTS
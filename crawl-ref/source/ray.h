@@ -17,15 +17,29 @@ struct ray_def
     bool on_corner;
     int cycle_idx;
 
-    ray_def() : on_corner(false), cycle_idx(-1) {}
+    // Rays from find_ray() step along the cells precomputed for them by
+    // the LOS code, fp_cells[0..fp_length-1] mirrored by fp_sign and
+    // translated to fp_origin, leaving r where it started. r only catches
+    // up (see drop_footprint()) when the ray bounces, regresses or walks
+    // off the end of its footprint.
+    const coord_def *fp_cells;
+    int fp_length;
+    int fp_step;
+    coord_def fp_origin;
+    coord_def fp_sign;
+
+    ray_def() : on_corner(false), cycle_idx(-1), fp_cells(nullptr),
+                fp_length(0), fp_step(0) {}
     ray_def(const geom::ray& _r)
-        : r(_r), on_corner(false), cycle_idx(-1) {}
+        : r(_r), on_corner(false), cycle_idx(-1), fp_cells(nullptr),
+          fp_length(0), fp_step(0) {}
 
     coord_def pos() const;
     bool advance();
     void bounce(const reflect_grid &rg);
     void nudge_inside();
     void regress();
+    void drop_footprint();
 
     bool _valid() const;
 };
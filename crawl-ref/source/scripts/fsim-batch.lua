@@ -0,0 +1,74 @@
+-- Runs the fight simulator against a list of monsters without the wizard
+-- UI, spreading each skill scan over worker processes. Results are appended
+-- to fsim.txt (or fsim.csv with -csv) just as the wizard command writes them.
+--
+-- crawl -script fsim-batch "orc warrior" "stone giant" -combo MiFi \
+--     -weapon morningstar -xl 20 -rounds 4000 -jobs 8 -seed 1
+
+local basic_usage = [=[
+Usage: fsim-batch <monster> [<monster> ...] [options]
+Options:
+  -combo <combo>     the character to sim with (default: MiFi)
+  -weapon <weapon>   their starting weapon (default: morningstar)
+  -xl <xl>           their experience level (default: 20)
+  -rounds <n>        rounds per cell (default: fsim_rounds)
+  -mode <mode>       attack or defence (default: attack)
+  -scale <skills>    fsim_scale, e.g. "weapon, fighting/2" or "xl"
+  -kit <kits>        fsim_kit, a comma separated list of kits
+  -double            scan two skills against each other
+  -csv               write tab separated values to fsim.csv
+  -jobs <n>          worker processes (default: one per CPU)
+  -seed <n>          seed for the cells (default: 0)
+]=]
+
+local function parse_args(args)
+  local init, params = { }, { }
+  local cur = nil
+  for _, a in ipairs(args) do
+    if string.find(a, '-') == 1 then
+      cur = a
+      params[a] = { }
+    elseif cur == nil then
+      table.insert(init, a)
+    else
+      table.insert(params[cur], a)
+    end
+  end
+  return init, params
+end
+
+local function one_arg(args, a, default)
+  if args[a] == nil or #args[a] ~= 1 then return default end
+  return args[a][1]
+end
+
+local monsters, args = parse_args(crawl.script_args())
+if #monsters == 0 or args["-help"] ~= nil then
+  script.usage(basic_usage)
+end
+
+you.init(one_arg(args, "-combo", "MiFi"), one_arg(args, "-weapon", "morningstar"))
+you.set_xl(tonumber(one_arg(args, "-xl", 20)))
+debug.reset_player_data()
+debug.goto_place("D:1")
+debug.generate_level()
+dgn.grid(2, 2, "floor")
+dgn.grid(2, 3, "floor")
+you.moveto(2, 2)
+
+crawl.setopt("fsim_mode = " .. one_arg(args, "-mode", "attack"))
+crawl.setopt("fsim_csv = " .. (args["-csv"] ~= nil and "true" or "false"))
+if args["-rounds"] ~= nil then
+  crawl.setopt("fsim_rounds = " .. one_arg(args, "-rounds"))
+end
+if args["-scale"] ~= nil then
+  crawl.setopt("fsim_scale = " .. one_arg(args, "-scale"))
+end
+if args["-kit"] ~= nil then
+  crawl.setopt("fsim_kit = " .. one_arg(args, "-kit"))
+end
+
+wiz.fsim_batch(monsters, args["-double"] ~= nil,
+               tonumber(one_arg(args, "-jobs", 0)),
+               tonumber(one_arg(args, "-seed", 0)))
+crawl.stderr("Done.")
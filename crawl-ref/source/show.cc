@@ -505,6 +505,9 @@ static void _update_monster(monster* mons)
 **/
 void show_update_at(const coord_def &gp, layers_type layers)
 {
+    const dungeon_feature_type old_feat = env.map_knowledge(gp).feat();
+    const trap_type old_trap = env.map_knowledge(gp).trap();
+
     if (you.see_cell(gp))
         env.map_knowledge(gp).clear_data();
     else if (!env.map_knowledge(gp).known())
@@ -513,6 +516,13 @@ void show_update_at(const coord_def &gp, layers_type layers)
         env.map_knowledge(gp).clear_monster();
 
     force_show_update_at(gp, layers);
+
+    // Travel routes only need redoing when the terrain we know about changes.
+    if (env.map_knowledge(gp).feat() != old_feat
+        || env.map_knowledge(gp).trap() != old_trap)
+    {
+        invalidate_travel_plan();
+    }
 }
 
 void force_show_update_at(const coord_def &gp, layers_type layers)
@@ -16,6 +16,7 @@
 #include "colour.h"
 #include "coordit.h"
 #include "database.h"
+#include "dbg-prof.h"
 #include "delay.h"
 #include "dgn-overview.h"
 #include "directn.h"
@@ -774,6 +775,7 @@ void floor_transition(dungeon_feature_type how,
                       bool update_travel_cache)
 {
     const level_id old_level = level_id::current();
+    prof_begin_transition(old_level);
 
     // Clean up fake blood.
     heal_flayed_effect(&you, true, true);
@@ -1126,6 +1128,8 @@ void floor_transition(dungeon_feature_type how,
 
     autotoggle_autopickup(false);
     request_autopickup();
+
+    prof_end_transition(level_id::current(), newlevel);
 }
 
 /**
@@ -1402,6 +1406,7 @@ static void _update_level_state()
 
 void new_level(bool restore)
 {
+    TRANSITION_PHASE(TRANS_ARRIVE);
     print_stats_level();
     update_whereis();
 
@@ -27,6 +27,7 @@
 #include "god-passive.h"
 #include "hints.h"
 #include "invent.h"
+#include "item-name.h"
 #include "item-prop.h"
 #include "item-status-flag-type.h"
 #include "items.h"
@@ -65,7 +66,18 @@ string userdef_annotate_item(const char *s, const item_def *item)
     return ann;
 }
 
-string stash_annotate_item(const char *s, const item_def *item)
+static const string AUTOPICKUP_TAG = " {autopickup}";
+
+// Whether to tag an item {autopickup} in searches. That depends on the
+// inventory, god and mutations as well as the item, so it can't be cached
+// with the rest of the search text.
+static bool _search_autopickup(const item_def &item)
+{
+    return Options.autopickup_search && item_needs_autopickup(item);
+}
+
+string stash_annotate_item(const char *s, const item_def *item,
+                           bool autopickup)
 {
     // the special-casing of gold here is for the sake of gozag players in
     // extreme circumstances. It does mean that custom annotation code can't
@@ -94,8 +106,8 @@ string stash_annotate_item(const char *s, const item_def *item)
     // autopickup configuration annotations, and annotating an item based on
     // item_needs_autopickup while trying to decide if the item needs to be
     // autopickedup leads to infinite recursion
-    if (Options.autopickup_search && item_needs_autopickup(*item))
-        text += " {autopickup}";
+    if (autopickup && _search_autopickup(*item))
+        text += AUTOPICKUP_TAG;
 
     return text;
 }
@@ -167,7 +179,9 @@ static void _fully_identify_item(item_def *item)
 // Stash
 // ----------------------------------------------------------------------
 
-Stash::Stash(coord_def pos_) : items()
+Stash::Stash(coord_def pos_)
+    : feat(DNGN_FLOOR), trap(TRAP_UNASSIGNED), items(), search_cache(),
+      search_cache_generation(0)
 {
     // First, fix what square we're interested in
     if (pos_.origin())
@@ -257,11 +271,16 @@ bool Stash::unmark_trapping_nets()
     for (auto &item : items)
         if (item_is_stationary_net(item))
             item.net_placed = false, changed = true;
+    if (changed)
+        search_cache.clear();
     return changed;
 }
 
-void Stash::update()
+bool Stash::update()
 {
+    const dungeon_feature_type old_feat = feat;
+    const string old_feat_desc = feat_desc;
+
     feat = DNGN_FLOOR;
     trap = TRAP_UNASSIGNED;
     feat_desc = "";
@@ -274,13 +293,19 @@ void Stash::update()
 
     int previous_size = items.size();
 
-    // Zap existing items
-    items.clear();
+    // Zap existing items, keeping them around to see whether anything
+    // actually changed.
+    vector<item_def> old_items;
+    old_items.swap(items);
 
     if (!_grid_has_perceived_item(pos))
     {
         visited = true;
-        return;
+        const bool changed = !old_items.empty() || feat != old_feat
+                             || feat_desc != old_feat_desc;
+        if (changed)
+            search_cache.clear();
+        return changed;
     }
 
     // Squares are big, whole piles of loot can be seen on each,
@@ -324,6 +349,25 @@ void Stash::update()
     visited = pos == you.pos()
               || !(stack_greed || glowing_greed || artefact_greed)
               || current_size <= previous_size && visited;
+
+    // Most updates just look at the same pile again; keep the cached search
+    // text in that case.
+    bool changed = feat != old_feat || feat_desc != old_feat_desc
+                   || items.size() != old_items.size();
+    for (size_t i = 0; !changed && i < items.size(); ++i)
+    {
+        const item_def &a = items[i];
+        const item_def &b = old_items[i];
+        changed = !are_items_same(a, b, true)
+                  || a.inscription != b.inscription
+                  || (a.stash_freshness > 0) != (b.stash_freshness > 0)
+                  || is_artefact(a)
+                     && get_artefact_name(a, true)
+                        != get_artefact_name(b, true);
+    }
+    if (changed)
+        search_cache.clear();
+    return changed;
 }
 
 // Returns the item name for a given item, with any appropriate
@@ -375,6 +419,67 @@ string Stash::feature_description() const
     return feat_desc;
 }
 
+void Stash::_fill_search_cache() const
+{
+    if (search_cache_generation != item_name_generation())
+    {
+        search_cache.clear();
+        search_cache_generation = item_name_generation();
+    }
+    if (search_cache.size() == items.size())
+        return;
+
+    search_cache.clear();
+    for (const item_def &item : items)
+    {
+        item_search_text text;
+        text.name = stash_item_name(item);
+        text.haystack = " "
+            + stash_annotate_item(STASH_LUA_SEARCH_ANNOTATE, &item, false);
+        text.autopickup_at = text.haystack.size();
+        text.haystack += " " + text.name;
+        if (is_dumpable_artefact(item))
+            text.haystack += " " + chardump_desc(item);
+        search_cache.push_back(text);
+    }
+}
+
+string Stash::item_search_text::with_autopickup() const
+{
+    return string(haystack).insert(autopickup_at, AUTOPICKUP_TAG);
+}
+
+static uint32_t _trigram_at(const string &s, size_t i)
+{
+    return static_cast<uint8_t>(s[i]) << 16
+           | static_cast<uint8_t>(s[i + 1]) << 8
+           | static_cast<uint8_t>(s[i + 2]);
+}
+
+static void _add_trigrams(const string &text, vector<uint32_t> &trigrams)
+{
+    const string lower = lowercase_string(text);
+    for (size_t i = 0; i + 3 <= lower.size(); ++i)
+        trigrams.push_back(_trigram_at(lower, i));
+}
+
+// Collects the trigrams of everything matches_search() would look at, so
+// that any plain-text match must consist of trigrams from this list.
+void Stash::_add_search_trigrams(const string &prefix,
+                                 vector<uint32_t> &trigrams) const
+{
+    _fill_search_cache();
+    // The index outlives any one turn, so include the text both with and
+    // without the {autopickup} tag.
+    for (const item_search_text &text : search_cache)
+    {
+        _add_trigrams(prefix + text.haystack, trigrams);
+        _add_trigrams(prefix + text.with_autopickup(), trigrams);
+    }
+    if (feat != DNGN_FLOOR)
+        _add_trigrams(prefix + " " + feature_description(), trigrams);
+}
+
 vector<stash_search_result> Stash::matches_search(
     const string &prefix, const base_pattern &search) const
 {
@@ -382,18 +487,18 @@ vector<stash_search_result> Stash::matches_search(
     if (empty())
         return results;
 
-    for (const item_def &item : items)
+    _fill_search_cache();
+    for (size_t i = 0; i < items.size(); ++i)
     {
-        const string s   = stash_item_name(item);
-        const string ann = stash_annotate_item(STASH_LUA_SEARCH_ANNOTATE, &item);
-        string haystack = prefix + " " + ann + " " + s;
-        if (is_dumpable_artefact(item))
-            haystack += " " + chardump_desc(item);
-        if (search.matches(haystack))
+        const item_def &item = items[i];
+        const item_search_text &text = search_cache[i];
+        if (search.matches(prefix + (_search_autopickup(item)
+                                     ? text.with_autopickup()
+                                     : text.haystack)))
         {
             stash_search_result res;
             res.match_type = MATCH_ITEM;
-            res.match = s;
+            res.match = text.name;
             res.primary_sort = item.name(DESC_QUALNAME);
             res.item = item;
             results.push_back(res);
@@ -421,8 +526,9 @@ vector<stash_search_result> Stash::matches_search(
     return results;
 }
 
-void Stash::_update_corpses(int rot_time)
+bool Stash::_update_corpses(int rot_time)
 {
+    bool changed = false;
     for (int i = items.size() - 1; i >= 0; i--)
     {
         item_def &item = items[i];
@@ -435,19 +541,33 @@ void Stash::_update_corpses(int rot_time)
         if (new_rot <= 0 && !mons_has_skeleton(item.mon_type))
         {
             items.erase(items.begin() + i);
+            changed = true;
             continue;
         }
         item.stash_freshness = static_cast<short>(new_rot);
+        // Only the (skeletalised by now) suffix depends on the freshness.
+        if (new_rot <= 0)
+            changed = true;
     }
+    if (changed)
+        search_cache.clear();
+    return changed;
 }
 
-void Stash::_update_identification()
+bool Stash::_update_identification()
 {
+    bool changed = false;
     for (int i = items.size() - 1; i >= 0; i--)
     {
+        const iflags_t old_flags = items[i].flags;
         ash_id_item(items[i]);
         maybe_identify_base_type(items[i]);
+        if (items[i].flags != old_flags)
+            changed = true;
     }
+    if (changed)
+        search_cache.clear();
+    return changed;
 }
 
 void Stash::add_item(item_def &item, bool add_to_front)
@@ -563,6 +683,7 @@ void Stash::load(reader& inf)
 
     // Zap out item vector, in case it's in use (however unlikely)
     items.clear();
+    search_cache.clear();
     // Read in the items
     for (int i = 0; i < count; ++i)
     {
@@ -691,7 +812,11 @@ void ShopInfo::write(FILE *f, bool identify) const
 LevelStashes::LevelStashes()
     : m_place(level_id::current()),
       m_stashes(),
-      m_shops()
+      m_shops(),
+      m_search_index(),
+      m_search_stashes(),
+      m_search_index_valid(false),
+      m_search_index_generation(0)
 {
 }
 
@@ -762,7 +887,8 @@ bool LevelStashes::update_stash(const coord_def& c)
     if (!s)
         return false;
 
-    s->update();
+    if (s->update())
+        m_search_index_valid = false;
     if (s->empty())
         kill_stash(*s);
     return true;
@@ -770,10 +896,13 @@ bool LevelStashes::update_stash(const coord_def& c)
 
 bool LevelStashes::unmark_trapping_nets(const coord_def &c)
 {
-    if (Stash *s = find_stash(c))
-        return s->unmark_trapping_nets();
-    else
-        return false;
+    Stash *s = find_stash(c);
+    if (s && s->unmark_trapping_nets())
+    {
+        m_search_index_valid = false;
+        return true;
+    }
+    return false;
 }
 
 void LevelStashes::move_stash(const coord_def& from, const coord_def& to)
@@ -788,12 +917,14 @@ void LevelStashes::move_stash(const coord_def& from, const coord_def& to)
     s->pos = to;
     m_stashes[s->pos] = *s;
     m_stashes.erase(old_pos);
+    m_search_index_valid = false;
 }
 
 // Removes a Stash from the level.
 void LevelStashes::kill_stash(const Stash &s)
 {
     m_stashes.erase(s.pos);
+    m_search_index_valid = false;
 }
 
 void LevelStashes::add_stash(coord_def p)
@@ -801,7 +932,8 @@ void LevelStashes::add_stash(coord_def p)
     Stash *s = find_stash(p);
     if (s)
     {
-        s->update();
+        if (s->update())
+            m_search_index_valid = false;
         if (s->empty())
             kill_stash(*s);
     }
@@ -809,7 +941,10 @@ void LevelStashes::add_stash(coord_def p)
     {
         Stash new_stash(p);
         if (!new_stash.empty())
+        {
             m_stashes[new_stash.pos] = new_stash;
+            m_search_index_valid = false;
+        }
     }
 }
 
@@ -847,6 +982,79 @@ void LevelStashes::_waypoint_search(
     }
 }
 
+void LevelStashes::_build_search_index() const
+{
+    if (m_search_index_valid
+        && m_search_index_generation == item_name_generation())
+    {
+        return;
+    }
+
+    m_search_index.clear();
+    m_search_stashes.clear();
+    const unsigned int generation = item_name_generation();
+
+    const string lplace = "{" + m_place.describe() + "}";
+    vector<uint32_t> trigrams;
+    for (const auto &entry : m_stashes)
+    {
+        const int idx = m_search_stashes.size();
+        m_search_stashes.push_back(entry.first);
+
+        trigrams.clear();
+        entry.second._add_search_trigrams(lplace, trigrams);
+        sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(unique(trigrams.begin(), trigrams.end()),
+                       trigrams.end());
+        for (uint32_t tri : trigrams)
+            m_search_index[tri].push_back(idx);
+    }
+
+    // Building the search text may have run Lua that invalidated item names
+    // again; that just means the next search rebuilds.
+    m_search_index_generation = generation;
+    m_search_index_valid = true;
+}
+
+// Finds the stashes whose search text contains every trigram of needle (in
+// any case), in m_stashes order. Returns false if the index can't help with
+// this needle, in which case every stash has to be checked.
+bool LevelStashes::_search_candidates(const string &needle,
+                                      vector<coord_def> &candidates) const
+{
+    const string lower = lowercase_string(needle);
+    if (lower.size() < 3)
+        return false;
+
+    _build_search_index();
+
+    // Start from the rarest trigram, and weed out stashes lacking the rest.
+    vector<const vector<int> *> postings;
+    for (size_t i = 0; i + 3 <= lower.size(); ++i)
+    {
+        auto it = m_search_index.find(_trigram_at(lower, i));
+        if (it == m_search_index.end())
+            return true;
+        postings.push_back(&it->second);
+    }
+    sort(postings.begin(), postings.end(),
+         [](const vector<int> *a, const vector<int> *b)
+         { return a->size() < b->size(); });
+
+    for (int idx : *postings[0])
+    {
+        bool found = true;
+        for (size_t i = 1; found && i < postings.size(); ++i)
+        {
+            found = binary_search(postings[i]->begin(), postings[i]->end(),
+                                  idx);
+        }
+        if (found)
+            candidates.push_back(m_search_stashes[idx]);
+    }
+    return true;
+}
+
 void LevelStashes::get_matching_stashes(
         const base_pattern &search,
         vector<stash_search_result> &results) const
@@ -867,15 +1075,30 @@ void LevelStashes::get_matching_stashes(
         return;
     }
 
-    for (const auto &entry : m_stashes)
+    // Plain-text searches only need to look at the stashes the trigram
+    // index can't rule out.
+    vector<coord_def> candidates;
+    const bool indexed = dynamic_cast<const plaintext_pattern *>(&search)
+                         && _search_candidates(s, candidates);
+    auto add_matches = [&](const Stash &stash)
     {
         vector<stash_search_result> new_results =
-            entry.second.matches_search(lplace, search);
+            stash.matches_search(lplace, search);
         for (auto &res : new_results)
         {
             res.pos.id = m_place;
             results.push_back(res);
         }
+    };
+    if (indexed)
+    {
+        for (const coord_def &c : candidates)
+            add_matches(*find_stash(c));
+    }
+    else
+    {
+        for (const auto &entry : m_stashes)
+            add_matches(entry.second);
     }
 
     for (const ShopInfo &shop : m_shops)
@@ -893,13 +1116,15 @@ void LevelStashes::get_matching_stashes(
 void LevelStashes::_update_corpses(int rot_time)
 {
     for (auto &entry : m_stashes)
-        entry.second._update_corpses(rot_time);
+        if (entry.second._update_corpses(rot_time))
+            m_search_index_valid = false;
 }
 
 void LevelStashes::_update_identification()
 {
     for (auto &entry : m_stashes)
-        entry.second._update_identification();
+        if (entry.second._update_identification())
+            m_search_index_valid = false;
 }
 
 void LevelStashes::write(FILE *f, bool identify) const
@@ -946,6 +1171,7 @@ void LevelStashes::load(reader& inf)
     m_place.load(inf);
 
     m_stashes.clear();
+    m_search_index_valid = false;
     for (int i = 0; i < size; ++i)
     {
         Stash s;
@@ -1355,6 +1581,65 @@ static vector<stash_search_result> _stash_filter_duplicates(vector<stash_search_
     return out;
 }
 
+// Turns a search as typed by the player into a pattern, stripping the
+// prefixes that pick the kind of search. Returns nullptr for invalid searches.
+static unique_ptr<base_pattern> _stash_search_pattern(string &csearch,
+                                                      bool &curr_lev)
+{
+    curr_lev = (csearch[0] == '@' || csearch == ".");
+    if (curr_lev)
+    {
+        csearch.erase(0, 1);
+        if (csearch.length() == 0)
+            csearch = ".";
+    }
+
+    unique_ptr<base_pattern> search;
+    if (lua_text_pattern::is_lua_pattern(csearch))
+        search.reset(new lua_text_pattern(csearch));
+    else if (csearch[0] != '='
+             && (csearch == "." || csearch == ".." || csearch[0] == '/'
+                 || Options.regex_search))
+    {
+        if (csearch[0] == '/')
+            csearch.erase(0, 1);
+        search.reset(new text_pattern(csearch, true));
+    }
+    else
+    {
+        if (csearch[0] == '=')
+            csearch.erase(0, 1);
+        search.reset(new plaintext_pattern(csearch, true));
+    }
+
+    if (!search->valid() && csearch != "*")
+        search.reset();
+    return search;
+}
+
+vector<stash_search_result> StashTracker::find_matches(
+    const string &search_term)
+{
+    vector<stash_search_result> results;
+    if (search_term.empty())
+        return results;
+
+    update_corpses();
+    update_identification();
+
+    string csearch = search_term;
+    bool curr_lev;
+    unique_ptr<base_pattern> search = _stash_search_pattern(csearch, curr_lev);
+    if (!search)
+        return results;
+
+    if (!curr_lev)
+        results = _inventory_search(*search);
+    get_matching_stashes(*search, results, curr_lev
+                                           || crawl_state.game_is_descent());
+    return results;
+}
+
 void StashTracker::search_stashes(string search_term)
 {
     char buf[400];
@@ -1397,40 +1682,9 @@ void StashTracker::search_stashes(string search_term)
     string csearch_literal = search_term.empty() ? (*buf? buf : lastsearch) : search_term;
     string csearch = csearch_literal;
 
-    bool curr_lev = (csearch[0] == '@' || csearch == ".");
-    if (curr_lev)
-    {
-        csearch.erase(0, 1);
-        if (csearch.length() == 0)
-            csearch = ".";
-    }
-
-    base_pattern *search = nullptr;
-
-    lua_text_pattern ltpat(csearch);
-    text_pattern tpat(csearch, true);
-    plaintext_pattern ptpat(csearch, true);
-
-    if (lua_text_pattern::is_lua_pattern(csearch))
-        search = &ltpat;
-    else if (csearch[0] != '='
-             && (csearch == "." || csearch == ".." || csearch[0] == '/'
-                 || Options.regex_search))
-    {
-        if (csearch[0] == '/')
-            csearch.erase(0, 1);
-        tpat = csearch;
-        search = &tpat;
-    }
-    else
-    {
-        if (csearch[0] == '=')
-            csearch.erase(0, 1);
-        ptpat = csearch;
-        search = &ptpat;
-    }
-
-    if (!search->valid() && csearch != "*")
+    bool curr_lev;
+    unique_ptr<base_pattern> search = _stash_search_pattern(csearch, curr_lev);
+    if (!search)
     {
         mprf(MSGCH_PLAIN, "Your search expression is invalid.");
         return ;
@@ -1480,7 +1734,7 @@ void StashTracker::search_stashes(string search_term)
                                            sort_by_dist,
                                            filter_useless,
                                            default_execute,
-                                           search,
+                                           search.get(),
                                            csearch == "."
                                            || csearch == "..",
                                            results.size());
@@ -1491,7 +1745,7 @@ void StashTracker::search_stashes(string search_term)
                                            sort_by_dist,
                                            filter_useless,
                                            default_execute,
-                                           search,
+                                           search.get(),
                                            csearch == "."
                                            || csearch == "..",
                                            dedup_results.size());
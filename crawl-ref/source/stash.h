@@ -7,6 +7,7 @@
 
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "shopping.h"
@@ -27,7 +28,8 @@ public:
     static bool is_boring_feature(dungeon_feature_type feat);
 
     static string stash_item_name(const item_def &item);
-    void update();
+    // Returns true if anything the stash tracker knows about changed.
+    bool update();
     bool unmark_trapping_nets();
     void save(writer&) const;
     void load(reader&);
@@ -61,10 +63,22 @@ public:
     bool is_visited() const {  return visited; }
 
 private:
-    void _update_corpses(int rot_time);
-    void _update_identification();
+    bool _update_corpses(int rot_time);
+    bool _update_identification();
     void add_item(item_def &item, bool add_to_front = false);
 
+    struct item_search_text
+    {
+        string name;     // stash_item_name()
+        string haystack; // annotations, name and artefact description
+        size_t autopickup_at; // where the {autopickup} tag would go
+
+        string with_autopickup() const;
+    };
+    void _fill_search_cache() const;
+    void _add_search_trigrams(const string &prefix,
+                              vector<uint32_t> &trigrams) const;
+
 private:
     bool visited;      // Is this correct to the best of our knowledge?
     coord_def pos;
@@ -74,6 +88,11 @@ private:
 
     vector<item_def> items;
 
+    // Search text for each item, built on demand. Cleared whenever the items
+    // change, and rebuilt when item_name_generation() moves on.
+    mutable vector<item_search_text> search_cache;
+    mutable unsigned int search_cache_generation;
+
     static bool are_items_same(const item_def &, const item_def &,
                                bool exact = false);
 
@@ -218,6 +237,9 @@ private:
     void _update_corpses(int rot_time);
     void _update_identification();
     void _waypoint_search(int n, vector<stash_search_result> &results) const;
+    void _build_search_index() const;
+    bool _search_candidates(const string &needle,
+                            vector<coord_def> &candidates) const;
 
     typedef map<coord_def, Stash> stashes_t;
     typedef vector<ShopInfo> shops_t;
@@ -227,6 +249,14 @@ private:
     stashes_t m_stashes;
     shops_t m_shops;
 
+    // Trigram index over the lowercased search text of m_stashes, used to
+    // narrow down plain-text searches. Maps each trigram to the (sorted)
+    // indices into m_search_stashes of the stashes containing it.
+    mutable unordered_map<uint32_t, vector<int>> m_search_index;
+    mutable vector<coord_def> m_search_stashes;
+    mutable bool m_search_index_valid;
+    mutable unsigned int m_search_index_generation;
+
     friend class StashTracker;
     friend class ST_ItemIterator;
 };
@@ -239,6 +269,9 @@ public:
     }
 
     void search_stashes(string search_term = "");
+    // The results search_stashes() would show for search_term, before any
+    // deduplication or filtering.
+    vector<stash_search_result> find_matches(const string &search_term);
 
     LevelStashes &get_current_level();
     LevelStashes *find_current_level();
@@ -338,7 +371,8 @@ void describe_stash(const coord_def& c);
 vector<item_def> item_list_in_stash(const coord_def& pos);
 
 string userdef_annotate_item(const char *s, const item_def *item);
-string stash_annotate_item(const char *s, const item_def *item);
+string stash_annotate_item(const char *s, const item_def *item,
+                           bool autopickup = true);
 
 #define STASH_LUA_SEARCH_ANNOTATE "ch_stash_search_annotate_item"
 #define STASH_LUA_DUMP_ANNOTATE   "ch_stash_dump_annotate_item"
@@ -53,7 +53,8 @@ game_state::game_state()
       bypassed_startup_menu(false),
 #endif
       clua_max_memory_mb(16), show_more_prompt(true),
-      skip_autofight_check(false), terminal_resize_handler(nullptr),
+      skip_autofight_check(false), arena_jobs(0),
+      terminal_resize_handler(nullptr),
       terminal_resize_check(nullptr), doing_prev_cmd_again(false),
       prev_cmd(CMD_NO_CMD), repeat_cmd(CMD_NO_CMD),
       cmd_repeat_started_unsafe(false),
@@ -109,6 +109,9 @@ struct game_state
 
     string map;             // Map selected in the newgame menu
 
+    string arena_batch;     // Matchup file for a batch arena run, if any.
+    int arena_jobs;         // Worker processes for it; 0 for one per CPU.
+
     void (*terminal_resize_handler)();
     void (*terminal_resize_check)();
 
@@ -200,8 +200,10 @@ string wordwrap_line(string &s, int width, bool tags, bool indent, int force_ind
             ASSERT(cw == 1);
             if (cp[1] == '<') // "<<" escape
             {
-                // Note: this must be after a possible wrap, otherwise we could
-                // split the escape between lines.
+                // Wrap before skipping the first '<', or the escape would be
+                // split between lines.
+                if (cw > width)
+                    break;
                 cp++;
             }
             else
@@ -22,9 +22,15 @@
 # include <sys/types.h>
 # include <sys/stat.h>
 #endif
+#ifdef UNIX
+# include <cerrno>
+# include <poll.h>
+# include <sys/wait.h>
+#endif
 
 #include "files.h"
 #include "random.h"
+#include "stringutil.h"
 #include "unicode.h"
 
 #ifdef __ANDROID__
@@ -558,3 +564,136 @@ int open_u(const char *pathname, int flags, mode_t mode)
     return open(OUTS(pathname), flags, mode);
 #endif
 }
+
+#ifdef UNIX
+// Writes all of s to fd, or returns false.
+static bool _write_all(int fd, const string &s)
+{
+    size_t done = 0;
+    while (done < s.size())
+    {
+        const ssize_t wrote = write(fd, s.data() + done, s.size() - done);
+        if (wrote < 0 && errno == EINTR)
+            continue;
+        if (wrote <= 0)
+            return false;
+        done += wrote;
+    }
+    return true;
+}
+
+/**
+ * Run fn(0) ... fn(jobs - 1), each in its own forked worker process, with at
+ * most the given number running at once (or one per CPU, if that's not
+ * positive). Workers start from a copy of the process as it is now, so
+ * nothing they do affects the caller or each other.
+ *
+ * @param[out] error Set to why not every job could be run, if that
+ *                   happened; any workers already started are still waited
+ *                   for first. Left alone otherwise.
+ * @return What fn returned for each job, or an empty string for a job whose
+ *         worker failed or wasn't started.
+ */
+vector<string> run_in_workers(int workers, size_t jobs,
+                              const function<string(size_t)> &fn,
+                              string &error)
+{
+    if (workers <= 0)
+        workers = max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+
+    struct worker
+    {
+        pid_t pid;
+        size_t job;
+        int fd;
+        string output;
+    };
+    vector<worker> running;
+    vector<string> results(jobs);
+    size_t next = 0;
+    string failure;
+
+    while (true)
+    {
+        while (failure.empty() && next < jobs && (int)running.size() < workers)
+        {
+            int fds[2];
+            if (pipe(fds) != 0)
+            {
+                failure = make_stringf("Can't create a pipe: %s",
+                                       strerror(errno));
+                break;
+            }
+
+            const pid_t pid = fork();
+            if (pid == 0)
+            {
+                close(fds[0]);
+                const bool ok = _write_all(fds[1], fn(next));
+                _exit(ok ? 0 : 1);
+            }
+
+            close(fds[1]);
+            if (pid < 0)
+            {
+                close(fds[0]);
+                failure = make_stringf("Can't start a worker: %s",
+                                       strerror(errno));
+                break;
+            }
+            running.push_back({pid, next++, fds[0], ""});
+        }
+
+        if (running.empty())
+            break;
+
+        // Read output as it comes, so that workers never block on a full
+        // pipe; a worker is done once its end of the pipe closes.
+        vector<pollfd> polls;
+        for (const worker &w : running)
+            polls.push_back({w.fd, POLLIN, 0});
+        if (poll(&polls[0], polls.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            failure = make_stringf("Can't wait for the workers: %s",
+                                   strerror(errno));
+            // Closing the pipes makes any worker still writing give up.
+            for (worker &w : running)
+                close(w.fd);
+            for (worker &w : running)
+                while (waitpid(w.pid, nullptr, 0) < 0 && errno == EINTR)
+                    ;
+            break;
+        }
+
+        for (size_t i = running.size(); i-- > 0; )
+        {
+            if (!polls[i].revents)
+                continue;
+            worker &w = running[i];
+            char buf[4096];
+            const ssize_t got = read(w.fd, buf, sizeof(buf));
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got > 0)
+            {
+                w.output.append(buf, got);
+                continue;
+            }
+
+            close(w.fd);
+            int status = 0;
+            while (waitpid(w.pid, &status, 0) < 0 && errno == EINTR)
+                ;
+            if (got == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+                results[w.job] = w.output;
+            running.erase(running.begin() + i);
+        }
+    }
+
+    if (!failure.empty())
+        error = failure;
+    return results;
+}
+#endif
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <functional>
 #include <sys/types.h>
 
 #include "config.h"
@@ -40,3 +41,9 @@ int unlink_u(const char *pathname);
 FILE *fopen_u(const char *path, const char *mode);
 int mkdir_u(const char *pathname, mode_t mode);
 int open_u(const char *pathname, int flags, mode_t mode);
+
+#ifdef UNIX
+vector<string> run_in_workers(int workers, size_t jobs,
+                              const function<string(size_t)> &fn,
+                              string &error);
+#endif
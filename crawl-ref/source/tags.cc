@@ -116,9 +116,13 @@ extern set<pair<string, level_id> > auto_unique_annotations;
 // defined in abyss.cc
 extern abyss_state abyssal_state;
 
+// Size of the buffers between readers/writers and save chunks. Each call into
+// the chunk goes through zlib, so we want as few as possible.
+static const size_t CHUNK_BUFFER_SIZE = 64 * 1024;
+
 reader::reader(const string &_read_filename, int minorVersion)
     : _filename(_read_filename), _chunk(0), _pbuf(nullptr), _read_offset(0),
-      _minorVersion(minorVersion), _safe_read(false)
+      _buf_pos(0), _buf_len(0), _minorVersion(minorVersion), _safe_read(false)
 {
     _file       = fopen_u(_filename.c_str(), "rb");
     opened_file = !!_file;
@@ -126,7 +130,8 @@ reader::reader(const string &_read_filename, int minorVersion)
 
 reader::reader(package *save, const string &chunkname, int minorVersion)
     : _file(0), _chunk(0), opened_file(false), _pbuf(0), _read_offset(0),
-     _minorVersion(minorVersion), _safe_read(false)
+      _buf(CHUNK_BUFFER_SIZE), _buf_pos(0), _buf_len(0),
+      _minorVersion(minorVersion), _safe_read(false)
 {
     ASSERT(save);
     _chunk = new chunk_reader(save, chunkname);
@@ -173,6 +178,15 @@ static NORETURN void _short_read(bool safe_read)
     die_noline("short read while reading save");
 }
 
+// Refill the (empty) chunk buffer, returning how much was read.
+size_t reader::fill_chunk_buffer()
+{
+    ASSERT(_buf_pos == _buf_len);
+    _buf_pos = 0;
+    _buf_len = _chunk->read(_buf.data(), _buf.size());
+    return _buf_len;
+}
+
 // Reads input in network byte order, from a file or buffer.
 unsigned char reader::readByte()
 {
@@ -185,10 +199,9 @@ unsigned char reader::readByte()
     }
     else if (_chunk)
     {
-        unsigned char buf;
-        if (_chunk->read(&buf, 1) != 1)
+        if (_buf_pos == _buf_len && !fill_chunk_buffer())
             _short_read(_safe_read);
-        return buf;
+        return _buf[_buf_pos++];
     }
     else
     {
@@ -212,8 +225,27 @@ void reader::read(void *data, size_t size)
     }
     else if (_chunk)
     {
-        if (_chunk->read(data, size) != size)
-            _short_read(_safe_read);
+        unsigned char *out = static_cast<unsigned char *>(data);
+        while (size)
+        {
+            if (_buf_pos == _buf_len)
+            {
+                // Big reads skip the buffer.
+                if (size >= _buf.size())
+                {
+                    if (_chunk->read(out, size) != size)
+                        _short_read(_safe_read);
+                    return;
+                }
+                if (!fill_chunk_buffer())
+                    _short_read(_safe_read);
+            }
+            const size_t len = min(size, _buf_len - _buf_pos);
+            memcpy(out, _buf.data() + _buf_pos, len);
+            _buf_pos += len;
+            out += len;
+            size -= len;
+        }
     }
     else
     {
@@ -240,7 +272,7 @@ void reader::setMinorVersion(int minorVersion)
 void reader::fail_if_not_eof(const string &name)
 {
     char dummy;
-    if (_chunk ? _chunk->read(&dummy, 1) :
+    if (_chunk ? _buf_pos < _buf_len || _chunk->read(&dummy, 1) :
         _file ? (fgetc(_file) != EOF) :
         _read_offset >= _pbuf->size())
     {
@@ -258,13 +290,41 @@ void writer::check_ok(bool ok)
     }
 }
 
+writer::writer(package *save, const string &chunkname)
+    : _filename(), _file(0), _chunk(0), _ignore_errors(false), _pbuf(0),
+      _buf(CHUNK_BUFFER_SIZE), _buf_used(0), failed(false)
+{
+    ASSERT(save);
+    _chunk = save->writer(chunkname);
+}
+
+writer::~writer()
+{
+    if (_chunk)
+    {
+        flush_chunk();
+        delete _chunk;
+    }
+}
+
+void writer::flush_chunk()
+{
+    if (_buf_used)
+        _chunk->write(_buf.data(), _buf_used);
+    _buf_used = 0;
+}
+
 void writer::writeByte(unsigned char ch)
 {
     if (failed)
         return;
 
     if (_chunk)
-        _chunk->write(&ch, 1);
+    {
+        if (_buf_used == _buf.size())
+            flush_chunk();
+        _buf[_buf_used++] = ch;
+    }
     else if (_file)
         check_ok(fputc(ch, _file) != EOF);
     else
@@ -277,7 +337,20 @@ void writer::write(const void *data, size_t size)
         return;
 
     if (_chunk)
-        _chunk->write(data, size);
+    {
+        if (_buf_used + size > _buf.size())
+        {
+            flush_chunk();
+            // Big writes skip the buffer.
+            if (size >= _buf.size())
+            {
+                _chunk->write(data, size);
+                return;
+            }
+        }
+        memcpy(_buf.data() + _buf_used, data, size);
+        _buf_used += size;
+    }
     else if (_file)
         check_ok(fwrite(data, 1, size, _file) == size);
     else
@@ -343,6 +416,8 @@ static void _marshallSpells(writer &, const monster_spells &);
 
 static void _marshallMonsterInfo (writer &, const monster_info &);
 static void _unmarshallMonsterInfo (reader &, monster_info &mi);
+static void _marshall_map_knowledge(writer &th, const MapKnowledge &map);
+static void _unmarshall_map_knowledge(reader &th, MapKnowledge &map);
 
 template<typename T, typename T_iter, typename T_marshal>
 static void _marshall_iterator(writer &th, T_iter beg, T_iter end,
@@ -832,6 +907,79 @@ static void _run_length_decode(reader &th, unmarshall um, grid &g,
     }
 }
 
+// Level planes: one value per cell of the level, column by column, as
+// (run length, value) pairs. Unlike _run_length_encode, runs and values
+// are varints, so runs can span whole columns and wide values such as
+// pgrid flags stay small.
+template <typename get_value>
+static void _marshall_plane(writer &th, get_value get)
+{
+    int64_t last = 0;
+    unsigned int run = 0;
+    for (int x = 0; x < GXM; ++x)
+        for (int y = 0; y < GYM; ++y)
+        {
+            const int64_t value = get(coord_def(x, y));
+            if (run && value == last)
+            {
+                ++run;
+                continue;
+            }
+            if (run)
+            {
+                marshallUnsigned(th, run);
+                marshallSigned(th, last);
+            }
+            last = value;
+            run = 1;
+        }
+
+    marshallUnsigned(th, run);
+    marshallSigned(th, last);
+}
+
+template <typename set_value>
+static void _unmarshall_plane(reader &th, set_value set)
+{
+    const int end = GXM * GYM;
+    int offset = 0;
+    while (offset < end)
+    {
+        const int run = unmarshallUnsigned(th);
+        const int64_t value = unmarshallSigned(th);
+        ASSERT(run > 0 && run <= end - offset);
+
+        for (int i = 0; i < run; ++i, ++offset)
+            set(coord_def(offset / GYM, offset % GYM), value);
+    }
+}
+
+// As above, but each cell stored as the difference from the one before it,
+// for smoothly varying planes like the heightmap.
+template <typename get_value>
+static void _marshall_delta_plane(writer &th, get_value get)
+{
+    int64_t prev = 0;
+    _marshall_plane(th, [&](const coord_def &c)
+    {
+        const int64_t value = get(c);
+        const int64_t delta = value - prev;
+        prev = value;
+        return delta;
+    });
+}
+
+template <typename set_value>
+static void _unmarshall_delta_plane(reader &th, set_value set)
+{
+    int64_t prev = 0;
+    _unmarshall_plane(th, [&](const coord_def &c, int64_t delta)
+    {
+        prev += delta;
+        set(c, prev);
+    });
+}
+
 union float_marshall_kludge
 {
     float    f_num;
@@ -4891,6 +5039,7 @@ static void _tag_read_you_items(reader &th)
         for (int j = count2; j < MAX_SUBTYPES; ++j)
             you.type_ids[i][j] = false;
     }
+    invalidate_item_names();
 
 #if TAG_MAJOR_VERSION == 34
     if (th.getMinorVersion() < TAG_MINOR_ID_STATES)
@@ -5433,19 +5582,15 @@ static void _tag_construct_level(writer &th)
 
     CANARY;
 
-    for (int count_x = 0; count_x < GXM; count_x++)
-        for (int count_y = 0; count_y < GYM; count_y++)
-        {
-            marshallByte(th, env.grid[count_x][count_y]);
-            marshallMapCell(th, env.map_knowledge[count_x][count_y]);
-            marshallInt(th, env.pgrid[count_x][count_y].flags);
-        }
+    // Each grid is saved a plane at a time, so that the long runs of rock,
+    // floor and unseen cells compress to almost nothing.
+    _marshall_plane(th, [](const coord_def &c) { return env.grid(c); });
+    _marshall_plane(th, [](const coord_def &c) { return env.pgrid(c).flags; });
+    _marshall_map_knowledge(th, env.map_knowledge);
 
     marshallBoolean(th, !!env.map_forgotten);
     if (env.map_forgotten)
-        for (int x = 0; x < GXM; x++)
-            for (int y = 0; y < GYM; y++)
-                marshallMapCell(th, (*env.map_forgotten)[x][y]);
+        _marshall_map_knowledge(th, *env.map_forgotten);
 
     _run_length_encode(th, marshallByte, env.grid_colours, GXM, GYM);
 
@@ -5490,9 +5635,9 @@ static void _tag_construct_level(writer &th)
     marshallByte(th, !!env.heightmap);
     if (env.heightmap)
     {
-        grid_heightmap &heightmap(*env.heightmap);
-        for (rectangle_iterator ri(0); ri; ++ri)
-            marshallShort(th, heightmap(*ri));
+        const grid_heightmap &heightmap(*env.heightmap);
+        _marshall_delta_plane(th, [&](const coord_def &c)
+                                  { return heightmap(c); });
     }
 
     CANARY;
@@ -6207,6 +6352,76 @@ void unmarshallItem(reader &th, item_def &item)
 #define MAP_SERIALIZE_CLOUD 0x20
 #define MAP_SERIALIZE_MONSTER 0x40
 
+// Which of a cell's remembered cloud, item and monster are present, as
+// MAP_SERIALIZE_* flags.
+static unsigned _map_cell_contents(const map_cell &cell)
+{
+    unsigned contents = 0;
+
+    if (cell.cloud() != CLOUD_NONE)
+        contents |= MAP_SERIALIZE_CLOUD;
+
+    if (cell.item())
+        contents |= MAP_SERIALIZE_ITEM;
+
+    if (cell.monster() != MONS_NO_MONSTER)
+        contents |= MAP_SERIALIZE_MONSTER;
+
+    return contents;
+}
+
+static void _marshall_map_cell_contents(writer &th, const map_cell &cell,
+                                        unsigned contents)
+{
+    if (contents & MAP_SERIALIZE_CLOUD)
+    {
+        cloud_info* ci = cell.cloudinfo();
+        marshallUnsigned(th, ci->type);
+        marshallUnsigned(th, ci->colour);
+        marshallUnsigned(th, ci->duration);
+        marshallShort(th, ci->tile);
+        marshallUByte(th, ci->killer);
+    }
+
+    if (contents & MAP_SERIALIZE_ITEM)
+        marshallItem(th, *cell.item(), true);
+
+    if (contents & MAP_SERIALIZE_MONSTER)
+        _marshallMonsterInfo(th, *cell.monsterinfo());
+}
+
+static void _unmarshall_map_cell_contents(reader &th, map_cell &cell,
+                                          unsigned contents)
+{
+    if (contents & MAP_SERIALIZE_CLOUD)
+    {
+        cloud_info ci;
+        ci.type = (cloud_type)unmarshallUnsigned(th);
+        unmarshallUnsigned(th, ci.colour);
+        unmarshallUnsigned(th, ci.duration);
+        ci.tile = unmarshallShort(th);
+#if TAG_MAJOR_VERSION == 34
+        if (th.getMinorVersion() >= TAG_MINOR_CLOUD_OWNER)
+#endif
+        ci.killer = static_cast<killer_type>(unmarshallUByte(th));
+        cell.set_cloud(ci);
+    }
+
+    if (contents & MAP_SERIALIZE_ITEM)
+    {
+        item_def item;
+        unmarshallItem(th, item);
+        cell.set_item(item, false);
+    }
+
+    if (contents & MAP_SERIALIZE_MONSTER)
+    {
+        monster_info mi;
+        _unmarshallMonsterInfo(th, mi);
+        cell.set_monster(mi);
+    }
+}
+
 void marshallMapCell(writer &th, const map_cell &cell)
 {
     unsigned flags = 0;
@@ -6224,14 +6439,7 @@ void marshallMapCell(writer &th, const map_cell &cell)
     if (cell.feat_colour())
         flags |= MAP_SERIALIZE_FEATURE_COLOUR;
 
-    if (cell.cloud() != CLOUD_NONE)
-        flags |= MAP_SERIALIZE_CLOUD;
-
-    if (cell.item())
-        flags |= MAP_SERIALIZE_ITEM;
-
-    if (cell.monster() != MONS_NO_MONSTER)
-        flags |= MAP_SERIALIZE_MONSTER;
+    flags |= _map_cell_contents(cell);
 
     marshallUnsigned(th, flags);
 
@@ -6261,21 +6469,7 @@ void marshallMapCell(writer &th, const map_cell &cell)
     if (feat_is_trap(cell.feat()))
         marshallByte(th, cell.trap());
 
-    if (flags & MAP_SERIALIZE_CLOUD)
-    {
-        cloud_info* ci = cell.cloudinfo();
-        marshallUnsigned(th, ci->type);
-        marshallUnsigned(th, ci->colour);
-        marshallUnsigned(th, ci->duration);
-        marshallShort(th, ci->tile);
-        marshallUByte(th, ci->killer);
-    }
-
-    if (flags & MAP_SERIALIZE_ITEM)
-        marshallItem(th, *cell.item(), true);
-
-    if (flags & MAP_SERIALIZE_MONSTER)
-        _marshallMonsterInfo(th, *cell.monsterinfo());
+    _marshall_map_cell_contents(th, cell, flags);
 }
 
 void unmarshallMapCell(reader &th, map_cell& cell)
@@ -6329,36 +6523,72 @@ void unmarshallMapCell(reader &th, map_cell& cell)
 
     cell.set_feature(feature, feat_colour, trap);
 
-    if (flags & MAP_SERIALIZE_CLOUD)
+    _unmarshall_map_cell_contents(th, cell, flags);
+
+    // set this last so the other sets don't override this
+    cell.flags = cell_flags;
+}
+
+// The plane-at-a-time form of marshallMapCell for a whole map: remembered
+// features, their colours and the cell flags as planes, then the few cells
+// with a trap, cloud, item or monster as a sparse list.
+static void _marshall_map_knowledge(writer &th, const MapKnowledge &map)
+{
+    _marshall_plane(th, [&](const coord_def &c) { return map(c).feat(); });
+    _marshall_plane(th, [&](const coord_def &c)
+                        { return map(c).feat_colour(); });
+
+    vector<coord_def> occupied;
+    for (rectangle_iterator ri(0); ri; ++ri)
+        if (feat_is_trap(map(*ri).feat()) || _map_cell_contents(map(*ri)))
+            occupied.push_back(*ri);
+
+    marshallUnsigned(th, occupied.size());
+    for (const coord_def &c : occupied)
     {
-        cloud_info ci;
-        ci.type = (cloud_type)unmarshallUnsigned(th);
-        unmarshallUnsigned(th, ci.colour);
-        unmarshallUnsigned(th, ci.duration);
-        ci.tile = unmarshallShort(th);
-#if TAG_MAJOR_VERSION == 34
-        if (th.getMinorVersion() >= TAG_MINOR_CLOUD_OWNER)
-#endif
-        ci.killer = static_cast<killer_type>(unmarshallUByte(th));
-        cell.set_cloud(ci);
+        const map_cell &cell = map(c);
+        const unsigned contents = _map_cell_contents(cell);
+        marshallCoord(th, c);
+        marshallUnsigned(th, contents);
+        if (feat_is_trap(cell.feat()))
+            marshallByte(th, cell.trap());
+        _marshall_map_cell_contents(th, cell, contents);
     }
 
-    if (flags & MAP_SERIALIZE_ITEM)
+    _marshall_plane(th, [&](const coord_def &c) { return map(c).flags; });
+}
+
+static void _unmarshall_map_knowledge(reader &th, MapKnowledge &map)
+{
+    for (rectangle_iterator ri(0); ri; ++ri)
+        map(*ri).clear();
+
+    _unmarshall_plane(th, [&](const coord_def &c, int64_t value)
     {
-        item_def item;
-        unmarshallItem(th, item);
-        cell.set_item(item, false);
-    }
+        ASSERT(value >= 0 && value < NUM_FEATURES);
+        map(c).set_feature(static_cast<dungeon_feature_type>(value));
+    });
+    _unmarshall_plane(th, [&](const coord_def &c, int64_t value)
+                          { map(c).set_feature(map(c).feat(), value); });
 
-    if (flags & MAP_SERIALIZE_MONSTER)
+    const unsigned int occupied = unmarshallUnsigned(th);
+    for (unsigned int i = 0; i < occupied; ++i)
     {
-        monster_info mi;
-        _unmarshallMonsterInfo(th, mi);
-        cell.set_monster(mi);
+        const coord_def c = unmarshallCoord(th);
+        ASSERT_IN_BOUNDS(c);
+        map_cell &cell = map(c);
+        const unsigned contents = unmarshallUnsigned(th);
+        if (feat_is_trap(cell.feat()))
+        {
+            const trap_type trap = static_cast<trap_type>(unmarshallByte(th));
+            cell.set_feature(cell.feat(), cell.feat_colour(), trap);
+        }
+        _unmarshall_map_cell_contents(th, cell, contents);
     }
 
     // set this last so the other sets don't override this
-    cell.flags = cell_flags;
+    _unmarshall_plane(th, [&](const coord_def &c, int64_t value)
+                          { map(c).flags = value; });
 }
 
 static void _tag_construct_level_items(writer &th)
@@ -6995,36 +7225,57 @@ static void _tag_read_level(reader &th)
 
     EAT_CANARY;
 
-    env.map_seen.reset();
 #if TAG_MAJOR_VERSION == 34
-    vector<coord_def> transporters;
+    if (th.getMinorVersion() < TAG_MINOR_LEVEL_PLANES)
+    {
+        for (int i = 0; i < gx; i++)
+            for (int j = 0; j < gy; j++)
+            {
+                dungeon_feature_type feat = unmarshallFeatureType(th);
+                env.grid[i][j] = feat;
+                ASSERT(feat < NUM_FEATURES);
+
+                unmarshallMapCell(th, env.map_knowledge[i][j]);
+                env.pgrid[i][j].flags = unmarshallInt(th);
+            }
+    }
+    else
 #endif
-    for (int i = 0; i < gx; i++)
-        for (int j = 0; j < gy; j++)
+    {
+        _unmarshall_plane(th, [](const coord_def &c, int64_t value)
         {
-            dungeon_feature_type feat = unmarshallFeatureType(th);
-            env.grid[i][j] = feat;
-            ASSERT(feat < NUM_FEATURES);
+            ASSERT(value >= 0 && value < NUM_FEATURES);
+            env.grid(c) = static_cast<dungeon_feature_type>(value);
+        });
+        _unmarshall_plane(th, [](const coord_def &c, int64_t value)
+                              { env.pgrid(c).flags = value; });
+        _unmarshall_map_knowledge(th, env.map_knowledge);
+    }
 
+    env.map_seen.reset();
 #if TAG_MAJOR_VERSION == 34
-            // Save these for potential destination clean up.
-            if (env.grid[i][j] == DNGN_TRANSPORTER)
-                transporters.push_back(coord_def(i, j));
+    vector<coord_def> transporters;
+#endif
+    for (rectangle_iterator ri(0); ri; ++ri)
+    {
+#if TAG_MAJOR_VERSION == 34
+        // Save these for potential destination clean up.
+        if (env.grid(*ri) == DNGN_TRANSPORTER)
+            transporters.push_back(*ri);
 #endif
-            unmarshallMapCell(th, env.map_knowledge[i][j]);
-            // Fixup positions
-            if (env.map_knowledge[i][j].monsterinfo())
-                env.map_knowledge[i][j].monsterinfo()->pos = coord_def(i, j);
-            if (env.map_knowledge[i][j].cloudinfo())
-                env.map_knowledge[i][j].cloudinfo()->pos = coord_def(i, j);
+        map_cell &cell = env.map_knowledge(*ri);
+        // Fixup positions
+        if (cell.monsterinfo())
+            cell.monsterinfo()->pos = *ri;
+        if (cell.cloudinfo())
+            cell.cloudinfo()->pos = *ri;
 
-            env.map_knowledge[i][j].flags &= ~MAP_VISIBLE_FLAG;
-            if (env.map_knowledge[i][j].seen())
-                env.map_seen.set(i, j);
-            env.pgrid[i][j].flags = unmarshallInt(th);
+        cell.flags &= ~MAP_VISIBLE_FLAG;
+        if (cell.seen())
+            env.map_seen.set(*ri);
 
-            env.mgrid[i][j] = NON_MONSTER;
-        }
+        env.mgrid(*ri) = NON_MONSTER;
+    }
 
 #if TAG_MAJOR_VERSION == 34
     if (th.getMinorVersion() < TAG_MINOR_FORGOTTEN_MAP)
@@ -7034,9 +7285,16 @@ static void _tag_read_level(reader &th)
     if (unmarshallBoolean(th))
     {
         MapKnowledge *f = new MapKnowledge();
-        for (int x = 0; x < GXM; x++)
-            for (int y = 0; y < GYM; y++)
-                unmarshallMapCell(th, (*f)[x][y]);
+#if TAG_MAJOR_VERSION == 34
+        if (th.getMinorVersion() < TAG_MINOR_LEVEL_PLANES)
+        {
+            for (int x = 0; x < GXM; x++)
+                for (int y = 0; y < GYM; y++)
+                    unmarshallMapCell(th, (*f)[x][y]);
+        }
+        else
+#endif
+        _unmarshall_map_knowledge(th, *f);
         env.map_forgotten.reset(f);
     }
     else
@@ -7214,8 +7472,16 @@ static void _tag_read_level(reader &th)
     {
         env.heightmap.reset(new grid_heightmap);
         grid_heightmap &heightmap(*env.heightmap);
-        for (rectangle_iterator ri(0); ri; ++ri)
-            heightmap(*ri) = unmarshallShort(th);
+#if TAG_MAJOR_VERSION == 34
+        if (th.getMinorVersion() < TAG_MINOR_LEVEL_PLANES)
+        {
+            for (rectangle_iterator ri(0); ri; ++ri)
+                heightmap(*ri) = unmarshallShort(th);
+        }
+        else
+#endif
+        _unmarshall_delta_plane(th, [&](const coord_def &c, int64_t value)
+                                    { heightmap(c) = value; });
     }
 
     EAT_CANARY;
@@ -7892,10 +8158,12 @@ static void _tag_read_level_monsters(reader &th)
     ASSERT_RANGE(count, 0, MAX_MONSTERS + 1);
 
     env.max_mon_index = max(0, count - 1);
+    env.mon_slots.clear();
     for (int i = 0; i < count; i++)
     {
         monster& m = env.mons[i];
         unmarshallMonster(th, m);
+        env.mon_slots.push_back(i);
 
         // place monster
         if (!m.alive())
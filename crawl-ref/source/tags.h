@@ -54,22 +54,16 @@ class writer
 public:
     writer(const string &filename, FILE* output, bool ignore_errors = false)
         : _filename(filename), _file(output), _chunk(0),
-          _ignore_errors(ignore_errors), _pbuf(0), failed(false)
+          _ignore_errors(ignore_errors), _pbuf(0), _buf_used(0), failed(false)
     {
         ASSERT(output);
     }
     writer(vector<unsigned char>* poutput)
         : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          _pbuf(poutput), failed(false) { ASSERT(poutput); }
-    writer(package *save, const string &chunkname)
-        : _filename(), _file(0), _chunk(0), _ignore_errors(false),
-          failed(false)
-    {
-        ASSERT(save);
-        _chunk = save->writer(chunkname);
-    }
+          _pbuf(poutput), _buf_used(0), failed(false) { ASSERT(poutput); }
+    writer(package *save, const string &chunkname);
 
-    ~writer() { if (_chunk) delete _chunk; }
+    ~writer();
 
     void writeByte(unsigned char byte);
     void write(const void *data, size_t size);
@@ -79,6 +73,7 @@ public:
 
 private:
     void check_ok(bool ok);
+    void flush_chunk();
 
 private:
     string _filename;
@@ -88,6 +83,11 @@ private:
 
     vector<unsigned char>* _pbuf;
 
+    // Writes to a chunk are collected here and passed to the compressor in
+    // large blocks, rather than a byte at a time.
+    vector<unsigned char> _buf;
+    size_t _buf_used;
+
     bool failed;
 };
 
@@ -116,11 +116,13 @@ public:
     reader(const string &filename, int minorVersion = TAG_MINOR_INVALID);
     reader(FILE* input, int minorVersion = TAG_MINOR_INVALID)
         : _file(input), _chunk(0), opened_file(false), _pbuf(0),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+          _read_offset(0), _buf_pos(0), _buf_len(0),
+          _minorVersion(minorVersion), _safe_read(false) {}
     reader(const vector<unsigned char>& input,
            int minorVersion = TAG_MINOR_INVALID)
         : _file(0), _chunk(0), opened_file(false), _pbuf(&input),
-          _read_offset(0), _minorVersion(minorVersion), _safe_read(false) {}
+          _read_offset(0), _buf_pos(0), _buf_len(0),
+          _minorVersion(minorVersion), _safe_read(false) {}
     reader(package *save, const string &chunkname,
            int minorVersion = TAG_MINOR_INVALID);
     ~reader();
@@ -138,6 +140,9 @@ public:
 
     void set_safe_read(bool setting) { _safe_read = setting; }
 
+private:
+    size_t fill_chunk_buffer();
+
 private:
     string _filename;
     FILE* _file;
@@ -145,6 +150,10 @@ private:
     bool  opened_file;
     const vector<unsigned char>* _pbuf;
     unsigned int _read_offset;
+    // Chunks are decompressed into here in large blocks, rather than a byte
+    // at a time.
+    vector<unsigned char> _buf;
+    size_t _buf_pos, _buf_len;
     int _minorVersion;
     // always throw an exception rather than dying when reading past EOF
     bool _safe_read;
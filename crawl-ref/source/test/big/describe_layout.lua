@@ -0,0 +1,57 @@
+-----------------------------------------------------------------------
+-- Describe screen layout benchmark: wraps the full descriptions of some
+-- monsters with long descriptions, the way the describe popup lays them
+-- out, and reports the time per layout pass, both for a new widget each
+-- pass and for one widget laid out again and again (as when a popup is
+-- resized or relaid out around it).
+-----------------------------------------------------------------------
+
+local MONSTERS = { "Mnoleg", "Lernaean hydra", "Royal Jelly", "Boris",
+                   "draconian scorcher", "Sigmund", "orb of fire",
+                   "Serpent of Hell", "Tiamat", "Geryon" }
+-- A description is also stacked up this many times, for a few really big
+-- screens.
+local STACKED = 20
+-- The widths a popup asks for while it settles on its size.
+local WIDTHS = { 78, 70, 78, 60 }
+local PASSES = 200
+
+debug.goto_place("D:1")
+dgn.reset_level()
+dgn.fill_grd_area(1, 1, dgn.GXM - 2, dgn.GYM - 2, 'floor')
+dgn.dismiss_monsters()
+you.moveto(30, 30)
+crawl.redraw_view()
+
+local texts = { }
+for i, name in ipairs(MONSTERS) do
+  local dx, dy = (i - 1) % 5 + 1, math.floor((i - 1) / 5) + 1
+  dgn.create_monster(30 + dx, 30 + dy, "generate_awake " .. name)
+  local mi = monster.get_monster_at(dx, dy)
+  assert(mi, "couldn't see " .. name)
+  table.insert(texts, { name = name, text = mi:desc(true) })
+end
+dgn.dismiss_monsters()
+
+local all = { }
+for _ = 1, STACKED do
+  for _, t in ipairs(texts) do
+    table.insert(all, t.text)
+  end
+end
+table.insert(texts, { name = "all, stacked", text = table.concat(all, "\n\n") })
+
+local function time_layout(text, fresh)
+  local start = crawl.millis()
+  debug.layout_text(text, WIDTHS, PASSES, fresh)
+  return (crawl.millis() - start) / PASSES
+end
+
+for _, t in ipairs(texts) do
+  local heights = debug.layout_text(t.text, WIDTHS)
+  crawl.stderr(string.format("%-20s %6d bytes, %5d lines: "
+                             .. "%7.3f ms/pass new, %7.3f ms/pass again",
+                             t.name, #t.text, heights[1],
+                             time_layout(t.text, true),
+                             time_layout(t.text, false)))
+end
@@ -0,0 +1,40 @@
+-----------------------------------------------------------------------
+-- Level builder benchmark: builds a few hundred levels from fixed seeds
+-- and reports the time per build, and the time of the connectivity
+-- checks the builder runs after every vault, for each place.
+-----------------------------------------------------------------------
+
+local PLACES = { "D:2", "D:8", "D:14", "Lair:3", "Orc:2", "Elf:2",
+                 "Vaults:2", "Depths:3" }
+local SEEDS_PER_PLACE = 50
+local ZONE_COUNTS = 20
+
+local total_builds = 0
+local total_ms = 0
+
+for _, place in ipairs(PLACES) do
+  local build_ms = 0
+  local zone_ms = 0
+  for seed = 1, SEEDS_PER_PLACE do
+    debug.reset_rng(seed)
+    local start = crawl.millis()
+    test.regenerate_level(place)
+    build_ms = build_ms + crawl.millis() - start
+
+    start = crawl.millis()
+    for _ = 1, ZONE_COUNTS do
+      dgn.count_disconnected_zones()
+      dgn.count_tele_zones()
+    end
+    zone_ms = zone_ms + crawl.millis() - start
+  end
+
+  total_builds = total_builds + SEEDS_PER_PLACE
+  total_ms = total_ms + build_ms
+  crawl.stderr(string.format("%-10s %6.1f ms/build, %6.3f ms/zone count",
+                             place, build_ms / SEEDS_PER_PLACE,
+                             zone_ms / (SEEDS_PER_PLACE * ZONE_COUNTS * 2)))
+end
+
+crawl.stderr(string.format("%d builds in %d ms, %.1f ms/build",
+                           total_builds, total_ms, total_ms / total_builds))
@@ -0,0 +1,75 @@
+-----------------------------------------------------------------------
+-- Stash search benchmark: fills a number of levels with random items,
+-- records them all in the stash tracker and times searches over the lot.
+-- Also checks that indexed plain-text searches find exactly what the
+-- equivalent (unindexed) regex search finds.
+-----------------------------------------------------------------------
+
+local LEVELS = { "D:2", "D:4", "D:6", "D:8", "D:10", "D:12",
+                 "Lair:2", "Orc:1", "Elf:2", "Vaults:3" }
+local ITEMS_PER_LEVEL = 800
+local REPEATS = 20
+
+-- Plain words, so that "=term" and "/term" must agree.
+local TERMS = { "scroll", "potion of", "ring of", "mail", "artefact",
+                "two-handed", "gold", "xyzzy" }
+
+local function fill_level(place)
+  debug.goto_place(place)
+  dgn.reset_level()
+  dgn.fill_grd_area(1, 1, dgn.GXM - 2, dgn.GYM - 2, 'floor')
+
+  local placed = 0
+  while placed < ITEMS_PER_LEVEL do
+    local x = crawl.random_range(2, dgn.GXM - 3)
+    local y = crawl.random_range(2, dgn.GYM - 3)
+    dgn.create_item(x, y, "any")
+    placed = placed + 1
+  end
+  wiz.map_level()
+end
+
+local function same_results(a, b)
+  if #a ~= #b then
+    return false
+  end
+  for i = 1, #a do
+    if a[i] ~= b[i] then
+      return false
+    end
+  end
+  return true
+end
+
+local function time_search(term)
+  local start = crawl.millis()
+  local results
+  for _ = 1, REPEATS do
+    results = wiz.stash_search(term)
+  end
+  return results, (crawl.millis() - start) / REPEATS
+end
+
+for _, place in ipairs(LEVELS) do
+  fill_level(place)
+end
+
+for _, term in ipairs(TERMS) do
+  -- The first search builds the per-item text cache and the level indices.
+  local cold_start = crawl.millis()
+  local plain = wiz.stash_search("=" .. term)
+  local cold = crawl.millis() - cold_start
+
+  local warm_plain, plain_ms = time_search("=" .. term)
+  local regex, regex_ms = time_search("/" .. term)
+
+  assert(same_results(plain, warm_plain),
+         "Repeated search for '" .. term .. "' gave different results")
+  assert(same_results(plain, regex),
+         "Indexed search for '" .. term .. "' found " .. #plain
+         .. " results, regex search found " .. #regex)
+
+  crawl.stderr(string.format("%-12s %5d matches: first %4d ms, "
+                             .. "plain %6.1f ms, regex %6.1f ms",
+                             term, #plain, cold, plain_ms, regex_ms))
+end
@@ -0,0 +1,57 @@
+-- Check the bulk operations on dgn.gridbuf grid buffers.
+
+local buf = dgn.gridbuf(10, 8)
+assert(buf:width() == 10 and buf:height() == 8, "wrong buffer size")
+assert(buf:count(0) == 80, "new buffer not filled with 0")
+assert(buf:get(10, 0) == nil, "out-of-bounds get returned a value")
+
+-- A wall down column 4, with one gap.
+buf:fill(1, 4, 0, 4, 7)
+buf:set(4, 5, 0)
+assert(buf:count(1) == 7, "fill or set changed the wrong cells")
+assert(buf:count_neighbours(3, 5, 1) == 2, "wrong neighbour count")
+
+local zones, nzones = buf:label_zones(0)
+assert(nzones == 1, "gap didn't join the two sides: " .. nzones)
+buf:set(4, 5, 1)
+zones, nzones = buf:label_zones(0)
+assert(nzones == 2, "wall didn't split the buffer: " .. nzones)
+assert(zones:get(0, 0) ~= zones:get(9, 7), "both sides in one zone")
+assert(zones:get(4, 2) == 0, "wall cell given a zone")
+
+-- Diagonal connection through a single-cell gap in a diagonal wall.
+local diag = dgn.gridbuf(3, 3, 0)
+diag:set(0, 0, 1)
+diag:set(1, 1, 1)
+diag:set(2, 2, 1)
+local _, orth = diag:label_zones(0)
+local _, eight = diag:label_zones(0, true)
+assert(orth == 2 and eight == 1, "diagonal connectivity wrong")
+
+local filled = buf:flood_fill(0, 0, 2)
+assert(filled == 32, "flood fill filled " .. filled .. " cells")
+assert(buf:get(9, 7) == 0, "flood fill crossed the wall")
+
+-- Distances from the right-hand edge, with and without the wall in the way.
+local edge = dgn.gridbuf(10, 8, 0)
+edge:fill(3, 9, 0, 9, 7)
+local free = edge:distance(3)
+assert(free:get(0, 0) == 9, "wrong open distance: " .. free:get(0, 0))
+edge:fill(1, 4, 0, 4, 7)
+local walled = edge:distance(3, 0)
+assert(walled:get(0, 0) == -1, "distance went through the wall")
+assert(walled:get(5, 3) == 4, "wrong walled distance")
+
+-- Stamping and copying.
+local stamp = dgn.gridbuf(3, 3, 7)
+stamp:set(1, 1, -1)
+local copy = buf:copy()
+copy:stamp(stamp, 8, 6, -1)
+assert(copy:count(7) == 3, "stamp not clipped or transparent")
+assert(copy:get(9, 7) == 0, "transparent cell stamped")
+assert(buf:count(7) == 0, "stamp changed the original buffer")
+assert(copy:replace(7, 5) == 3 and copy:count(5) == 3, "replace failed")
+
+local counts = buf:neighbour_counts(1)
+assert(counts:get(3, 3) == 3 and counts:get(0, 0) == 0,
+       "wrong bulk neighbour counts")
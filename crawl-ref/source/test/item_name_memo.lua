@@ -0,0 +1,62 @@
+-----------------------------------------------------------------------
+-- Checks that memoised item names are the same as freshly built ones,
+-- over the items generated on a spread of levels (the same kind of corpus
+-- objstat looks at), both before and after identifying everything.
+-----------------------------------------------------------------------
+
+local PLACES = { "D:2", "D:8", "D:14", "Lair:3", "Orc:2", "Elf:3",
+                 "Vaults:4", "Depths:3", "Zot:3" }
+local DESCS = { "the", "a", "plain", "your", "inv", "base", "qual" }
+
+local function level_items()
+  local items = { }
+  for y = 1, dgn.GYM - 2 do
+    for x = 1, dgn.GXM - 2 do
+      for _, item in ipairs(dgn.items_at(x, y)) do
+        table.insert(items, item)
+      end
+    end
+  end
+  return items
+end
+
+local function item_names(items)
+  local names = { }
+  for _, item in ipairs(items) do
+    for _, desc in ipairs(DESCS) do
+      table.insert(names, item.name(desc))
+      table.insert(names, item.name(desc, true))
+    end
+  end
+  return names
+end
+
+local function check_names(items, place, when)
+  debug.item_name_memo(false)
+  local expected = item_names(items)
+  debug.item_name_memo(true)
+  -- Once to fill the memo, once to read it back.
+  item_names(items)
+  local memoised = item_names(items)
+
+  for i, name in ipairs(expected) do
+    test.eq(memoised[i], name, "memoised item name at " .. place
+                               .. " (" .. when .. ")")
+  end
+end
+
+local total = 0
+for _, place in ipairs(PLACES) do
+  test.regenerate_level(place)
+  local items = level_items()
+  total = total + #items
+  check_names(items, place, "unidentified")
+  wiz.identify_all_items()
+  check_names(items, place, "identified")
+end
+
+local hits, misses, bypassed = debug.item_name_memo_stats()
+assert(total > 0, "No items generated")
+assert(hits > 0, "Item name memo was never used")
+crawl.stderr(string.format("%d items: %d memo hits, %d misses, %d bypassed",
+                           total, hits, misses, bypassed))
@@ -0,0 +1,721 @@
+/**
+ * @file
+ * @brief Compiled, read-only text databases.
+**/
+
+#include "AppHdr.h"
+
+#include "text-table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
+#include <unistd.h>
+#endif
+#ifdef UNIX
+#include <sys/mman.h>
+#endif
+
+#include "random.h"
+#include "stringutil.h"
+#include "syscalls.h"
+
+#define TEXT_TABLE_MAGIC "CRAWLTDB"
+// Bump this whenever the layout below changes.
+#define TEXT_TABLE_FORMAT 2
+#define TEXT_TABLE_BYTE_ORDER 0x01020304
+
+static const uint32_t NO_ENTRY = 0xffffffff;
+
+// All offsets are from the start of the file.
+struct text_table_header
+{
+    char magic[8];
+    uint32_t format;
+    uint32_t byte_order;
+    uint32_t size;
+    uint32_t num_files;
+    uint32_t num_buckets;
+    uint32_t num_slots;
+    uint32_t num_entries;
+    uint32_t num_alts;
+    uint32_t num_key_trigrams;
+    uint32_t num_body_trigrams;
+    uint32_t num_postings;
+    uint32_t files;   // uint32_t[num_files]: input file sizes, or NO_ENTRY
+    uint32_t buckets; // uint32_t[num_buckets]: hash seeds, 0 if empty
+    uint32_t slots;   // text_table_entry[num_slots]
+    uint32_t order;   // uint32_t[num_entries]: slots in file order
+    uint32_t alts;    // text_table_alt[num_alts]
+    uint32_t key_trigrams;  // text_table_trigram[num_key_trigrams]
+    uint32_t body_trigrams; // text_table_trigram[num_body_trigrams]
+    uint32_t postings; // uint32_t[num_postings]: indices into order
+    uint32_t strings;
+};
+
+struct text_table_entry
+{
+    uint32_t key, key_len; // key is NO_ENTRY for an empty slot
+    uint32_t body, body_len;
+    uint32_t first_alt, num_alts; // num_alts is 0 if the body didn't parse
+};
+
+struct text_table_alt
+{
+    int32_t weight; // cumulative, as in parse_weighted_entry()
+    uint32_t text, len;
+};
+
+// Sorted by trigram; the entries containing each one are listed, in
+// order, in postings[first..first+count).
+struct text_table_trigram
+{
+    uint32_t trigram, first, count;
+};
+
+// Keys are placed with "hash and displace": the seed-0 hash picks a key's
+// bucket, and each bucket stores the seed that sends all of its keys to
+// distinct free slots, so that a lookup is two hashes and one comparison.
+static uint32_t _hash(const char *s, size_t len, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= (uint8_t) s[i];
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+static uint32_t _file_size(const string &file, time_t *mtime = nullptr)
+{
+    struct stat st;
+    if (stat(file.c_str(), &st))
+        return NO_ENTRY;
+    if (mtime)
+        *mtime = st.st_mtime;
+    return st.st_size;
+}
+
+static uint32_t _trigram_at(const string &s, size_t i)
+{
+    return static_cast<uint8_t>(s[i]) << 16
+           | static_cast<uint8_t>(s[i + 1]) << 8
+           | static_cast<uint8_t>(s[i + 2]);
+}
+
+// Only ASCII is lowercased: regex searches ignore case, and other
+// characters aren't looked for through the index anyway.
+void add_text_trigrams(const string &text, vector<uint32_t> &trigrams)
+{
+    string lower = text;
+    for (char &c : lower)
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+    for (size_t i = 0; i + 3 <= lower.size(); ++i)
+        trigrams.push_back(_trigram_at(lower, i));
+}
+
+string parse_weighted_entry(const string &entry, vector<string> &parts,
+                            vector<int> &weights)
+{
+    vector<string> lines = split_string("\n", entry, false, true);
+
+    int total_weight = 0;
+    for (int i = 0, size = lines.size(); i < size; i++)
+    {
+        // Skip over multiple blank lines, and leading and trailing
+        // blank lines.
+        while (i < size && lines[i].empty())
+            i++;
+
+        if (i == size)
+            break;
+
+        int         weight;
+        string part = "";
+
+        if (sscanf(lines[i].c_str(), "w:%d", &weight))
+        {
+            i++;
+            if (i == size)
+                return "BUG, WEIGHT AT END OF ENTRY";
+        }
+        else
+            weight = 10;
+
+        total_weight += weight;
+
+        while (i < size && !lines[i].empty())
+        {
+            part += lines[i++];
+            part += "\n";
+        }
+        trim_string(part);
+
+        parts.push_back(part);
+        weights.push_back(total_weight);
+    }
+
+    if (parts.empty())
+        return "BUG, EMPTY ENTRY";
+
+    return "";
+}
+
+TextTable::TextTable()
+    : m_data(nullptr), m_size(0), m_mapped(false)
+{
+}
+
+TextTable::~TextTable()
+{
+    close();
+}
+
+const text_table_header *TextTable::_header() const
+{
+    return reinterpret_cast<const text_table_header *>(m_data);
+}
+
+const char *TextTable::_string(uint32_t offset) const
+{
+    return m_data + _header()->strings + offset;
+}
+
+// Read or map the whole of a file, returning whether it worked.
+static bool _load_file(const string &filename, const char *&data,
+                       size_t &size, bool &mapped, time_t &mtime)
+{
+    int fd = open_u(filename.c_str(), O_RDONLY | O_BINARY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size < (off_t) sizeof(text_table_header))
+    {
+        ::close(fd);
+        return false;
+    }
+    size = st.st_size;
+    mtime = st.st_mtime;
+
+#ifdef UNIX
+    void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    data = static_cast<const char *>(map);
+    mapped = true;
+#else
+    char *buf = new char[size];
+    size_t done = 0;
+    while (done < size)
+    {
+        const int got = ::read(fd, buf + done, size - done);
+        if (got <= 0)
+            break;
+        done += got;
+    }
+    ::close(fd);
+    if (done < size)
+    {
+        delete[] buf;
+        return false;
+    }
+    data = buf;
+    mapped = false;
+#endif
+    return true;
+}
+
+bool TextTable::open(const string &filename, const vector<string> &input_files)
+{
+    close();
+
+    time_t table_mtime;
+    if (!_load_file(filename, m_data, m_size, m_mapped, table_mtime))
+        return false;
+
+    const text_table_header &h = *_header();
+    const uint64_t size = m_size;
+    if (memcmp(h.magic, TEXT_TABLE_MAGIC, sizeof(h.magic))
+        || h.format != TEXT_TABLE_FORMAT
+        || h.byte_order != TEXT_TABLE_BYTE_ORDER
+        || h.size != size
+        || h.files + (uint64_t) h.num_files * sizeof(uint32_t) > size
+        || h.buckets + (uint64_t) h.num_buckets * sizeof(uint32_t) > size
+        || h.slots + (uint64_t) h.num_slots * sizeof(text_table_entry) > size
+        || h.order + (uint64_t) h.num_entries * sizeof(uint32_t) > size
+        || h.alts + (uint64_t) h.num_alts * sizeof(text_table_alt) > size
+        || h.key_trigrams + (uint64_t) h.num_key_trigrams
+                            * sizeof(text_table_trigram) > size
+        || h.body_trigrams + (uint64_t) h.num_body_trigrams
+                             * sizeof(text_table_trigram) > size
+        || h.postings + (uint64_t) h.num_postings * sizeof(uint32_t) > size
+        || h.strings > size
+        || !h.num_buckets || !h.num_slots
+        || h.num_files != input_files.size())
+    {
+        close();
+        return false;
+    }
+
+    // Any edit to an input file means the DBM cache has to be used instead.
+    const uint32_t *sizes
+        = reinterpret_cast<const uint32_t *>(m_data + h.files);
+    for (unsigned int i = 0; i < input_files.size(); ++i)
+    {
+        time_t mtime = 0;
+        if (_file_size(input_files[i], &mtime) != sizes[i]
+            || mtime > table_mtime)
+        {
+            close();
+            return false;
+        }
+    }
+
+    // Check the string ranges once, so lookups needn't.
+    const uint64_t strings_size = size - h.strings;
+    for (uint32_t i = 0; i < h.num_slots; ++i)
+    {
+        const text_table_entry &e = *_slot(i);
+        if (e.key == NO_ENTRY)
+            continue;
+        if ((uint64_t) e.key + e.key_len > strings_size
+            || (uint64_t) e.body + e.body_len > strings_size
+            || (uint64_t) e.first_alt + e.num_alts > h.num_alts)
+        {
+            close();
+            return false;
+        }
+    }
+    const text_table_alt *alts
+        = reinterpret_cast<const text_table_alt *>(m_data + h.alts);
+    for (uint32_t i = 0; i < h.num_alts; ++i)
+    {
+        if ((uint64_t) alts[i].text + alts[i].len > strings_size)
+        {
+            close();
+            return false;
+        }
+    }
+    const uint32_t *order
+        = reinterpret_cast<const uint32_t *>(m_data + h.order);
+    for (uint32_t i = 0; i < h.num_entries; ++i)
+    {
+        if (order[i] >= h.num_slots || _slot(order[i])->key == NO_ENTRY)
+        {
+            close();
+            return false;
+        }
+    }
+    auto trigrams_ok = [&](uint32_t offset, uint32_t count)
+    {
+        const text_table_trigram *trigrams
+            = reinterpret_cast<const text_table_trigram *>(m_data + offset);
+        for (uint32_t i = 0; i < count; ++i)
+            if ((uint64_t) trigrams[i].first + trigrams[i].count
+                > h.num_postings)
+            {
+                return false;
+            }
+        return true;
+    };
+    if (!trigrams_ok(h.key_trigrams, h.num_key_trigrams)
+        || !trigrams_ok(h.body_trigrams, h.num_body_trigrams))
+    {
+        close();
+        return false;
+    }
+    const uint32_t *postings
+        = reinterpret_cast<const uint32_t *>(m_data + h.postings);
+    for (uint32_t i = 0; i < h.num_postings; ++i)
+    {
+        if (postings[i] >= h.num_entries)
+        {
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void TextTable::close()
+{
+    if (!m_data)
+        return;
+#ifdef UNIX
+    if (m_mapped)
+        munmap(const_cast<char *>(m_data), m_size);
+    else
+#endif
+        delete[] m_data;
+    m_data = nullptr;
+    m_size = 0;
+}
+
+const text_table_entry *TextTable::_slot(uint32_t i) const
+{
+    return reinterpret_cast<const text_table_entry *>(
+               m_data + _header()->slots) + i;
+}
+
+uint32_t TextTable::size() const
+{
+    return m_data ? _header()->num_entries : 0;
+}
+
+const text_table_entry *TextTable::entry(uint32_t i) const
+{
+    return _slot(reinterpret_cast<const uint32_t *>(
+                     m_data + _header()->order)[i]);
+}
+
+const text_table_entry *TextTable::find(const string &key) const
+{
+    if (!m_data)
+        return nullptr;
+
+    const text_table_header &h = *_header();
+    const uint32_t *buckets
+        = reinterpret_cast<const uint32_t *>(m_data + h.buckets);
+    const uint32_t seed
+        = buckets[_hash(key.data(), key.size(), 0) % h.num_buckets];
+    if (!seed)
+        return nullptr;
+
+    const text_table_entry *e
+        = _slot(_hash(key.data(), key.size(), seed) % h.num_slots);
+    if (e->key == NO_ENTRY || e->key_len != key.size()
+        || memcmp(_string(e->key), key.data(), key.size()))
+    {
+        return nullptr;
+    }
+    return e;
+}
+
+string TextTable::key(const text_table_entry *e) const
+{
+    return string(_string(e->key), e->key_len);
+}
+
+const char *TextTable::body(const text_table_entry *e, uint32_t *len) const
+{
+    *len = e->body_len;
+    return _string(e->body);
+}
+
+vector<uint32_t> TextTable::find_trigrams(const vector<uint32_t> &trigrams,
+                                          bool bodies) const
+{
+    vector<uint32_t> found;
+    if (!m_data)
+        return found;
+
+    const text_table_header &h = *_header();
+    const text_table_trigram *index
+        = reinterpret_cast<const text_table_trigram *>(
+              m_data + (bodies ? h.body_trigrams : h.key_trigrams));
+    const text_table_trigram *index_end
+        = index + (bodies ? h.num_body_trigrams : h.num_key_trigrams);
+    const uint32_t *postings
+        = reinterpret_cast<const uint32_t *>(m_data + h.postings);
+
+    // Start from the rarest trigram, and weed out entries lacking the rest.
+    vector<const text_table_trigram *> lists;
+    for (uint32_t tri : trigrams)
+    {
+        const text_table_trigram *t
+            = lower_bound(index, index_end, tri,
+                          [](const text_table_trigram &a, uint32_t b)
+                          { return a.trigram < b; });
+        if (t == index_end || t->trigram != tri)
+            return found;
+        lists.push_back(t);
+    }
+    if (lists.empty())
+        return found;
+    sort(lists.begin(), lists.end(),
+         [](const text_table_trigram *a, const text_table_trigram *b)
+         { return a->count < b->count; });
+
+    const uint32_t *first = postings + lists[0]->first;
+    for (const uint32_t *p = first; p != first + lists[0]->count; ++p)
+    {
+        bool all = true;
+        for (size_t i = 1; all && i < lists.size(); ++i)
+        {
+            const uint32_t *list = postings + lists[i]->first;
+            all = binary_search(list, list + lists[i]->count, *p);
+        }
+        if (all)
+            found.push_back(*p);
+    }
+    return found;
+}
+
+bool TextTable::choose(const text_table_entry *e, int fixed_weight,
+                       string &result) const
+{
+    if (!e->num_alts)
+        return false;
+
+    const text_table_alt *alts = reinterpret_cast<const text_table_alt *>(
+                                     m_data + _header()->alts) + e->first_alt;
+    const int total_weight = alts[e->num_alts - 1].weight;
+
+    int choice = 0;
+    if (fixed_weight != -1)
+        choice = fixed_weight % total_weight;
+    else
+        choice = random2(total_weight);
+
+    for (uint32_t i = 0; i < e->num_alts; ++i)
+        if (choice < alts[i].weight)
+        {
+            result.assign(_string(alts[i].text), alts[i].len);
+            return true;
+        }
+
+    return false;
+}
+
+static uint32_t _add_string(string &strings, const string &s)
+{
+    const uint32_t offset = strings.size();
+    strings += s;
+    return offset;
+}
+
+// Index the trigrams of each text, appending the lists of texts containing
+// each trigram to postings.
+static vector<text_table_trigram> _index_trigrams(const vector<string> &texts,
+                                                  vector<uint32_t> &postings)
+{
+    map<uint32_t, vector<uint32_t>> lists;
+    vector<uint32_t> trigrams;
+    for (uint32_t i = 0; i < texts.size(); ++i)
+    {
+        trigrams.clear();
+        add_text_trigrams(texts[i], trigrams);
+        sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(unique(trigrams.begin(), trigrams.end()),
+                       trigrams.end());
+        for (uint32_t tri : trigrams)
+            lists[tri].push_back(i);
+    }
+
+    vector<text_table_trigram> index;
+    for (const auto &list : lists)
+    {
+        text_table_trigram t;
+        t.trigram = list.first;
+        t.first = postings.size();
+        t.count = list.second.size();
+        postings.insert(postings.end(), list.second.begin(),
+                        list.second.end());
+        index.push_back(t);
+    }
+    return index;
+}
+
+template <typename T>
+static uint32_t _append(string &out, const vector<T> &items)
+{
+    const uint32_t offset = out.size();
+    if (!items.empty())
+    {
+        out.append(reinterpret_cast<const char *>(items.data()),
+                   items.size() * sizeof(T));
+    }
+    return offset;
+}
+
+bool TextTable::write(const string &filename,
+                      const vector<string> &input_files,
+                      const vector<pair<string, string>> &entries)
+{
+    vector<const pair<string, string> *> items;
+    map<string, uint32_t> item_index;
+    for (const auto &entry : entries)
+    {
+        auto it = item_index.find(entry.first);
+        if (it == item_index.end())
+        {
+            item_index[entry.first] = items.size();
+            items.push_back(&entry);
+        }
+        else
+            items[it->second] = &entry;
+    }
+
+    const uint32_t num_slots = max<uint32_t>(1, items.size()
+                                                + items.size() / 8);
+    const uint32_t num_buckets = max<uint32_t>(1, items.size() / 4);
+
+    vector<vector<uint32_t>> bucket_items(num_buckets);
+    for (uint32_t i = 0; i < items.size(); ++i)
+    {
+        const string &key = items[i]->first;
+        bucket_items[_hash(key.data(), key.size(), 0) % num_buckets]
+            .push_back(i);
+    }
+
+    // Place the biggest buckets first, while there's the most room.
+    vector<uint32_t> bucket_order(num_buckets);
+    for (uint32_t i = 0; i < num_buckets; ++i)
+        bucket_order[i] = i;
+    stable_sort(bucket_order.begin(), bucket_order.end(),
+                [&](uint32_t a, uint32_t b)
+                {
+                    return bucket_items[a].size() > bucket_items[b].size();
+                });
+
+    vector<uint32_t> seeds(num_buckets, 0);
+    vector<uint32_t> slot_item(num_slots, NO_ENTRY);
+    vector<uint32_t> placed;
+    for (uint32_t b : bucket_order)
+    {
+        if (bucket_items[b].empty())
+            break;
+        for (uint32_t seed = 1; !seeds[b]; ++seed)
+        {
+            if (seed > 1000000)
+                return false;
+
+            placed.clear();
+            for (uint32_t i : bucket_items[b])
+            {
+                const string &key = items[i]->first;
+                const uint32_t s = _hash(key.data(), key.size(), seed)
+                                   % num_slots;
+                if (slot_item[s] != NO_ENTRY
+                    || count(placed.begin(), placed.end(), s))
+                {
+                    break;
+                }
+                placed.push_back(s);
+            }
+            if (placed.size() < bucket_items[b].size())
+                continue;
+
+            for (unsigned int j = 0; j < placed.size(); ++j)
+                slot_item[placed[j]] = bucket_items[b][j];
+            seeds[b] = seed;
+        }
+    }
+
+    vector<uint32_t> order(items.size());
+    for (uint32_t s = 0; s < num_slots; ++s)
+        if (slot_item[s] != NO_ENTRY)
+            order[slot_item[s]] = s;
+
+    string strings;
+    vector<text_table_entry> slots(num_slots);
+    vector<text_table_alt> alts;
+    for (uint32_t s = 0; s < num_slots; ++s)
+    {
+        text_table_entry &e = slots[s];
+        if (slot_item[s] == NO_ENTRY)
+        {
+            e.key = NO_ENTRY;
+            e.key_len = e.body = e.body_len = e.first_alt = e.num_alts = 0;
+            continue;
+        }
+        const string &key = items[slot_item[s]]->first;
+        const string &body = items[slot_item[s]]->second;
+        e.key = _add_string(strings, key);
+        e.key_len = key.size();
+        e.body = _add_string(strings, body);
+        e.body_len = body.size();
+        e.first_alt = alts.size();
+        e.num_alts = 0;
+
+        vector<string> parts;
+        vector<int> weights;
+        if (!parse_weighted_entry(body, parts, weights).empty()
+            || weights.back() <= 0)
+        {
+            continue;
+        }
+        for (unsigned int i = 0; i < parts.size(); ++i)
+        {
+            text_table_alt alt;
+            alt.weight = weights[i];
+            alt.text = _add_string(strings, parts[i]);
+            alt.len = parts[i].size();
+            alts.push_back(alt);
+        }
+        e.num_alts = parts.size();
+    }
+
+    vector<string> keys, bodies;
+    for (const auto *item : items)
+    {
+        keys.push_back(item->first);
+        bodies.push_back(item->second);
+    }
+    vector<uint32_t> postings;
+    const vector<text_table_trigram> key_trigrams
+        = _index_trigrams(keys, postings);
+    const vector<text_table_trigram> body_trigrams
+        = _index_trigrams(bodies, postings);
+
+    vector<uint32_t> sizes;
+    for (const string &file : input_files)
+        sizes.push_back(_file_size(file));
+
+    text_table_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TEXT_TABLE_MAGIC, sizeof(h.magic));
+    h.format = TEXT_TABLE_FORMAT;
+    h.byte_order = TEXT_TABLE_BYTE_ORDER;
+    h.num_files = sizes.size();
+    h.num_buckets = num_buckets;
+    h.num_slots = num_slots;
+    h.num_entries = items.size();
+    h.num_alts = alts.size();
+    h.num_key_trigrams = key_trigrams.size();
+    h.num_body_trigrams = body_trigrams.size();
+    h.num_postings = postings.size();
+
+    // Everything but the strings is made of 32-bit fields, so stays aligned.
+    string out(sizeof(h), '\0');
+    h.files = _append(out, sizes);
+    h.buckets = _append(out, seeds);
+    h.slots = _append(out, slots);
+    h.order = _append(out, order);
+    h.alts = _append(out, alts);
+    h.key_trigrams = _append(out, key_trigrams);
+    h.body_trigrams = _append(out, body_trigrams);
+    h.postings = _append(out, postings);
+    h.strings = out.size();
+    out += strings;
+    h.size = out.size();
+    memcpy(&out[0], &h, sizeof(h));
+
+    // Write to a temporary file first: other processes may have the old
+    // table mapped.
+    const string tmp = filename + ".tmp";
+    FILE *f = fopen_u(tmp.c_str(), "wb");
+    if (!f)
+        return false;
+    const bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    if (fclose(f) || !ok || rename_u(tmp.c_str(), filename.c_str()))
+    {
+        unlink_u(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Compiled, read-only text databases.
+ *
+ * -builddb compiles the entries of each text database into a .tdb file next
+ * to its text files: a perfect hash table of the keys, the bodies, and the
+ * weighted alternatives of each body already split out, and a trigram index
+ * of the keys and bodies for regex searches. Every crawl process
+ * maps the same file read-only, instead of keeping its own DBM cache; the
+ * DBM cache is still used when a text file is newer than its table.
+**/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::string;
+using std::vector;
+
+struct text_table_entry;
+
+class TextTable
+{
+public:
+    TextTable();
+    ~TextTable();
+
+    // Map the table in filename, if it was compiled from the current
+    // versions of input_files.
+    bool open(const string &filename, const vector<string> &input_files);
+    void close();
+    bool is_open() const { return m_data != nullptr; }
+
+    // Compile entries (in file order; a repeated key replaces the earlier
+    // body) into filename.
+    static bool write(const string &filename,
+                      const vector<string> &input_files,
+                      const vector<pair<string, string>> &entries);
+
+    const text_table_entry *find(const string &key) const;
+    // The entries, in the order they were written.
+    uint32_t size() const;
+    const text_table_entry *entry(uint32_t i) const;
+
+    string key(const text_table_entry *e) const;
+    const char *body(const text_table_entry *e, uint32_t *len) const;
+
+    // The entries (in order, as indices for entry()) whose keys, or bodies,
+    // contain all of trigrams; see add_text_trigrams().
+    vector<uint32_t> find_trigrams(const vector<uint32_t> &trigrams,
+                                   bool bodies) const;
+
+    // Pick one of the weighted alternatives of an entry, as
+    // _chooseStrByWeight() would: returns false if its body didn't parse,
+    // in which case the caller has to parse it to get the error message.
+    bool choose(const text_table_entry *e, int fixed_weight,
+                string &result) const;
+
+private:
+    const char *m_data;
+    size_t m_size;
+    bool m_mapped;
+
+    const struct text_table_header *_header() const;
+    const char *_string(uint32_t offset) const;
+    const text_table_entry *_slot(uint32_t i) const;
+};
+
+// The trigrams of text, ignoring ASCII case, as indexed in text tables.
+void add_text_trigrams(const string &text, vector<uint32_t> &trigrams);
+
+// Split a database entry into its weighted alternatives: each one is a
+// block of lines, optionally preceded by a "w:<weight>" line (the default
+// weight is 10). weights are cumulative. Returns an error message if the
+// entry has no alternatives, or nothing.
+string parse_weighted_entry(const string &entry, vector<string> &parts,
+                            vector<int> &weights);
@@ -8,6 +8,7 @@
 #include "colour.h"
 #include "coord.h"
 #include "coordit.h"
+#include "dbg-prof.h"
 #include "domino.h"
 #include "domino-data.h"
 #include "dungeon.h"
@@ -37,6 +38,7 @@
 
 void tile_new_level(bool first_time, bool init_unseen)
 {
+    TRANSITION_PHASE(TRANS_TILES);
     if (first_time)
         tile_init_flavour();
 
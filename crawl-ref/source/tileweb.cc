@@ -6,6 +6,7 @@
 
 #include <cerrno>
 #include <cstdarg>
+#include <ctime>
 
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -14,17 +15,20 @@
 #if defined(UNIX) || defined(TARGET_COMPILER_MINGW)
 #include <unistd.h>
 #endif
+#include <zlib.h>
 
 #include "artefact.h"
 #include "branch.h"
 #include "command.h"
 #include "coord.h"
 #include "database.h"
+#include "dbg-prof.h"
 #include "describe.h"
 #include "directn.h"
 #include "english.h"
 #include "env.h"
 #include "files.h"
+#include "hash.h"
 #include "invent.h"
 #include "item-name.h"
 #include "item-prop.h" // is_weapon()
@@ -81,10 +85,92 @@ static unsigned int get_milliseconds()
     return ((unsigned int) tv.tv_sec) * 1000 + tv.tv_usec / 1000;
 }
 
+// How often a recording gets a keyframe. Seeking in a replay plays at most
+// this much of the message stream on top of the nearest keyframe.
+static const unsigned int RECORD_KEYFRAME_INTERVAL = 60 * 1000;
+
+WebtilesRecorder::WebtilesRecorder()
+    : m_file(nullptr), m_start(0), m_last_keyframe(0),
+      m_keyframe_start(false)
+{
+}
+
+WebtilesRecorder::~WebtilesRecorder()
+{
+    close();
+}
+
+bool WebtilesRecorder::open(const string &filename)
+{
+    close();
+    m_file = gzopen(filename.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    m_start = get_milliseconds();
+    m_last_keyframe = m_start;
+    m_keyframe_start = false;
+
+    const string header = make_stringf(
+        "{\"msg\":\"wtrec\",\"format\":1,\"version\":\"%s\","
+        "\"start\":%lld,\"keyframe_interval\":%u}\n",
+        Version::Long, (long long) time(nullptr), RECORD_KEYFRAME_INTERVAL);
+    if (gzputs(m_file, header.c_str()) < 0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void WebtilesRecorder::close()
+{
+    if (!m_file)
+        return;
+    gzclose(m_file);
+    m_file = nullptr;
+}
+
+void WebtilesRecorder::record(const string &msg, bool keyframe)
+{
+    if (!m_file)
+        return;
+
+    const char kind = !keyframe ? 'd' : m_keyframe_start ? 'K' : 'k';
+    if (keyframe)
+        m_keyframe_start = false;
+
+    const string prefix = make_stringf("%c %u ", kind,
+                                       get_milliseconds() - m_start);
+    if (gzputs(m_file, prefix.c_str()) < 0
+        || gzwrite(m_file, msg.data(), msg.size()) <= 0
+        || gzputc(m_file, '\n') < 0)
+    {
+        fprintf(stderr, "Webtiles recording write error; recording stopped.\n");
+        close();
+    }
+}
+
+bool WebtilesRecorder::keyframe_due() const
+{
+    return m_file
+           && get_milliseconds() - m_last_keyframe >= RECORD_KEYFRAME_INTERVAL;
+}
+
+void WebtilesRecorder::start_keyframe()
+{
+    // Make everything up to the keyframe readable even if the game dies
+    // before the file is closed.
+    gzflush(m_file, Z_SYNC_FLUSH);
+    m_last_keyframe = get_milliseconds();
+    m_keyframe_start = true;
+}
+
 TilesFramework tiles;
 
 TilesFramework::TilesFramework() :
       m_controlled_from_web(false),
+      m_recording_keyframe(false),
       _send_lock(false),
       m_last_ui_state(UI_INIT),
       m_view_loaded(false),
@@ -94,7 +180,12 @@ TilesFramework::TilesFramework() :
       m_next_view_br(-1, -1),
       m_need_full_map(true),
       m_text_menu("menu_txt"),
-      m_print_fg(15)
+      m_print_fg(15),
+      m_player_gen(1),
+      m_player_sent_gen(0),
+      m_player_section_sends(0),
+      m_inv_name_gen(0),
+      m_inv_use_state(0)
 {
     screen_cell_t default_cell;
     default_cell.tile.bg = TILE_FLAG_UNSEEN;
@@ -108,6 +199,8 @@ TilesFramework::~TilesFramework()
 
 void TilesFramework::shutdown()
 {
+    m_recorder.close();
+
     if (m_sock_name.empty())
         return;
 
@@ -156,6 +249,12 @@ bool TilesFramework::initialise()
     if (m_await_connection)
         _await_connection();
 
+    if (!m_record_name.empty() && !m_recorder.open(m_record_name))
+    {
+        fprintf(stderr, "Can't open the webtiles recording %s: %s\n",
+                m_record_name.c_str(), strerror(errno));
+    }
+
     _send_version();
     send_exit_reason("unknown");
     send_options(); // n.b. full rc read hasn't happened yet
@@ -194,7 +293,10 @@ void TilesFramework::finish_message()
     fprintf(stderr, "websocket: About to send %d bytes.\n", initial_buf_size);
 #endif
 
-    if (m_sock_name.empty())
+    if (m_recorder.is_open())
+        m_recorder.record(m_msg_buf, m_recording_keyframe);
+
+    if (m_sock_name.empty() || m_recording_keyframe)
     {
         m_msg_buf.clear();
         return;
@@ -680,6 +782,10 @@ void TilesFramework::dump()
         fprintf(stderr, "start: %d end: %d type: %c\n",
                 frame.start, frame.prefix_end, frame.type);
     }
+    fprintf(stderr, "Webtiles player sections recomputed:");
+    for (int i = 0; i < NUM_PLAYER_SECTIONS; ++i)
+        fprintf(stderr, " %d", m_player_section_sends[i]);
+    fprintf(stderr, "\n");
 }
 
 void TilesFramework::send_exit_reason(const string& type, const string& message)
@@ -727,6 +833,15 @@ void TilesFramework::send_milestone(const xlog_fields &xl)
     finish_message();
 }
 
+void TilesFramework::send_level_transition(const xlog_fields &xl)
+{
+    JsonWrapper j = xl.xlog_json();
+    json_append_member(j.node, "msg", json_mkstring("level_transition"));
+    write_message("*");
+    write_message("%s", j.to_string().c_str());
+    finish_message();
+}
+
 void TilesFramework::send_options()
 {
     json_open_object();
@@ -1052,6 +1167,104 @@ player_info::player_info()
     position = coord_def(-1, -1);
 }
 
+// The parts of the player that is_useless_item() looks at: species, god and
+// piety, form, mutations, and (for temporary uselessness) being able to act.
+static uint64_t _inv_usefulness_state()
+{
+    const int state[] = {
+        you.species, you.religion, piety_rank(), static_cast<int>(you.form),
+        you.cannot_act(),
+    };
+    return hash3(hash32(state, sizeof(state)),
+                 hash32(&you.mutation[0], NUM_MUTATIONS),
+                 hash32(&you.temp_mutation[0], NUM_MUTATIONS));
+}
+
+void TilesFramework::note_player_redraw()
+{
+    auto bump = [this](player_section section, bool redraw)
+    {
+        if (redraw)
+            ++m_player_gen[section];
+    };
+
+    bool stats = false;
+    for (int i = 0; i < NUM_STATS; ++i)
+        stats = stats || you.redraw_stats[i];
+    const bool equipment = you.wield_change || you.gear_change
+                           || you.redraw_quiver;
+
+    bump(PSEC_TITLE, you.redraw_title);
+    bump(PSEC_HEALTH, you.redraw_hit_points || you.redraw_magic_points);
+    bump(PSEC_DEFENCES, you.redraw_armour_class || you.redraw_evasion);
+    bump(PSEC_ATTRIBUTES, stats);
+    bump(PSEC_DOOM, you.redraw_doom);
+    bump(PSEC_CONTAM, you.redraw_contam);
+    bump(PSEC_EXPERIENCE, you.redraw_experience);
+    bump(PSEC_NOISE, you.redraw_noise);
+    bump(PSEC_STATUS, you.redraw_status_lights);
+    bump(PSEC_EQUIPMENT, equipment);
+    // Item names, uselessness and tiles can also change with identification,
+    // option changes and the player's own state, which don't set any redraw
+    // flag.
+    const uint64_t use_state = _inv_usefulness_state();
+    bump(PSEC_INVENTORY, equipment || m_inv_name_gen != item_name_generation()
+                         || m_inv_use_state != use_state);
+    m_inv_name_gen = item_name_generation();
+    m_inv_use_state = use_state;
+}
+
+/**
+ * Does this section of the player message need to be recomputed? Full sends
+ * always recompute everything, but don't count as having caught up, since
+ * they don't refresh everything they send (see the statuses).
+ */
+bool TilesFramework::_player_section_stale(player_section section,
+                                           bool force_full)
+{
+    if (!force_full && m_player_sent_gen[section] == m_player_gen[section])
+        return false;
+    if (!force_full)
+        m_player_sent_gen[section] = m_player_gen[section];
+    ++m_player_section_sends[section];
+    return true;
+}
+
+// The plus _send_item() compares for an inventory item.
+static short _sent_item_plus(const item_def &item)
+{
+    if (is_xp_evoker(item))
+        return evoker_charges(item.sub_type);
+    if (you.corrosion_amount() && is_weapon(item)
+        && you.equipment.find_equipped_slot(item) != SLOT_UNUSED)
+    {
+        return item.plus - you.corrosion_amount();
+    }
+    return item.plus;
+}
+
+// Would _send_item() find any of the item's own fields changed? Derived
+// state (names, uselessness, tiles) is tracked by PSEC_INVENTORY instead.
+static bool _inv_item_changed(const item_def &current, const item_def &next)
+{
+    if (current.base_type != next.base_type
+        || current.quantity != next.quantity)
+    {
+        return true;
+    }
+    if (!next.defined())
+        return false;
+
+    return !current.defined()
+           || current.sub_type != next.sub_type
+           || current.plus != _sent_item_plus(next)
+           || current.plus2 != next.plus2
+           || current.flags != next.flags
+           || current.inscription != next.inscription
+           || current.slot != next.slot
+           || current.special != next.special;
+}
+
 /**
  * Send the player properties to the webserver. Any player properties that
  * must be available to the WebTiles client must be sent here through an
@@ -1078,71 +1291,90 @@ void TilesFramework::_send_player(bool force_full)
         force_full = true;
     }
 
+    // Flags that print_stats() hasn't got to yet.
+    note_player_redraw();
+
     json_open_object();
     json_write_string("msg", "player");
     json_treat_as_empty();
 
-    _update_string(force_full, c.name, you.your_name, "name");
-    _update_string(force_full, c.job_title, filtered_lang(player_title()),
-                   "title");
-    _update_int(force_full, c.wizard, you.wizard, "wizard");
-    _update_int(force_full, c.explore, you.explore, "explore");
-    _update_string(force_full, c.species, player_species_name(),
-                   "species");
-    string god = "";
-    if (you_worship(GOD_JIYVA))
-        god = god_name_jiyva(true);
-    else if (!you_worship(GOD_NO_GOD))
-        god = god_name(you.religion);
-    _update_string(force_full, c.god, god, "god");
-    _update_int(force_full, c.under_penance, (bool) player_under_penance(), "penance");
-    int prank = 0;
-    if (you_worship(GOD_XOM))
-        prank = xom_favour_rank() - 1;
-    else if (!you_worship(GOD_NO_GOD))
-        prank = max(0, piety_rank());
-    else if (you.char_class == JOB_MONK && !you.has_mutation(MUT_FORLORN)
-             && !had_gods())
-    {
-        prank = 2;
-    }
-    _update_int(force_full, c.piety_rank, prank, "piety_rank");
-    _update_int(force_full, c.ostracism_pips, ostracism_pips(), "ostracism_pips");
-
-    _update_int(force_full, c.form, (uint8_t) you.form, "form");
-
-    _update_int(force_full, c.hp, you.hp, "hp");
-    _update_int(force_full, c.hp_max, you.hp_max, "hp_max");
-    int max_max_hp = get_real_hp(true, false);
-
-    _update_int(force_full, c.real_hp_max, max_max_hp, "real_hp_max");
-    _update_int(force_full, c.mp, you.magic_points, "mp");
-    _update_int(force_full, c.mp_max, you.max_magic_points, "mp_max");
+    if (_player_section_stale(PSEC_TITLE, force_full))
+    {
+        _update_string(force_full, c.name, you.your_name, "name");
+        _update_string(force_full, c.job_title, filtered_lang(player_title()),
+                       "title");
+        _update_int(force_full, c.wizard, you.wizard, "wizard");
+        _update_int(force_full, c.explore, you.explore, "explore");
+        _update_string(force_full, c.species, player_species_name(),
+                       "species");
+        string god = "";
+        if (you_worship(GOD_JIYVA))
+            god = god_name_jiyva(true);
+        else if (!you_worship(GOD_NO_GOD))
+            god = god_name(you.religion);
+        _update_string(force_full, c.god, god, "god");
+        _update_int(force_full, c.under_penance, (bool) player_under_penance(), "penance");
+        int prank = 0;
+        if (you_worship(GOD_XOM))
+            prank = xom_favour_rank() - 1;
+        else if (!you_worship(GOD_NO_GOD))
+            prank = max(0, piety_rank());
+        else if (you.char_class == JOB_MONK && !you.has_mutation(MUT_FORLORN)
+                 && !had_gods())
+        {
+            prank = 2;
+        }
+        _update_int(force_full, c.piety_rank, prank, "piety_rank");
+        _update_int(force_full, c.ostracism_pips, ostracism_pips(), "ostracism_pips");
+
+        _update_int(force_full, c.form, (uint8_t) you.form, "form");
+    }
+
+    if (_player_section_stale(PSEC_HEALTH, force_full))
+    {
+        _update_int(force_full, c.hp, you.hp, "hp");
+        _update_int(force_full, c.hp_max, you.hp_max, "hp_max");
+        int max_max_hp = get_real_hp(true, false);
+
+        _update_int(force_full, c.real_hp_max, max_max_hp, "real_hp_max");
+        _update_int(force_full, c.mp, you.magic_points, "mp");
+        _update_int(force_full, c.mp_max, you.max_magic_points, "mp_max");
 #if TAG_MAJOR_VERSION == 34
-    _update_int(force_full, c.dd_real_mp_max,
-                you.species == SP_DEEP_DWARF ? get_real_mp(false) : 0,
-                "dd_real_mp_max");
+        _update_int(force_full, c.dd_real_mp_max,
+                    you.species == SP_DEEP_DWARF ? get_real_mp(false) : 0,
+                    "dd_real_mp_max");
 #else
-    // TODO: clean up the JS that uses this
-    _update_int(force_full, c.dd_real_mp_max, 0, "dd_real_mp_max");
+        // TODO: clean up the JS that uses this
+        _update_int(force_full, c.dd_real_mp_max, 0, "dd_real_mp_max");
 #endif
 
-    _update_int(force_full, c.poison_survival, max(0, poison_survival()),
-                "poison_survival");
+        _update_int(force_full, c.poison_survival, max(0, poison_survival()),
+                    "poison_survival");
+    }
 
-    _update_int(force_full, c.armour_class, you.armour_class_scaled(1), "ac");
-    _update_int(force_full, c.evasion, you.evasion_scaled(1), "ev");
-    _update_int(force_full, c.shield_class, player_displayed_shield_class(),
-                "sh");
+    if (_player_section_stale(PSEC_DEFENCES, force_full))
+    {
+        _update_int(force_full, c.armour_class, you.armour_class_scaled(1), "ac");
+        _update_int(force_full, c.evasion, you.evasion_scaled(1), "ev");
+        _update_int(force_full, c.shield_class, player_displayed_shield_class(),
+                    "sh");
+    }
 
-    _update_int(force_full, c.strength, (int8_t) you.strength(false), "str");
-    _update_int(force_full, c.intel, (int8_t) you.intel(false), "int");
-    _update_int(force_full, c.dex, (int8_t) you.dex(false), "dex");
+    if (_player_section_stale(PSEC_ATTRIBUTES, force_full))
+    {
+        _update_int(force_full, c.strength, (int8_t) you.strength(false), "str");
+        _update_int(force_full, c.intel, (int8_t) you.intel(false), "int");
+        _update_int(force_full, c.dex, (int8_t) you.dex(false), "dex");
+    }
 
-    _update_int(force_full, c.doom, you.attribute[ATTR_DOOM], "doom");
-    _update_string(force_full, c.doom_desc, getLongDescription("doom status"), "doom_desc");
+    if (_player_section_stale(PSEC_DOOM, force_full))
+    {
+        _update_int(force_full, c.doom, you.attribute[ATTR_DOOM], "doom");
+        _update_string(force_full, c.doom_desc, getLongDescription("doom status"), "doom_desc");
+    }
 
-    _update_int(force_full, c.contam, you.magic_contamination / 10, "contam");
+    if (_player_section_stale(PSEC_CONTAM, force_full))
+        _update_int(force_full, c.contam, you.magic_contamination / 10, "contam");
 
     if (you.has_mutation(MUT_MULTILIVED))
     {
@@ -1150,12 +1382,18 @@ void TilesFramework::_send_player(bool force_full)
         _update_int(force_full, c.deaths, you.deaths, "deaths");
     }
 
-    _update_int(force_full, c.experience_level, you.experience_level, "xl");
-    _update_int(force_full, c.exp_progress, (int8_t) get_exp_progress(), "progress");
+    if (_player_section_stale(PSEC_EXPERIENCE, force_full))
+    {
+        _update_int(force_full, c.experience_level, you.experience_level, "xl");
+        _update_int(force_full, c.exp_progress, (int8_t) get_exp_progress(), "progress");
+    }
     _update_int(force_full, c.gold, you.gold, "gold");
-    _update_int(force_full, c.noise,
-                (you.wizard ? you.get_noise_perception(false) : -1), "noise");
-    _update_int(force_full, c.adjusted_noise, you.get_noise_perception(true), "adjusted_noise");
+    if (_player_section_stale(PSEC_NOISE, force_full))
+    {
+        _update_int(force_full, c.noise,
+                    (you.wizard ? you.get_noise_perception(false) : -1), "noise");
+        _update_int(force_full, c.adjusted_noise, you.get_noise_perception(true), "adjusted_noise");
+    }
 
     if (you.running == 0) // Don't update during running/resting
     {
@@ -1200,7 +1438,8 @@ void TilesFramework::_send_player(bool force_full)
         c.position = pos;
     }
 
-    if (force_full || _update_statuses(c))
+    if (_player_section_stale(PSEC_STATUS, force_full)
+        && (force_full || _update_statuses(c)))
     {
         json_open_array("status");
         for (const status_info &status : c.status)
@@ -1232,9 +1471,17 @@ void TilesFramework::_send_player(bool force_full)
         json_close_array();
     }
 
+    // Slots whose own fields are unchanged only need another look when
+    // something they are derived from might have changed.
+    const bool inv_stale = _player_section_stale(PSEC_INVENTORY, force_full);
+    bool inv_sent = false;
     json_open_object("inv");
     for (unsigned int i = 0; i < ENDOFPACK; ++i)
     {
+        if (!inv_stale && !_inv_item_changed(c.inv[i], you.inv[i]))
+            continue;
+        inv_sent = true;
+
         json_open_object(to_string(i));
         item_def item = you.inv[i];
         if (you.corrosion_amount() && is_weapon(item)
@@ -1246,28 +1493,33 @@ void TilesFramework::_send_player(bool force_full)
         json_close_object(true);
     }
     json_close_object(true);
+    if (inv_sent && !inv_stale)
+        ++m_player_section_sends[PSEC_INVENTORY];
 
-    _update_int(force_full, c.quiver_item,
-                (int8_t) you.quiver_action.get()->get_item(), "quiver_item");
+    if (_player_section_stale(PSEC_EQUIPMENT, force_full))
+    {
+        _update_int(force_full, c.quiver_item,
+                    (int8_t) you.quiver_action.get()->get_item(), "quiver_item");
 
-    _update_string(force_full, c.quiver_desc,
-                you.quiver_action.get()->quiver_description().to_colour_string(LIGHTGRAY),
-                "quiver_desc");
+        _update_string(force_full, c.quiver_desc,
+                    you.quiver_action.get()->quiver_description().to_colour_string(LIGHTGRAY),
+                    "quiver_desc");
 
-    item_def* weapon = you.weapon();
-    item_def* offhand = you.offhand_weapon();
-    _update_int(force_full, c.weapon_index, (int8_t) (weapon ? weapon->link : -1), "weapon_index");
-    _update_int(force_full, c.offhand_index, (int8_t) (offhand ? offhand->link : -1), "offhand_index");
-    _update_int(force_full, c.offhand_weapon, (bool) offhand, "offhand_weapon");
+        item_def* weapon = you.weapon();
+        item_def* offhand = you.offhand_weapon();
+        _update_int(force_full, c.weapon_index, (int8_t) (weapon ? weapon->link : -1), "weapon_index");
+        _update_int(force_full, c.offhand_index, (int8_t) (offhand ? offhand->link : -1), "offhand_index");
+        _update_int(force_full, c.offhand_weapon, (bool) offhand, "offhand_weapon");
 
-    _update_string(force_full, c.unarmed_attack,
-                   you.unarmed_attack_name(), "unarmed_attack");
-    _update_int(force_full, c.unarmed_attack_colour,
-                (uint8_t) get_form()->uc_colour, "unarmed_attack_colour");
-    _update_int(force_full, c.quiver_available,
-                    you.quiver_action.get()->is_valid()
-                                && you.quiver_action.get()->is_enabled(),
-                "quiver_available");
+        _update_string(force_full, c.unarmed_attack,
+                       you.unarmed_attack_name(), "unarmed_attack");
+        _update_int(force_full, c.unarmed_attack_colour,
+                    (uint8_t) get_form()->uc_colour, "unarmed_attack_colour");
+        _update_int(force_full, c.quiver_available,
+                        you.quiver_action.get()->is_valid()
+                                    && you.quiver_action.get()->is_enabled(),
+                    "quiver_available");
+    }
 
     json_close_object(true);
 
@@ -1839,6 +2091,8 @@ void TilesFramework::_mcache_ref(bool inc)
 
 void TilesFramework::_send_map(bool spectator_only)
 {
+    PROF_SCOPE(PROF_SEND_MAP);
+
     // TODO: prevent in some other / better way?
     if (_send_lock)
         return;
@@ -1848,6 +2102,7 @@ void TilesFramework::_send_map(bool spectator_only)
     map<uint32_t, coord_def> new_monster_locs;
 
     bool force_full = spectator_only || m_need_full_map;
+    transition_timer map_timer(TRANS_SEND_MAP, force_full && !spectator_only);
     m_need_full_map = false;
 
     json_open_object();
@@ -2266,6 +2521,29 @@ void TilesFramework::redraw()
 
     m_need_redraw = false;
     m_last_tick_redraw = get_milliseconds();
+
+    if (m_recorder.keyframe_due())
+        _record_keyframe();
+}
+
+void TilesFramework::_record_keyframe()
+{
+    // Anything _send_everything() sends that the client doesn't have yet
+    // would only reach the recording, so wait until the view is in sync.
+    if (!m_view_loaded || m_need_full_map || _send_lock)
+        return;
+
+    // The full player message would also change what later player messages
+    // are diffed against, which has to stay what the client was sent.
+    const player_info sent_info = m_current_player_info;
+    const auto section_sends = m_player_section_sends;
+    {
+        unwind_bool keyframe(m_recording_keyframe, true);
+        m_recorder.start_keyframe();
+        _send_everything();
+    }
+    m_current_player_info = sent_info;
+    m_player_section_sends = section_sends;
 }
 
 void TilesFramework::update_minimap(const coord_def& gc)
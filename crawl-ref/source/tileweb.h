@@ -36,6 +36,24 @@ enum WebtilesUIState
     UI_VIEW_MAP,
 };
 
+// Parts of the "player" message that are only recomputed when something
+// (usually one of the you.redraw_* flags) says they may have changed.
+enum player_section
+{
+    PSEC_TITLE,      // name, title, species, god, form
+    PSEC_HEALTH,     // hp, mp
+    PSEC_DEFENCES,   // ac, ev, sh
+    PSEC_ATTRIBUTES, // str, int, dex
+    PSEC_DOOM,
+    PSEC_CONTAM,
+    PSEC_EXPERIENCE,
+    PSEC_NOISE,
+    PSEC_STATUS,
+    PSEC_EQUIPMENT,  // quiver, wielded weapons, unarmed attack
+    PSEC_INVENTORY,
+    NUM_PLAYER_SECTIONS
+};
+
 struct player_info
 {
     player_info();
@@ -97,6 +115,35 @@ struct player_info
     int8_t offhand_index;
 };
 
+struct gzFile_s;
+
+// Writes the outgoing message stream to a gzipped file that the webtiles
+// server can replay. After a header line, each line holds one message,
+// prefixed by "d <ms> " if it was sent to the client, or by "K <ms> " (for
+// the first message) or "k <ms> " if it belongs to a keyframe: the full
+// state a joining spectator would get, which replay can seek to instead of
+// playing every message since the start of the game.
+class WebtilesRecorder
+{
+public:
+    WebtilesRecorder();
+    ~WebtilesRecorder();
+
+    bool open(const string &filename);
+    void close();
+    bool is_open() const { return m_file != nullptr; }
+
+    void record(const string &msg, bool keyframe);
+    bool keyframe_due() const;
+    void start_keyframe();
+
+private:
+    gzFile_s *m_file;
+    unsigned int m_start;
+    unsigned int m_last_keyframe;
+    bool m_keyframe_start;
+};
+
 class TilesFramework
 {
 public:
@@ -208,6 +255,7 @@ public:
     bool json_is_empty();
 
     string m_sock_name;
+    string m_record_name;
     bool m_await_connection;
 
     void set_text_cursor(bool enabled);
@@ -225,8 +273,17 @@ public:
 
     void send_doll(const dolls_data &doll, bool submerged, bool ghost);
     void send_milestone(const xlog_fields &xl);
+    void send_level_transition(const xlog_fields &xl);
     void send_options();
 
+    // Picks up the you.redraw_* flags before print_stats() clears them.
+    void note_player_redraw();
+    // How many times each section of the player message was recomputed.
+    int player_section_sends(player_section section) const
+    {
+        return m_player_section_sends[section];
+    }
+
 protected:
     int m_sock;
     int m_max_msg_size;
@@ -236,6 +293,11 @@ protected:
     bool m_controlled_from_web;
     bool m_need_flush;
 
+    WebtilesRecorder m_recorder;
+    // Messages go only to the recording while a keyframe is written.
+    bool m_recording_keyframe;
+    void _record_keyframe();
+
     bool _send_lock; // not thread safe
 
     void _await_connection();
@@ -313,6 +375,14 @@ protected:
     dolls_data last_player_doll;
 
     player_info m_current_player_info;
+    // Each section is recomputed when its generation differs from the one
+    // it was last sent at.
+    FixedVector<unsigned int, NUM_PLAYER_SECTIONS> m_player_gen;
+    FixedVector<unsigned int, NUM_PLAYER_SECTIONS> m_player_sent_gen;
+    FixedVector<int, NUM_PLAYER_SECTIONS> m_player_section_sends;
+    unsigned int m_inv_name_gen;
+    uint64_t m_inv_use_state;
+    bool _player_section_stale(player_section section, bool force_full);
 
     void _send_version();
     void _send_layout();
@@ -15,6 +15,7 @@
 #include "coordit.h"
 #include "corpse.h"
 #include "database.h"
+#include "dbg-prof.h"
 #include "delay.h"
 #include "dgn-shoals.h"
 #include "dgn-event.h"
@@ -770,6 +771,7 @@ void monster::timeout_enchantments(int levels)
  */
 void update_level(int elapsedTime)
 {
+    TRANSITION_PHASE(TRANS_UPDATE);
     ASSERT(!crawl_state.game_is_arena());
 
     const int turns = elapsedTime / 10;
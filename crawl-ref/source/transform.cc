@@ -1864,6 +1864,8 @@ void set_form(transformation which_trans, int dur, bool scale_hp)
     you.form = which_trans;
     you.duration[DUR_TRANSFORMATION] = max(1, dur * BASELINE_DELAY);
     update_player_symbol();
+    // Body size feeds into how items are annotated (one-/two-handed).
+    invalidate_item_names();
 
     const int str_mod = get_form(which_trans)->str_mod;
     const int dex_mod = get_form(which_trans)->dex_mod;
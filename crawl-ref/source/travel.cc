@@ -26,10 +26,12 @@
 #include "coordit.h"
 #include "daction-type.h"
 #include "dactions.h"
+#include "dbg-prof.h"
 #include "directn.h"
 #include "delay.h"
 #include "dgn-overview.h"
 #include "english.h"
+#include "errors.h"
 #include "env.h"
 #include "files.h"
 #include "format.h"
@@ -592,6 +594,7 @@ void travel_init_new_level()
     you.running = runmode;
 
     travel_init_load_level();
+    invalidate_travel_plan();
 
     explore_stopped_pos.reset();
 }
@@ -650,6 +653,7 @@ bool is_resting()
 
 static void _start_running()
 {
+    invalidate_travel_plan();
     _userdef_run_startrunning_hook();
     you.running.turns_passed = 0;
     const bool unsafe = Options.travel_one_unsafe_move &&
@@ -911,6 +915,155 @@ void explore_pickup_event(int did_pickup, int tried_pickup)
     }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+// travel_plan
+//
+// Travel floods the level backwards from the destination until it reaches the
+// player, which is by far the most expensive part of taking a travel step.
+// The flood that finds the first step has already found the whole route, so
+// remember it and walk it step by step for as long as nothing that the flood
+// depended on has changed. Changes to map knowledge and exclusions drop the
+// plan outright (see invalidate_travel_plan()); clouds and monsters are only
+// checked along the rest of the route.
+
+static travel_parent_grid _travel_parents;
+
+// Bitmask of player properties that change which squares travel considers
+// traversable.
+static unsigned int _travel_player_state()
+{
+    unsigned int state = 0;
+    if (you.permanent_flight())
+        state |= 1 << 0;
+    if (player_likes_water(true) || have_passive(passive_t::water_walk))
+        state |= 1 << 1;
+    if (you.is_web_immune())
+        state |= 1 << 2;
+    if (you.duration[DUR_NOXIOUS_BOG])
+        state |= 1 << 3;
+    if (actor_slime_wall_immune(&you))
+        state |= 1 << 4;
+    if (you.is_binding_sigil_immune())
+        state |= 1 << 5;
+    return state;
+}
+
+class travel_plan
+{
+public:
+    travel_plan() : valid(false), fallback(false), player_state(0),
+                    level(), dest(), route(), step(0)
+    {
+    }
+
+    void clear()
+    {
+        valid = false;
+        route.clear();
+        step = 0;
+    }
+
+    void build(const coord_def &youpos, const coord_def &first_move,
+               const coord_def &dst, bool used_fallback);
+    coord_def next_move(const coord_def &youpos, const coord_def &dst);
+
+private:
+    bool route_is_safe() const;
+
+private:
+    bool valid;
+    bool fallback;
+    unsigned int player_state;
+    level_id level;
+    coord_def dest;
+
+    // route[step] is where we expect the player to be; route.back() is the
+    // destination.
+    vector<coord_def> route;
+    size_t step;
+};
+
+static travel_plan _travel_plan;
+
+void invalidate_travel_plan()
+{
+    _travel_plan.clear();
+}
+
+// Rebuild the route from the parent grid filled in by the last pathfind().
+void travel_plan::build(const coord_def &youpos, const coord_def &first_move,
+                        const coord_def &dst, bool used_fallback)
+{
+    clear();
+    if (first_move.origin())
+        return;
+
+    route.push_back(youpos);
+    coord_def c = first_move;
+    while (true)
+    {
+        // Guard against a corrupt parent chain rather than looping forever.
+        if (!in_bounds(c) || route.size() > GXM * GYM)
+        {
+            clear();
+            return;
+        }
+        route.push_back(c);
+        if (c == dst)
+            break;
+        c = _travel_parents(c);
+    }
+
+    valid = true;
+    fallback = used_fallback;
+    player_state = _travel_player_state();
+    level = level_id::current();
+    dest = dst;
+    step = 1;
+}
+
+// Is the remainder of the route still something pathfind() would cross?
+bool travel_plan::route_is_safe() const
+{
+    unwind_bool slime_wall_check(g_Slime_Wall_Check,
+                                 !actor_slime_wall_immune(&you));
+
+    for (size_t i = step + 1; i + 1 < route.size(); ++i)
+        if (!is_travelsafe_square(route[i], false, false, fallback))
+            return false;
+
+    // Travel to traps is allowed if the player insists on it, as in
+    // travel_pathfind::pathfind().
+    return is_travelsafe_square(dest, false, false, true) || is_trap(dest);
+}
+
+// The next step along the cached route, or the origin if the plan can't be
+// used and the caller has to pathfind from scratch.
+coord_def travel_plan::next_move(const coord_def &youpos, const coord_def &dst)
+{
+    if (!valid)
+        return coord_def();
+
+    if (dst != dest || step + 1 >= route.size() || route[step] != youpos
+        || level != level_id::current()
+        || player_state != _travel_player_state())
+    {
+        clear();
+        return coord_def();
+    }
+
+    // pathfind() doesn't accept a first step onto an unsafe square either.
+    const coord_def next = route[step + 1];
+    if (!_is_safe_move(next) || !route_is_safe())
+    {
+        clear();
+        return coord_def();
+    }
+
+    ++step;
+    return next;
+}
+
 /**
  * Run the travel_pathfind algorithm with a destination with the aim of
  * determining the next travel move. Try to avoid to let travel (including
@@ -929,13 +1082,23 @@ void explore_pickup_event(int did_pickup, int tried_pickup)
  */
 static void _find_travel_pos(const coord_def& youpos, int *move_x, int *move_y)
 {
-    travel_pathfind tp;
+    coord_def dest = _travel_plan.next_move(youpos, you.running.pos);
+    if (dest.origin())
+    {
+        travel_pathfind tp;
 
-    tp.set_src_dst(youpos, you.running.pos);
+        tp.set_src_dst(youpos, you.running.pos);
+        tp.set_parent_grid(&_travel_parents);
 
-    coord_def dest = tp.pathfind(RMODE_TRAVEL, false);
-    if (dest.origin())
-        dest = tp.pathfind(RMODE_TRAVEL, true);
+        bool fallback = false;
+        dest = tp.pathfind(RMODE_TRAVEL, false);
+        if (dest.origin())
+        {
+            fallback = true;
+            dest = tp.pathfind(RMODE_TRAVEL, true);
+        }
+        _travel_plan.build(youpos, dest, you.running.pos, fallback);
+    }
     coord_def new_dest = dest;
 
     // We'd either have to travel through a runed door, in which case we'll be
@@ -1319,7 +1482,8 @@ travel_pathfind::travel_pathfind()
       need_for_greed(false), autopickup(false),
       unexplored_place(), greedy_place(), unexplored_dist(0), greedy_dist(0),
       refdist(nullptr), reseed_points(), features(nullptr), unreachables(),
-      point_distance(travel_point_distance), next_iter_points(0),
+      point_distance(travel_point_distance), parent_grid(nullptr),
+      next_iter_points(0),
       traveled_distance(0), circ_index(0)
 {
 }
@@ -1388,6 +1552,8 @@ const coord_def travel_pathfind::explore_target() const
 // Allison - used with his permission.
 coord_def travel_pathfind::pathfind(run_mode_type rmode, bool fallback_explore)
 {
+    PROF_SCOPE(PROF_TRAVEL_PATHFIND);
+
     unwind_bool saved_ipt(ignore_player_traversability);
 
     if (rmode == RMODE_INTERLEVEL)
@@ -1829,6 +1995,8 @@ bool travel_pathfind::path_flood(const coord_def &c, const coord_def &dc)
         // iteration
         circumference[!circ_index][next_iter_points++] = dc;
         point_distance[dc.x][dc.y] = traveled_distance;
+        if (parent_grid)
+            (*parent_grid)(dc) = c;
 
         // Negative distances here so that show_map can colour
         // the map differently for these squares.
@@ -3243,8 +3411,19 @@ static int _find_transtravel_stair(const level_id &cur,
     return local_distance;
 }
 
+static void _collect_stair_distances(const level_pos &target);
+
 static bool _loadlev_populate_stair_distances(const level_pos &target)
 {
+    // The travel cache remembers enough to do this without loading the
+    // level, unless it was last updated by an older version.
+    if (travel_cache.get_level_info(target.id).fill_travel_distances(
+                                                                target.pos))
+    {
+        _collect_stair_distances(target);
+        return true;
+    }
+
     level_excursion excursion;
     excursion.go_to(target.id);
     _populate_stair_distances(target);
@@ -3255,7 +3434,12 @@ static void _populate_stair_distances(const level_pos &target)
 {
     // Populate travel_point_distance.
     fill_travel_point_distance(target.pos);
+    _collect_stair_distances(target);
+}
 
+// Record the travel_point_distance of each stair on the target's level.
+static void _collect_stair_distances(const level_pos &target)
+{
     curr_stairs.clear();
     for (stair_info si : travel_cache.get_level_info(target.id).get_stairs())
     {
@@ -3680,6 +3864,8 @@ void LevelInfo::update()
     get_transporters(transporter_positions);
     correct_transporter_list(transporter_positions);
 
+    update_travel_grid();
+
     update_daction_counters(this);
 }
 
@@ -3719,6 +3905,73 @@ void LevelInfo::update_stair_distances()
         set_distance_between_stairs(nstairs - 1, nstairs - 1, 0);
 }
 
+void LevelInfo::update_travel_grid()
+{
+    travel_costs.init(0);
+    for (rectangle_iterator ri(1); ri; ++ri)
+    {
+        if (is_travelsafe_square(*ri, false))
+        {
+            travel_costs(*ri) =
+                _feature_traverse_cost(env.map_knowledge(*ri).feat());
+        }
+    }
+    has_travel_grid = true;
+}
+
+// The same flood as travel_pathfind::pathfind() in floodout mode, but over
+// the squares recorded by update_travel_grid().
+bool LevelInfo::fill_travel_distances(const coord_def &pos) const
+{
+    if (!has_travel_grid || !in_bounds(pos))
+        return false;
+
+    memset(travel_point_distance, 0, sizeof(travel_distance_grid_t));
+
+    vector<coord_def> circumference(1, pos), next;
+    auto flood = [&](const coord_def &dc, int dist)
+    {
+        if (!in_bounds(dc) || travel_point_distance[dc.x][dc.y]
+            || !travel_costs(dc))
+        {
+            return;
+        }
+        travel_point_distance[dc.x][dc.y] = dist;
+        next.push_back(dc);
+    };
+
+    for (int dist = 1; !circumference.empty(); ++dist)
+    {
+        for (const coord_def &c : circumference)
+        {
+            // Wait on squares that take more than one move to cross, as
+            // square_slows_movement() does.
+            const int cost = travel_costs(c);
+            if (cost > 1 && travel_point_distance[c.x][c.y] > dist - cost)
+            {
+                next.push_back(c);
+                continue;
+            }
+
+            for (int dir = 0; dir < 8; (dir += 2) == 8 && (dir = 1))
+                flood(c + Compass[dir], dist);
+
+            for (const transporter_info &ti : transporters)
+            {
+                if (ti.position == c && ti.destination != INVALID_COORD
+                    && (!is_excluded(c, excludes)
+                        || adjacent(c, ti.destination)))
+                {
+                    flood(ti.destination, dist);
+                }
+            }
+        }
+        circumference.swap(next);
+        next.clear();
+    }
+    return true;
+}
+
 void LevelInfo::update_transporter(const coord_def& transpos,
                                    const coord_def& dest)
 {
@@ -4088,6 +4341,10 @@ void LevelInfo::save(writer& outf) const
 
     marshallExcludes(outf, excludes);
 
+    marshallBoolean(outf, has_travel_grid);
+    if (has_travel_grid)
+        marshall_travel_grid(outf, travel_costs);
+
     marshallByte(outf, NUM_DACTION_COUNTERS);
     for (int i = 0; i < NUM_DACTION_COUNTERS; i++)
         marshallShort(outf, daction_counters[i]);
@@ -4138,12 +4395,62 @@ void LevelInfo::load(reader& inf, int minorVersion)
 
     unmarshallExcludes(inf, minorVersion, excludes);
 
+    has_travel_grid = false;
+#if TAG_MAJOR_VERSION == 34
+    if (minorVersion >= TAG_MINOR_TRAVEL_GRID)
+#endif
+    has_travel_grid = unmarshallBoolean(inf);
+    travel_costs.init(0);
+    if (has_travel_grid)
+        unmarshall_travel_grid(inf, travel_costs);
+
     int n_count = unmarshallByte(inf);
     ASSERT_RANGE(n_count, 0, NUM_DACTION_COUNTERS + 1);
     for (int i = 0; i < n_count; i++)
         daction_counters[i] = unmarshallShort(inf);
 }
 
+// A travel grid is mostly long runs of walls and of plain floor, so the
+// cells inside the map border are saved as (cost, run length) pairs.
+void marshall_travel_grid(writer &th,
+                          const FixedArray<uint8_t, GXM, GYM> &costs)
+{
+    rectangle_iterator ri(1);
+    while (ri)
+    {
+        const uint8_t cost = costs(*ri);
+        uint64_t run = 0;
+        for (; ri && costs(*ri) == cost; ++ri)
+            ++run;
+        marshallUByte(th, cost);
+        marshallUnsigned(th, run);
+    }
+}
+
+void unmarshall_travel_grid(reader &th, FixedArray<uint8_t, GXM, GYM> &costs)
+{
+#if TAG_MAJOR_VERSION == 34
+    if (th.getMinorVersion() < TAG_MINOR_TRAVEL_GRID_RLE)
+    {
+        for (rectangle_iterator ri(1); ri; ++ri)
+            costs(*ri) = unmarshallUByte(th);
+        return;
+    }
+#endif
+    rectangle_iterator ri(1);
+    while (ri)
+    {
+        const uint8_t cost = unmarshallUByte(th);
+        uint64_t run = unmarshallUnsigned(th);
+        if (!run)
+            throw corrupted_save("empty run in a travel grid");
+        for (; ri && run; ++ri, --run)
+            costs(*ri) = cost;
+        if (run)
+            throw corrupted_save("travel grid runs past the map");
+    }
+}
+
 void LevelInfo::fixup()
 {
     // The only fixup we do now is for the hell entry.
@@ -79,6 +79,10 @@ bool is_unknown_transporter(const coord_def &p);
 void fill_travel_point_distance(const coord_def& youpos,
                      vector<coord_def>* coords = nullptr);
 
+// Forget the cached travel route so that the next travel step re-floods the
+// level. Call this whenever map knowledge or exclusions change.
+void invalidate_travel_plan();
+
 bool is_stair_exclusion(const coord_def &p);
 
 /* ***********************************************************************
@@ -155,6 +159,9 @@ const int PD_CLOUD = -20101;
  * *********************************************************************** */
 extern travel_distance_grid_t travel_point_distance;
 
+// For each square reached by a travel flood, the square it was reached from.
+typedef FixedArray<coord_def, GXM, GYM> travel_parent_grid;
+
 ////////////////////////////////////////////////////////////////////////////
 // Structs for interlevel travel.
 
@@ -280,9 +287,11 @@ public:
 // Information on a level that interlevel travel needs.
 struct LevelInfo
 {
-    LevelInfo() : stairs(), excludes(), stair_distances(), id()
+    LevelInfo() : stairs(), excludes(), stair_distances(),
+                  has_travel_grid(false), id()
     {
         daction_counters.init(0);
+        travel_costs.init(0);
     }
 
     void save(writer&) const;
@@ -318,6 +327,11 @@ struct LevelInfo
     // or does not exist in our list of stairs, returns 0.
     int distance_between(const stair_info *s1, const stair_info *s2) const;
 
+    // Fills travel_point_distance as fill_travel_point_distance(pos) would
+    // on this level, from what travel knew when the player last left it,
+    // without loading the level. Returns false if that isn't known.
+    bool fill_travel_distances(const coord_def &pos) const;
+
     void update_excludes();
     void update();              // Update LevelInfo to be correct for the
                                 // current level.
@@ -345,6 +359,7 @@ private:
     void correct_stair_list(const vector<coord_def> &s);
     void correct_transporter_list(const vector<coord_def> &s);
     void update_stair_distances();
+    void update_travel_grid();
     void sync_all_branch_stairs();
     void sync_branch_stairs(const stair_info *si);
     void set_distance_between_stairs(int a, int b, int dist);
@@ -358,6 +373,12 @@ private:
     exclude_set excludes;
 
     vector<short> stair_distances;  // Dist between stairs
+
+    // How many moves travel takes to cross each square, or 0 where it won't
+    // go, as of the last update().
+    bool has_travel_grid;
+    FixedArray<uint8_t, GXM, GYM> travel_costs;
+
     level_id id;
 
     friend class TravelCache;
@@ -485,6 +506,13 @@ public:
         ignore_danger = true;
     }
 
+    // Record, for every square the flood reaches, the square it was reached
+    // from, so that the whole route can be recovered after pathfind().
+    inline void set_parent_grid(travel_parent_grid *parents)
+    {
+        parent_grid = parents;
+    }
+
     // Determine if the level is fully explored, when called after pathfind().
     int explore_status();
 
@@ -557,6 +585,8 @@ protected:
 
     travel_distance_col *point_distance;
 
+    travel_parent_grid *parent_grid;
+
     // How many points we'll consider next iteration.
     int next_iter_points;
 
@@ -595,3 +625,7 @@ void clear_travel_trail();
 int travel_trail_index(const coord_def& gc);
 
 bool stairs_destination_is_excluded(const stair_info &si);
+
+void marshall_travel_grid(writer &th,
+                          const FixedArray<uint8_t, GXM, GYM> &costs);
+void unmarshall_travel_grid(reader &th, FixedArray<uint8_t, GXM, GYM> &costs);
@@ -637,6 +637,7 @@ void Text::set_text(const formatted_string &fs)
         return;
     m_text.clear();
     m_text += fs;
+    m_wrap_cache.clear();
     _invalidate_sizereq();
     _expose();
     m_wrapped_size = Size(-1);
@@ -650,6 +651,7 @@ void Text::set_font(FontWrapper *font)
         return;
     ASSERT(font);
     m_font = font;
+    m_wrap_cache.clear();
     _queue_allocation();
 }
 #endif
@@ -661,6 +663,25 @@ void Text::set_highlight_pattern(string pattern, bool line)
     _expose();
 }
 
+Text::wrap_cache_entry *Text::_find_wrap(int width, int height)
+{
+    for (auto &entry : m_wrap_cache)
+        if (entry.width == width && entry.height == height)
+            return &entry;
+    return nullptr;
+}
+
+Text::wrap_cache_entry &Text::_add_wrap(int width, int height)
+{
+    const size_t max_cached_wraps = 4;
+    if (m_wrap_cache.size() >= max_cached_wraps)
+        m_wrap_cache.erase(m_wrap_cache.begin());
+    m_wrap_cache.emplace_back();
+    m_wrap_cache.back().width = width;
+    m_wrap_cache.back().height = height;
+    return m_wrap_cache.back();
+}
+
 void Text::wrap_text_to_size(int width, int height)
 {
     // don't recalculate if the previous calculation imposed no constraints
@@ -686,7 +707,15 @@ void Text::wrap_text_to_size(int width, int height)
 
 #ifdef USE_TILE_LOCAL
     if (wrap_text || ellipsize)
-        m_text_wrapped = m_font->split(m_text, width, height);
+    {
+        wrap_cache_entry *wrap = _find_wrap(width, height);
+        if (!wrap)
+        {
+            wrap = &_add_wrap(width, height);
+            wrap->text = m_font->split(m_text, width, height);
+        }
+        m_text_wrapped = wrap->text;
+    }
     else
         m_text_wrapped = m_text;
 
@@ -712,8 +741,14 @@ void Text::wrap_text_to_size(int width, int height)
     m_wrapped_size.height = m_font->string_height(m_text_wrapped);
     m_wrapped_size.width = m_font->string_width(m_text_wrapped);
 #else
-    m_wrapped_lines.clear();
-    formatted_string::parse_string_to_multiple(m_text.to_colour_string(), m_wrapped_lines, width);
+    // the height only matters for the ellipsis, which is added afterwards
+    wrap_cache_entry *wrap = _find_wrap(width, 0);
+    if (!wrap)
+    {
+        wrap = &_add_wrap(width, 0);
+        m_text.wrap_to_multiple(wrap->lines, width);
+    }
+    m_wrapped_lines = wrap->lines;
     // add ellipsis to last line of text if necessary
     if (height < (int)m_wrapped_lines.size())
     {
@@ -731,7 +766,7 @@ void Text::wrap_text_to_size(int width, int height)
     if (width <= 0)
     {
         // only bother recalculating if there was no requested width --
-        // parse_string_to_multiple will exactly obey any explicit width value
+        // wrap_to_multiple will exactly obey any explicit width value
         int max_width = 0;
         for (auto &fs : m_wrapped_lines)
             max_width = max(max_width, fs.width());
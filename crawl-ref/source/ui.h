@@ -789,10 +789,26 @@ public:
 protected:
     void wrap_text_to_size(int width, int height);
 
+    // Layout asks for the same text at a handful of sizes (the preferred
+    // height at a few widths, then the allocated size), so the most recent
+    // wraps are kept until the text or font changes.
+    struct wrap_cache_entry
+    {
+        int width, height;
+#ifdef USE_TILE_LOCAL
+        formatted_string text;
+#else
+        vector<formatted_string> lines;
+#endif
+    };
+    wrap_cache_entry *_find_wrap(int width, int height);
+    wrap_cache_entry &_add_wrap(int width, int height);
+
     bool wrap_text = false;
     bool ellipsize = false;
 
     formatted_string m_text;
+    vector<wrap_cache_entry> m_wrap_cache;
 #ifdef USE_TILE_LOCAL
     struct brkpt { unsigned int op, line; };
     vector<brkpt> m_brkpts;
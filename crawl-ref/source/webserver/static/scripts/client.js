@@ -1407,6 +1407,7 @@ function (exports, $, key_conversion, chat, comm) {
 
         var watch = location.hash.match(/^#watch-(.+)/i);
         var play = location.hash.match(/^#play-(.+)/i);
+        var replay = location.hash.match(/^#replay-([^\/]+)\/(.+)/i);
         if (watch)
         {
             var watch_user = watch[1];
@@ -1414,6 +1415,13 @@ function (exports, $, key_conversion, chat, comm) {
                 username: watch_user
             });
         }
+        else if (replay)
+        {
+            send_message("replay", {
+                username: replay[1],
+                filename: replay[2]
+            });
+        }
         else if (play)
         {
             var game_id = play[1];
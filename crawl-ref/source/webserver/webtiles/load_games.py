@@ -214,7 +214,7 @@ def validate_game_dict(game):
     optional = ('dir_path', 'cwd', 'morgue_url', 'milestone_path',
                 'send_json_options', 'options', 'env', 'separator',
                 'show_save_info', 'allowed_with_hold', 'version',
-                'template', 'pre_options', 'client_path')
+                'template', 'pre_options', 'client_path', 'wtrec_path')
     # XX less ad hoc typing
     boolean = ('send_json_options', 'show_save_info', 'allowed_with_hold')
     string_array = ('options', 'pre_options')
@@ -98,6 +98,9 @@ def watch_socket_dirs():
         watcher.watch(socket_dir, handle_new_socket)
 
 class CrawlProcessHandlerBase(object):
+    # whether spectators can find this game in the lobby
+    listed_in_lobby = True
+
     def __init__(self, game_params, username, logger):
         self.game_params = game_params
         self.username = username
@@ -123,6 +126,8 @@ class CrawlProcessHandlerBase(object):
         self.where = {}
         self.wheretime = 0
         self.last_milestone = None
+        self.last_profile = None
+        self.last_level_transition = None
         self.kill_timeout = None
 
         self.blocked = set()
@@ -174,7 +179,7 @@ class CrawlProcessHandlerBase(object):
     def check_idle(self):
         if self.is_idle() != self._was_idle:
             self._was_idle = self.is_idle()
-            if config.get('dgl_mode'):
+            if config.get('dgl_mode') and self.listed_in_lobby:
                 update_all_lobbys(self)
 
     def flush_messages_to_all(self):
@@ -570,7 +575,7 @@ class CrawlProcessHandlerBase(object):
                          count = self.watcher_count(),
                          names = s)
 
-        if config.get('dgl_mode'):
+        if config.get('dgl_mode') and self.listed_in_lobby:
             update_all_lobbys(self)
 
     def add_watcher(self, watcher):
@@ -932,6 +937,11 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
         if ttyrec_path and config.get('enable_ttyrecs'):
             self.ttyrec_filename = os.path.join(ttyrec_path, self.lock_basename)
 
+        wtrec_path = self.config_path("wtrec_path")
+        if wtrec_path:
+            call += ["-webtiles-record",
+                     os.path.join(wtrec_path, self.formatted_time + ".wtrec")]
+
         processes[os.path.abspath(self.socketpath)] = self
 
         if config.get('dgl_mode'):
@@ -1196,6 +1206,28 @@ class CrawlProcessHandler(CrawlProcessHandlerBase):
                 # message
                 self.receiving_direct_milestones = True # no need for .where files
                 self.set_where_info(msgobj)
+            elif msgobj["msg"] == "profile":
+                # subsystem timings, sent periodically by crawl builds with
+                # PROFILE_COUNTERS
+                self.last_profile = msgobj
+                sections = msgobj.get("sections", {})
+                self.logger.info("Profile over %d turns: %s",
+                                 msgobj.get("turns", 0),
+                                 ", ".join("%s %.0fms" % (name, s["total_ms"])
+                                           for name, s in sections.items()))
+            elif msgobj["msg"] == "level_transition":
+                # per-phase timings of a change of level, sent by crawl
+                # processes started with -transition-timing
+                self.last_level_transition = msgobj
+                phases = ", ".join("%s %sms" % (key[:-3], value)
+                                   for key, value in sorted(msgobj.items())
+                                   if key.endswith("_ms"))
+                self.logger.info("Level transition %s -> %s%s: %sms (%s)",
+                                 msgobj.get("oplace", "?"),
+                                 msgobj.get("place", "?"),
+                                 " (new level)" if msgobj.get("new") == "1"
+                                 else "",
+                                 msgobj.get("ms", "?"), phases)
             else:
                 self.logger.warning("Unknown message from the crawl process: %s",
                                     msgobj["msg"])
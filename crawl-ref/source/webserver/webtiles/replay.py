@@ -0,0 +1,297 @@
+import bisect
+import collections
+import gzip
+import os.path
+
+from tornado.escape import json_decode
+from tornado.ioloop import IOLoop
+
+from webtiles import config
+from webtiles.process_handler import CrawlProcessHandlerBase
+
+try:
+    from typing import List, Optional, Tuple
+except ImportError:
+    pass
+
+# Replays skip any pause in the recording longer than this (in ms), the way
+# ttyrec players do.
+MAX_REPLAY_DELAY = 3000
+
+# How many loaded recordings to keep for other viewers.
+MAX_SHARED_RECORDINGS = 8
+
+def find_recording(username, filename):
+    # type: (str, str) -> Tuple[Optional[config.GameConfig], Optional[str]]
+    """Find a user's recording, and the game it was recorded with."""
+    if (not filename.endswith(".wtrec")
+            or os.path.basename(filename) != filename):
+        return None, None
+    for game in config.games.values():
+        wtrec_path = game.templated("wtrec_path", username=username)
+        if not wtrec_path:
+            continue
+        path = os.path.join(wtrec_path, filename)
+        if os.path.isfile(path):
+            return game, path
+    return None, None
+
+def _read_lines(filename):
+    """Yield the lines of a gzipped file, stopping quietly where it ends.
+
+    A game that is still going, or that crashed, leaves a file with no gzip
+    trailer; everything up to its last sync flush can still be read."""
+    with gzip.open(filename, "rb") as f:
+        try:
+            for line in f:
+                yield line
+        except EOFError:
+            pass
+
+def read_recording(filename):
+    # type: (str) -> Tuple[dict, List[Tuple[str, int, str]]]
+    """Read a recording's header and its (kind, ms, message) frames.
+
+    The last line of an unfinished recording may have been cut off part way
+    through, so a final line that is incomplete or doesn't parse is dropped,
+    as is a keyframe at the very end that may not have been written out in
+    full. Anything else that doesn't parse raises ValueError."""
+    header = None
+    frames = [] # type: List[Tuple[str, int, str]]
+    error = None # type: Optional[ValueError]
+    for line in _read_lines(filename):
+        if error:
+            raise error
+        try:
+            if not line.endswith(b"\n"):
+                raise ValueError("incomplete line")
+            text = line[:-1].decode("utf-8")
+            if header is None:
+                header = json_decode(text)
+                continue
+            kind, ms, msg = text.split(" ", 2)
+            if kind not in ("d", "K", "k"):
+                raise ValueError("unknown frame kind %r" % kind)
+            frames.append((kind, int(ms), msg))
+        except ValueError as e:
+            error = e
+    if header is None:
+        raise error or ValueError("empty recording")
+    while frames and frames[-1][0] != "d":
+        frames.pop()
+    return header, frames
+
+class Recording(object):
+    """A recording as read from disk, shared by everyone replaying it."""
+    def __init__(self, filename):
+        self.header, self.frames = read_recording(filename)
+        self.times = [ms for kind, ms, msg in self.frames] # type: List[int]
+        self.keyframes = [i for i, (kind, ms, msg) in enumerate(self.frames)
+                          if kind == "K"] # type: List[int]
+
+# path -> ((mtime, size), Future[Recording]), oldest first
+_recordings = collections.OrderedDict() # type: collections.OrderedDict
+
+def load_recording(path):
+    """Read a recording in a worker thread, so that a large one doesn't hold
+    up the IOLoop. Everyone asking for the same file, as long as it hasn't
+    changed since (unfinished games keep growing), shares one load.
+
+    Returns a Future of the Recording."""
+    st = os.stat(path)
+    version = (st.st_mtime, st.st_size)
+    entry = _recordings.get(path)
+    if entry and entry[0] == version:
+        _recordings.move_to_end(path)
+        return entry[1]
+
+    future = IOLoop.current().run_in_executor(None, Recording, path)
+    _recordings[path] = (version, future)
+
+    def forget_failure(f):
+        if f.exception() and _recordings.get(path, (None, None))[1] is f:
+            del _recordings[path]
+    future.add_done_callback(forget_failure)
+
+    while len(_recordings) > MAX_SHARED_RECORDINGS:
+        _recordings.popitem(last=False)
+    return future
+
+class ReplayHandler(CrawlProcessHandlerBase):
+    """Plays a webtiles recording (written by crawl's -webtiles-record) to
+    spectators, as if they were watching the game live.
+
+    A recording is a gzipped file with a JSON header line, then one line per
+    message the game sent: "d <ms> <message>" for the message stream itself,
+    and "K <ms> <message>" followed by "k <ms> <message>" lines for a
+    keyframe, a full snapshot of the game's state. Playback skips keyframes;
+    seeking sends the latest keyframe before the target time and then the
+    messages between the two.
+    """
+    listed_in_lobby = False
+
+    def __init__(self, game_params, username, logger, filename, recording):
+        super(ReplayHandler, self).__init__(game_params, username, logger)
+        self.idle_checker.stop()
+        self.filename = filename
+        # these are shared with other replays of the file, so never change
+        self.header = recording.header
+        self.frames = recording.frames
+        self.times = recording.times
+        self.keyframes = recording.keyframes
+        self.position = 0
+        self.speed = 1.0
+        self.paused = False
+        self.timeout = None
+
+    def length(self):
+        return self.frames[-1][1] if self.frames else 0
+
+    def current_time(self):
+        if self.position >= len(self.frames):
+            return self.length()
+        return self.frames[self.position][1]
+
+    def _send_frame(self, msg, receivers):
+        if not msg.startswith("*"):
+            for receiver in receivers:
+                receiver.append_message(msg, False)
+            return
+        msgobj = json_decode(msg[1:])
+        if msgobj["msg"] == "client_path":
+            if self.client_path is None:
+                self.client_path = self.format_path(msgobj["path"])
+                self.crawl_version = msgobj.get("version")
+                self.send_client_to_all()
+        elif msgobj["msg"] == "flush_messages":
+            for receiver in receivers:
+                receiver.flush_messages()
+
+    def _schedule(self, delay):
+        if self.timeout:
+            IOLoop.current().remove_timeout(self.timeout)
+            self.timeout = None
+        if self.paused or not self._receivers:
+            return
+        if self.position >= len(self.frames):
+            self._notify_all("End of the recording.")
+            return
+        self.timeout = IOLoop.current().call_later(delay / 1000.0, self._play)
+
+    def _play(self):
+        self.timeout = None
+        now = self.current_time()
+        while (self.position < len(self.frames)
+               and self.frames[self.position][1] <= now):
+            kind, ms, msg = self.frames[self.position]
+            if kind == "d":
+                self._send_frame(msg, self._receivers)
+            self.position += 1
+        self.flush_messages_to_all()
+        delay = self.current_time() - now
+        self._schedule(min(delay, MAX_REPLAY_DELAY) / self.speed)
+
+    def _send_state(self, end, receivers):
+        """Bring receivers to the state after the frames before end: send the
+        last keyframe before end, then the messages between the two."""
+        k = bisect.bisect_left(self.keyframes, end)
+        pos = 0
+        if k > 0:
+            pos = self.keyframes[k - 1]
+            self._send_frame(self.frames[pos][2], receivers)
+            pos += 1
+            while pos < len(self.frames) and self.frames[pos][0] == "k":
+                self._send_frame(self.frames[pos][2], receivers)
+                pos += 1
+        for kind, ms, msg in self.frames[pos:end]:
+            if kind == "d":
+                self._send_frame(msg, receivers)
+        for receiver in receivers:
+            receiver.flush_messages()
+
+    def seek(self, ms):
+        ms = max(0, min(ms, self.length()))
+        self.position = bisect.bisect_right(self.times, ms)
+        self._send_state(self.position, self._receivers)
+        self._schedule(min(self.current_time() - ms, MAX_REPLAY_DELAY)
+                       / self.speed)
+
+    def _notify_all(self, text):
+        for receiver in self._receivers:
+            if receiver.username:
+                self.handle_notification(receiver.username, text)
+
+    def add_watcher(self, watcher):
+        super(ReplayHandler, self).add_watcher(watcher)
+        # a new spectator needs the whole state, not just what comes next
+        self._send_state(self.position, [watcher])
+        if not self.timeout:
+            self._schedule(0)
+
+    def remove_watcher(self, watcher):
+        super(ReplayHandler, self).remove_watcher(watcher)
+        if not self._receivers:
+            self._schedule(0)
+
+    def chat_command_help(self, source):
+        super(ReplayHandler, self).chat_command_help(source)
+        self.chat_help_message(source, "/seek [+|-]<mm:ss>",
+                               "jump to a time in the recording")
+        self.chat_help_message(source, "/speed <factor>",
+                               "play faster or slower")
+        self.chat_help_message(source, "/pause", "pause or resume playback")
+
+    def handle_chat_command(self, source_ws, text):
+        # type: (CrawlWebSocket, str) -> bool
+        if super(ReplayHandler, self).handle_chat_command(source_ws, text):
+            return True
+        splitlist = text.strip().split(None, 1)
+        if not splitlist:
+            return False
+        command = splitlist[0].lower()
+        arg = splitlist[1].strip() if len(splitlist) > 1 else ""
+        source = source_ws.username
+        if command == "/seek":
+            try:
+                offset = parse_time(arg.lstrip("+-"))
+            except ValueError:
+                self.handle_notification(source, "Usage: /seek [+|-]<mm:ss>")
+                return True
+            if arg.startswith("+"):
+                offset = self.current_time() + offset
+            elif arg.startswith("-"):
+                offset = self.current_time() - offset
+            self.seek(offset)
+            offset = max(0, min(offset, self.length()))
+            self.handle_notification(source, "Seeked to %s of %s." %
+                                     (format_time(offset),
+                                      format_time(self.length())))
+        elif command == "/speed":
+            try:
+                self.speed = max(0.1, min(float(arg), 100.0))
+            except ValueError:
+                self.handle_notification(source, "Usage: /speed <factor>")
+                return True
+            self.handle_notification(source, "Playing at %gx." % self.speed)
+        elif command == "/pause":
+            self.paused = not self.paused
+            self._schedule(0)
+            self.handle_notification(source, "Paused." if self.paused
+                                             else "Resumed.")
+        else:
+            return False
+        return True
+
+    def handle_input(self, msg):
+        pass
+
+def parse_time(text):
+    """Parse [[h:]m:]s into milliseconds."""
+    seconds = 0
+    for part in text.split(":"):
+        seconds = seconds * 60 + int(part)
+    return seconds * 1000
+
+def format_time(ms):
+    seconds = ms // 1000
+    return "%d:%02d:%02d" % (seconds // 3600, seconds // 60 % 60, seconds % 60)
@@ -0,0 +1,110 @@
+import asyncio
+import gzip
+import zlib
+
+import pytest
+
+from webtiles import replay
+
+HEADER = b'{"version": "test"}\n'
+FRAMES = [
+    b"d 0 {\"msg\":\"map\"}\n",
+    b"K 10 {\"msg\":\"player\"}\n",
+    b"k 10 {\"msg\":\"map\"}\n",
+    b"d 20 {\"msg\":\"msgs\"}\n",
+]
+
+
+def write_unfinished(path, *chunks):
+    """Write chunks the way a game that hasn't closed its recording leaves
+    them: each sync-flushed, with no end-of-stream marker or gzip trailer."""
+    compressor = zlib.compressobj(wbits=31)
+    with open(str(path), "wb") as f:
+        for chunk in chunks:
+            f.write(compressor.compress(chunk))
+            f.write(compressor.flush(zlib.Z_SYNC_FLUSH))
+
+
+class Test_read_recording:
+    def test_complete_recording(self, tmp_path):
+        path = tmp_path / "game.wtrec"
+        with gzip.open(str(path), "wb") as f:
+            f.write(HEADER + b"".join(FRAMES))
+        header, frames = replay.read_recording(str(path))
+        assert header == {"version": "test"}
+        assert frames == [("d", 0, '{"msg":"map"}'),
+                          ("K", 10, '{"msg":"player"}'),
+                          ("k", 10, '{"msg":"map"}'),
+                          ("d", 20, '{"msg":"msgs"}')]
+
+    def test_unfinished_recording(self, tmp_path):
+        path = tmp_path / "game.wtrec"
+        write_unfinished(path, HEADER, b"".join(FRAMES))
+        header, frames = replay.read_recording(str(path))
+        assert header == {"version": "test"}
+        assert len(frames) == 4
+
+    @pytest.mark.parametrize("tail", [
+        b"d 30 {\"msg\":\"ma",  # cut off mid-line
+        b"d 3",
+        b"d 30\n",  # no message
+        b"x 30 {}\n",
+        b"d 30 \xe2\x80",  # cut off mid-character
+    ])
+    def test_bad_last_line_is_dropped(self, tmp_path, tail):
+        path = tmp_path / "game.wtrec"
+        write_unfinished(path, HEADER, b"".join(FRAMES), tail)
+        header, frames = replay.read_recording(str(path))
+        assert len(frames) == 4
+        assert frames[-1] == ("d", 20, '{"msg":"msgs"}')
+
+    def test_unfinished_keyframe_is_dropped(self, tmp_path):
+        path = tmp_path / "game.wtrec"
+        write_unfinished(path, HEADER, b"".join(FRAMES[:3]))
+        header, frames = replay.read_recording(str(path))
+        assert frames == [("d", 0, '{"msg":"map"}')]
+
+    def test_bad_line_in_the_middle_raises(self, tmp_path):
+        path = tmp_path / "game.wtrec"
+        write_unfinished(path, HEADER, b"d 3\n", b"".join(FRAMES))
+        with pytest.raises(ValueError):
+            replay.read_recording(str(path))
+
+    def test_truncated_header_raises(self, tmp_path):
+        path = tmp_path / "game.wtrec"
+        write_unfinished(path, HEADER[:5])
+        with pytest.raises(ValueError):
+            replay.read_recording(str(path))
+
+
+class Test_load_recording:
+    def test_shared_until_the_file_changes(self, tmp_path):
+        path = str(tmp_path / "game.wtrec")
+        write_unfinished(path, HEADER, b"".join(FRAMES))
+
+        async def load():
+            first = replay.load_recording(path)
+            assert replay.load_recording(path) is first
+            recording = await first
+            assert recording.times == [0, 10, 10, 20]
+            assert recording.keyframes == [1]
+
+            write_unfinished(path, HEADER, b"".join(FRAMES),
+                             b"d 30 {\"msg\":\"map\"}\n")
+            second = replay.load_recording(path)
+            assert second is not first
+            assert len((await second).frames) == 5
+
+        asyncio.run(load())
+
+    def test_failed_loads_are_retried(self, tmp_path):
+        path = str(tmp_path / "game.wtrec")
+        write_unfinished(path, HEADER[:5])
+
+        async def load():
+            first = replay.load_recording(path)
+            with pytest.raises(ValueError):
+                await first
+            assert replay.load_recording(path) is not first
+
+        asyncio.run(load())
@@ -292,6 +292,8 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
         self.timeout = None
         self.lobby_timeout = None
         self.watched_game = None
+        # bumped to abandon a replay that is still loading
+        self.replay_request = 0
         self.process = None
         self.game_id = None
         self.received_pong = None
@@ -329,6 +331,7 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
             "play": self.start_crawl,
             "pong": self.pong,
             "watch": self.watch,
+            "replay": self.replay,
             "chat_msg": self.post_chat_message,
             "register": self.register,
             "start_change_email": self.start_change_email,
@@ -1041,6 +1044,7 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
         checkoutput.check_output(call, do_send)
 
     def watch(self, username):
+        self.replay_request += 1
         if self.is_running():
             self.process.stop()
 
@@ -1095,6 +1099,61 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
                 self.stop_watching()
             self.go_lobby()
 
+    @tornado.gen.coroutine
+    def replay(self, username, filename):
+        if self.is_running():
+            self.process.stop()
+
+        if not self.update_db_info():
+            self.go_lobby()
+            return
+
+        if not self.username and not config.get('allow_anon_spectate'):
+            self.send_message("auth_error",
+                        reason="Anonymous spectating disabled")
+            self.go_lobby()
+            return
+
+        from webtiles.replay import ReplayHandler, find_recording, load_recording
+        game = path = None
+        # the username goes into a path, so it has to be a real one
+        if isinstance(username, str) and config.check_name(username):
+            game, path = find_recording(username, filename)
+        if not game:
+            self.go_lobby(message="There is no such recording.")
+            return
+
+        self.replay_request += 1
+        request = self.replay_request
+        try:
+            recording = yield load_recording(path)
+        except (IOError, OSError, EOFError, ValueError):
+            self.logger.warning("Error while reading recording %s!", path,
+                                exc_info=True)
+            if request == self.replay_request and not self.client_closed:
+                self.go_lobby(message="That recording couldn't be read.")
+            return
+
+        # Don't start if they went on to something else while it loaded.
+        if (request != self.replay_request or self.client_closed
+                or self.is_running()):
+            return
+
+        replay = ReplayHandler(game, username, self.logger, path, recording)
+        self.logger.info("Loaded recording %s: %d messages, %d keyframes.",
+                         path, len(replay.frames), len(replay.keyframes))
+        if self.watched_game:
+            self.stop_watching()
+        self.logger.info("%s started watching the recording %s.",
+                         self.username and self.username or "[Anon]", path)
+
+        self.watched_game = replay
+        self.send_message("watching_started", username = username)
+        replay.add_watcher(self)
+        replay.handle_notification(self.username,
+            "Replaying %s. Use /seek, /speed and /pause to control playback."
+            % filename)
+
     def post_chat_message(self, text):
         max_length = config.get('max_chat_length')
         if max_length:
@@ -1233,6 +1292,7 @@ class CrawlWebSocket(tornado.websocket.WebSocketHandler):
             self.send_message("reset_password_fail", reason = error)
 
     def go_lobby(self, message=None):
+        self.replay_request += 1
         if not config.get('dgl_mode'):
             return
 
@@ -12,6 +12,7 @@
 #include "branch.h"
 #include "coordit.h"
 #include "dactions.h"
+#include "dbg-prof.h"
 #include "delay.h"
 #include "describe.h"
 #include "directn.h"
@@ -160,6 +161,7 @@ static void _wizard_go_to_level(const level_pos &pos)
     you.depth         = pos.id.depth;
     _wizard_level_target = pos.id;
 
+    prof_begin_transition(old_level);
     leaving_level_now(stair_taken);
     const bool newlevel = load_level(stair_taken, LOAD_ENTER_LEVEL, old_level);
     tile_new_level(newlevel);
@@ -173,6 +175,7 @@ static void _wizard_go_to_level(const level_pos &pos)
     // Tell stash-tracker and travel that we've changed levels.
     trackers_init_new_level();
     _wizard_level_target = level_id();
+    prof_end_transition(level_id::current(), newlevel);
 }
 
 void wizard_interlevel_travel()
@@ -8,6 +8,7 @@
 #include "wiz-fsim.h"
 
 #include <cerrno>
+#include <functional>
 
 #include "beam.h"
 #include "bitary.h"
@@ -33,6 +34,7 @@
 #include "output.h"
 #include "player-equip.h"
 #include "player.h"
+#include "random.h"
 #include "ranged-attack.h"
 #include "skills.h"
 #include "species.h"
@@ -272,6 +274,9 @@ static bool _fsim_kit_equip(const string &kit, string &error)
 }
 
 // fight simulator internals
+static monster* _create_fsim_monster(monster_type mtype);
+static monster* _ready_fsim_monster(monster *mon);
+
 static monster* _init_fsim()
 {
     monster * mon = nullptr;
@@ -312,17 +317,28 @@ static monster* _init_fsim()
                 you.unique_creatures.set(mtype, false);
         }
 
-        mgen_data temp = mgen_data::hostile_at(mtype, false, you.pos());
-        temp.flags |= MG_DONT_COME;
-        temp.extra_flags |= MF_HARD_RESET | MF_NO_REWARD;
-        mon = create_monster(temp);
-        if (!mon)
-        {
-            mpr("Failed to create monster.");
-            return nullptr;
-        }
+        return _create_fsim_monster(mtype);
+    }
+
+    return _ready_fsim_monster(mon);
+}
+
+static monster* _create_fsim_monster(monster_type mtype)
+{
+    mgen_data temp = mgen_data::hostile_at(mtype, false, you.pos());
+    temp.flags |= MG_DONT_COME;
+    temp.extra_flags |= MF_HARD_RESET | MF_NO_REWARD;
+    monster *mon = create_monster(temp);
+    if (!mon)
+    {
+        mpr("Failed to create monster.");
+        return nullptr;
     }
+    return _ready_fsim_monster(mon);
+}
 
+static monster* _ready_fsim_monster(monster *mon)
+{
     // move the monster next to the player
     // this probably works best in the arena, or at least somewhere
     // where there's no water or anything weird to interfere
@@ -588,7 +604,146 @@ static string _init_scale(skill_map &scale, bool &xl_mode)
     return ret;
 }
 
-static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
+// A batch sim, run from a script rather than the wizard UI. Its scans don't
+// step through their cells in turn: each cell gets its own seed, and on
+// systems with fork() the cells are handed out to worker processes.
+struct fsim_batch
+{
+    fsim_batch(int _jobs, uint64_t _seed)
+        : jobs(_jobs), seed(_seed), scan(0)
+    {
+    }
+
+    int jobs;
+    uint64_t seed;
+    // which (monster, kit) scan is being run, to tell the seeds apart.
+    uint64_t scan;
+    string error;
+};
+
+// Sets the player up for one cell of a scan.
+typedef function<void()> fsim_cell;
+
+static fight_data _run_fsim_cell(monster &mon, bool defense,
+                                 const fsim_batch &batch, size_t cell,
+                                 const fsim_cell &setup)
+{
+    setup();
+    rng::subgenerator cell_rng(batch.seed, batch.scan << 16 | cell);
+    return _get_fight_data(mon, Options.fsim_rounds, defense);
+}
+
+static void _finish_fsim_cell(fight_data &fdata)
+{
+    fdata.player.iterations = fdata.monster.iterations = Options.fsim_rounds;
+    fdata.player.calc_output_stats();
+    fdata.monster.calc_output_stats();
+}
+
+#ifdef UNIX
+// The raw counts of a cell, as a worker passes them back.
+static string _fsim_cell_line(const fight_data &fdata)
+{
+    return make_stringf("%u %d %d %d %u %d %d %d\n",
+                        fdata.player.cumulative_damage,
+                        fdata.player.time_taken, fdata.player.hits,
+                        fdata.player.max_dam,
+                        fdata.monster.cumulative_damage,
+                        fdata.monster.time_taken, fdata.monster.hits,
+                        fdata.monster.max_dam);
+}
+
+static bool _read_fsim_cell(const string &line, fight_data &fdata)
+{
+    if (sscanf(line.c_str(), "%u %d %d %d %u %d %d %d",
+               &fdata.player.cumulative_damage, &fdata.player.time_taken,
+               &fdata.player.hits, &fdata.player.max_dam,
+               &fdata.monster.cumulative_damage, &fdata.monster.time_taken,
+               &fdata.monster.hits, &fdata.monster.max_dam) != 8)
+    {
+        return false;
+    }
+    _finish_fsim_cell(fdata);
+    return true;
+}
+
+// Runs each cell in a worker, at most batch.jobs at a time. Workers start
+// from a copy of the game as it is now, so the parent's player and monster
+// are left untouched, and a cell's results don't depend on which cells ran
+// before it.
+static bool _run_fsim_cells(monster &mon, bool defense, fsim_batch &batch,
+                            const vector<fsim_cell> &cells,
+                            vector<fight_data> &results)
+{
+    const vector<string> lines = run_in_workers(batch.jobs, cells.size(),
+        [&](size_t cell)
+        {
+            return _fsim_cell_line(_run_fsim_cell(mon, defense, batch, cell,
+                                                  cells[cell]));
+        }, batch.error);
+
+    results.assign(cells.size(), fight_data());
+    for (size_t cell = 0; batch.error.empty() && cell < cells.size(); cell++)
+    {
+        if (!_read_fsim_cell(lines[cell], results[cell]))
+        {
+            batch.error = make_stringf("Worker for cell %u failed.",
+                                       (unsigned int)cell);
+        }
+    }
+    return batch.error.empty();
+}
+#else
+// Without fork(), the cells run here one after another. Each starts from
+// the player as they were before the scan, just as a worker would.
+static bool _run_fsim_cells(monster &mon, bool defense, fsim_batch &batch,
+                            const vector<fsim_cell> &cells,
+                            vector<fight_data> &results)
+{
+    results.clear();
+
+    skill_state skill_backup;
+    skill_backup.save();
+    const int xl = you.experience_level;
+
+    for (size_t cell = 0; cell < cells.size(); cell++)
+    {
+        results.push_back(_run_fsim_cell(mon, defense, batch, cell,
+                                         cells[cell]));
+        skill_backup.restore_levels();
+        skill_backup.restore_training();
+        if (you.experience_level != xl)
+            set_xl(xl, false);
+    }
+
+    return true;
+}
+#endif
+
+static void _set_scale_level(const skill_map &scale, bool xl_mode, int level)
+{
+    if (xl_mode)
+        set_xl(level, true);
+    else
+    {
+        for (const auto &entry : scale)
+            set_skill_level(entry.first, level / entry.second);
+    }
+}
+
+static void _write_scale_line(FILE *o, int level, fight_damage_stats &fstats)
+{
+    const string line = fstats.summary(make_stringf("%2d | ", level), false);
+    const string file_line = Options.fsim_csv ?
+            fstats.summary(make_stringf("%d\t", level), true) :
+            line;
+    mpr(line);
+    fprintf(o, "%s\n", file_line.c_str());
+    fflush(o);
+}
+
+static bool _fsim_simple_scale(FILE * o, monster* mon, bool defense,
+                               fsim_batch *batch)
 {
     skill_map scale;
     bool xl_mode = false;
@@ -615,28 +770,33 @@ static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
 
     vector<pair<int, fight_data>> results;
     const int iter_limit = Options.fsim_rounds;
-    for (int i = xl_mode ? 1 : 0; i <= 27; i++)
+    if (batch)
     {
-        clear_messages();
+        vector<fsim_cell> cells;
+        for (int i = xl_mode ? 1 : 0; i <= 27; i++)
+            cells.push_back([=]() { _set_scale_level(scale, xl_mode, i); });
 
-        if (xl_mode)
-            set_xl(i, true);
-        else
+        vector<fight_data> cell_data;
+        if (!_run_fsim_cells(*mon, defense, *batch, cells, cell_data))
+            return false;
+
+        for (size_t c = 0; c < cell_data.size(); c++)
         {
-            for (const auto &entry : scale)
-                set_skill_level(entry.first, i / entry.second);
+            const int i = (xl_mode ? 1 : 0) + c;
+            results.emplace_back(i, cell_data[c]);
+            _write_scale_line(o, i, defense ? cell_data[c].monster
+                                            : cell_data[c].player);
         }
+    }
+    else for (int i = xl_mode ? 1 : 0; i <= 27; i++)
+    {
+        clear_messages();
+
+        _set_scale_level(scale, xl_mode, i);
 
         fight_data fdata = _get_fight_data(*mon, iter_limit, defense);
         results.emplace_back(i, fdata);
-        fight_damage_stats &fstats = defense ? fdata.monster : fdata.player;
-        const string line = fstats.summary(make_stringf("%2d | ", i), false);
-        const string file_line = Options.fsim_csv ?
-                fstats.summary(make_stringf("%d\t", i), true) :
-                line;
-        mpr(line);
-        fprintf(o, "%s\n", file_line.c_str());
-        fflush(o);
+        _write_scale_line(o, i, defense ? fdata.monster : fdata.player);
 
         // kill the loop if the user hits escape
         if (kbhit() && getch_ck() == 27)
@@ -654,19 +814,13 @@ static void _fsim_simple_scale(FILE * o, monster* mon, bool defense)
         fight_damage_stats &fstats = defense ? fdata.second.player :
                                                fdata.second.monster;
         if (fstats.hits)
-        {
-            const string line = fstats.summary(make_stringf("%2d | ", i), false);
-            const string file_line = Options.fsim_csv ?
-                    fstats.summary(make_stringf("%d\t", i), true) :
-                    line;
-            mpr(line);
-            fprintf(o, "%s\n", file_line.c_str());
-            fflush(o);
-        }
+            _write_scale_line(o, i, fstats);
     }
+    return true;
 }
 
-static void _fsim_double_scale(FILE * o, monster* mon, bool defense)
+static bool _fsim_double_scale(FILE * o, monster* mon, bool defense,
+                               fsim_batch *batch)
 {
     skill_type skx, sky;
     if (defense)
@@ -687,16 +841,40 @@ static void _fsim_double_scale(FILE * o, monster* mon, bool defense)
 
     fprintf(o,"\n");
 
+    vector<fight_data> cell_data;
+    if (batch)
+    {
+        vector<fsim_cell> cells;
+        for (int y = 1; y <= 27; y += 2)
+            for (int x = 1; x <= 27; x += 2)
+            {
+                cells.push_back([=]()
+                {
+                    set_skill_level(skx, x);
+                    set_skill_level(sky, y);
+                });
+            }
+        if (!_run_fsim_cells(*mon, defense, *batch, cells, cell_data))
+            return false;
+    }
+
     const int iter_limit = Options.fsim_rounds;
+    size_t cell = 0;
     for (int y = 1; y <= 27; y += 2)
     {
         fprintf(o, Options.fsim_csv ? "%d\t" : "%2d", y);
         for (int x = 1; x <= 27; x += 2)
         {
-            clear_messages();
-            set_skill_level(skx, x);
-            set_skill_level(sky, y);
-            fight_data fdata = _get_fight_data(*mon, iter_limit, defense);
+            fight_data fdata;
+            if (batch)
+                fdata = cell_data[cell++];
+            else
+            {
+                clear_messages();
+                set_skill_level(skx, x);
+                set_skill_level(sky, y);
+                fdata = _get_fight_data(*mon, iter_limit, defense);
+            }
             fight_damage_stats &fstats = defense ? fdata.monster : fdata.player;
             mprf("%s %d, %s %d: %d", skill_name(skx), x, skill_name(sky), y,
                  int(fstats.av_eff_dam));
@@ -704,15 +882,71 @@ static void _fsim_double_scale(FILE * o, monster* mon, bool defense)
             fflush(o);
 
             // kill the loop if the user hits escape
-            if (kbhit() && getch_ck() == 27)
+            if (!batch && kbhit() && getch_ck() == 27)
             {
                 mpr("Cancelling simulation.\n");
                 fprintf(o, "\nSimulation cancelled!\n\n");
-                return;
+                return true;
             }
         }
         fprintf(o,"\n");
     }
+    return true;
+}
+
+// Runs the scan for each of the fsim_kit kits, or just once with the player's
+// current equipment if there are none. Returns false if a kit couldn't be
+// equipped or a batch scan failed.
+static bool _fsim_kits(FILE *o, monster *mon, bool defense, bool double_scale,
+                       fsim_batch *batch, string &error)
+{
+    auto fsim_proc = double_scale ? _fsim_double_scale : _fsim_simple_scale;
+
+    if (Options.fsim_kit.empty())
+    {
+        const bool ok = fsim_proc(o, mon, defense, batch);
+        if (batch)
+        {
+            error = batch->error;
+            batch->scan++;
+        }
+        return ok;
+    }
+
+    for (const string &kit : Options.fsim_kit)
+    {
+        if (!_fsim_kit_equip(kit, error))
+        {
+            mprf("Aborting sim on %s", kit.c_str());
+            if (!error.empty())
+                mpr(error);
+            error = make_stringf("Aborting sim on %s%s%s", kit.c_str(),
+                                 error.empty() ? "" : ": ", error.c_str());
+            return false;
+        }
+
+        _write_weapon(o);
+        const bool ok = fsim_proc(o, mon, defense, batch);
+        if (batch)
+        {
+            error = batch->error;
+            batch->scan++;
+        }
+        if (!ok)
+            return false;
+        fprintf(o, "\n");
+    }
+    return true;
+}
+
+static void _write_fsim_header(FILE *o, monster &mon, bool defense)
+{
+    _write_version(o);
+    _write_matchup(o, mon, defense, Options.fsim_rounds);
+    _write_you(o);
+    _write_weapon(o);
+    _write_mon(o, mon);
+    fprintf(o,"\n");
 }
 
 void wizard_fight_sim(bool double_scale)
@@ -762,12 +996,7 @@ void wizard_fight_sim(bool double_scale)
         }
     }
 
-    _write_version(o);
-    _write_matchup(o, *mon, defense, Options.fsim_rounds);
-    _write_you(o);
-    _write_weapon(o);
-    _write_mon(o, *mon);
-    fprintf(o,"\n");
+    _write_fsim_header(o, *mon, defense);
 
     skill_state skill_backup;
     skill_backup.save();
@@ -779,29 +1008,8 @@ void wizard_fight_sim(bool double_scale)
     crawl_state.disables.set(DIS_DEATH);
     crawl_state.disables.set(DIS_DELAY);
 
-    void (*fsim_proc)(FILE * o, monster* mon, bool defense) = nullptr;
-    fsim_proc = double_scale ? _fsim_double_scale : _fsim_simple_scale;
-
-    if (Options.fsim_kit.empty())
-        fsim_proc(o, mon, defense);
-    else
-        for (const string &kit : Options.fsim_kit)
-        {
-            string error;
-            if (_fsim_kit_equip(kit, error))
-            {
-                _write_weapon(o);
-                fsim_proc(o, mon, defense);
-                fprintf(o, "\n");
-            }
-            else
-            {
-                mprf("Aborting sim on %s", kit.c_str());
-                if (!error.empty())
-                    mpr(error);
-                break;
-            }
-        }
+    string error;
+    _fsim_kits(o, mon, defense, double_scale, nullptr, error);
 
     if (!Options.fsim_csv)
         fprintf(o, "-----------------------------------\n\n");
@@ -816,4 +1024,70 @@ void wizard_fight_sim(bool double_scale)
     mpr("Done.");
 }
 
+bool fight_sim_batch(const vector<string> &monsters, bool double_scale,
+                     int jobs, uint64_t seed, string &error)
+{
+    // There's no one to ask, so anything but defence is an attack sim.
+    const bool defense = Options.fsim_mode.find("defen") != string::npos;
+    const char * fightstat = Options.fsim_csv ? "fsim.csv" : "fsim.txt";
+
+    FILE * o = fopen_u(fightstat, "a");
+    if (!o)
+    {
+        error = make_stringf("Can't write %s: %s", fightstat, strerror(errno));
+        return false;
+    }
+
+    skill_state skill_backup;
+    skill_backup.save();
+    int xl = you.experience_level;
+
+    unwind_var<FixedBitVector<NUM_DISABLEMENTS> > disabilities(crawl_state.disables);
+    crawl_state.disables.set(DIS_DEATH);
+    crawl_state.disables.set(DIS_DELAY);
+
+    fsim_batch batch(jobs, seed);
+    bool ok = true;
+    for (const string &name : monsters)
+    {
+        const monster_type mtype = get_monster_by_name(name, true);
+        if (mtype == MONS_PROGRAM_BUG)
+        {
+            error = make_stringf("No such monster: '%s'.", name.c_str());
+            ok = false;
+            break;
+        }
+        if (mons_is_unique(mtype) && you.unique_creatures[mtype])
+            you.unique_creatures.set(mtype, false);
+
+        monster *mon = _create_fsim_monster(mtype);
+        if (!mon)
+        {
+            error = make_stringf("Couldn't put %s next to the player.",
+                                 name.c_str());
+            ok = false;
+            break;
+        }
+
+        _write_fsim_header(o, *mon, defense);
+        ok = _fsim_kits(o, mon, defense, double_scale, &batch, error);
+
+        // Each matchup starts from the same player.
+        skill_backup.restore_levels();
+        skill_backup.restore_training();
+        if (you.experience_level != xl)
+            set_xl(xl, false);
+
+        _uninit_fsim(mon);
+        if (!ok)
+            break;
+    }
+
+    if (!Options.fsim_csv)
+        fprintf(o, "-----------------------------------\n\n");
+    fclose(o);
+
+    return ok;
+}
+
 #endif
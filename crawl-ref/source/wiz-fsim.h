@@ -6,8 +6,10 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 using std::string;
+using std::vector;
 
 struct fight_damage_stats
 {
@@ -55,3 +57,5 @@ struct fight_data
 void wizard_quick_fsim();
 void wizard_fight_sim(bool double_scale);
 fight_data wizard_quick_fsim_raw(bool defend);
+bool fight_sim_batch(const vector<string> &monsters, bool double_scale,
+                     int jobs, uint64_t seed, string &error);
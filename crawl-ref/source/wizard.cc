@@ -14,6 +14,7 @@
 #include "cio.h" // cursor_control
 #include "clua.h"
 #include "command.h" // show_keyhelp_menu
+#include "dbg-prof.h"
 #include "dbg-util.h"
 #include "dgn-shoals.h" // wizard_mod_tide
 #include "files.h" // save_game
@@ -151,7 +152,7 @@ static void _do_wizard_command(int wiz_command)
     case CONTROL('T'): debug_terp_dlua(); break;
 
     case 'u': wizard_level_travel(false); break;
-    // case 'U': break;
+    case 'U': debug_profile_report(); break;
     case CONTROL('U'): debug_terp_dlua(clua); break;
 
     case 'v': wizard_recharge_evokers(); break;
@@ -523,6 +524,9 @@ int list_wizard_commands(bool do_redraw_screen)
                        "<w>Ctrl-T</w> dungeon (D)Lua interpreter\n"
                        "<w>Ctrl-U</w> client (C)Lua interpreter\n"
                        "<w>Ctrl-X</w> Xom effect stats\n"
+#ifdef PROFILE_COUNTERS
+                       "<w>U</w>      show subsystem timings\n"
+#endif
 #ifdef DEBUG_DIAGNOSTICS
                        "<w>Ctrl-Q</w> make some debug messages quiet\n"
 #endif